@@ -120,6 +120,19 @@ typedef unsigned int *BITMAP_PTR_TYPE;
 #define BITMAP_CLEAR_P(BMAP, SZ, BIT)				\
   (!BMAP_SET_P((BMAP), (SZ), (BIT)))
 
+/* return the index of the lowest bit set in bitmap entry ENT, which must be
+   non-zero; the portable version evaluates ENT more than once */
+#ifdef __GNUC__
+#define BITMAP_ENT_FFS(ENT)	__builtin_ctz(ENT)
+#else /* !__GNUC__ */
+#define BITMAP_ENT_FFS(ENT)					\
+  (((((ENT) & (0U - (ENT))) & 0xffff0000U) ? 16 : 0)		\
+   + ((((ENT) & (0U - (ENT))) & 0xff00ff00U) ? 8 : 0)		\
+   + ((((ENT) & (0U - (ENT))) & 0xf0f0f0f0U) ? 4 : 0)		\
+   + ((((ENT) & (0U - (ENT))) & 0xccccccccU) ? 2 : 0)		\
+   + ((((ENT) & (0U - (ENT))) & 0xaaaaaaaaU) ? 1 : 0))
+#endif /* __GNUC__ */
+
 /* count the number of bits set in BMAP */
 #define BITMAP_COUNT_ONES(BMAP, SZ)				\
 ({								\
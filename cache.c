@@ -69,12 +69,34 @@
 #define CACHE_MK_BADDR(cp, tag, set)					\
   (((tag) << (cp)->tag_shift)|((set) << (cp)->set_shift))
 
-/* index an array of cache blocks, non-trivial due to variable length blocks */
-#define CACHE_BINDEX(cp, blks, i)					\
-  ((struct cache_blk_t *)(((char *)(blks)) +				\
-			  (i)*(sizeof(struct cache_blk_t) +		\
-			       ((cp)->balloc				\
-				? (cp)->bsize*sizeof(byte_t) : 0))))
+/* ways of set SET, low-associativity caches only */
+#define CACHE_SET_WAYS(cp, set)	(&(cp)->ways[(set) * (cp)->assoc])
+
+/* way of block BLK, low-associativity caches only */
+#define CACHE_BLK_WAY(cp, blk)	(&(cp)->ways[(blk) - (cp)->blks])
+
+/* time when block BLK will be accessible */
+#define CACHE_BLK_READY(cp, blk)					\
+  ((cp)->hsize ? (blk)->ready : CACHE_BLK_WAY(cp, blk)->ready)
+
+/* dirty bit of block BLK in the dirty ways of set SET */
+#define CACHE_DIRTY_BIT(cp, set, blk)					\
+  (1 << ((blk) - (cp)->sets[set].blks))
+
+/* non-zero if block BLK of set SET is dirty */
+#define CACHE_BLK_IS_DIRTY(cp, set, blk)				\
+  ((cp)->hsize								\
+   ? ((blk)->status & CACHE_BLK_DIRTY)					\
+   : ((cp)->sets[set].dirty & CACHE_DIRTY_BIT(cp, set, blk)))
+
+/* mark block BLK of set SET dirty */
+#define CACHE_BLK_SET_DIRTY(cp, set, blk)				\
+  ((cp)->hsize								\
+   ? ((blk)->status |= CACHE_BLK_DIRTY)					\
+   : ((cp)->sets[set].dirty |= CACHE_DIRTY_BIT(cp, set, blk)))
+
+/* way at position POS of a packed way order, position 0 is the MRU way */
+#define ORDER_WAY(order, pos)	(((order) >> ((pos) << 2)) & 0xf)
 
 /* cache data block accessor, type parameterized */
 #define __CACHE_ACCESS(type, data, bofs)				\
@@ -256,6 +278,56 @@ update_way_list(struct cache_set_t *set,	/* set contained way chain */
     panic("bogus WHERE designator");
 }
 
+/* move WAY to the head or tail of the packed way order of SET, this is
+   update_way_list() for low-associativity caches */
+static void
+update_way_order(struct cache_t *cp,		/* cache to update */
+		 struct cache_set_t *set,	/* set containing way order */
+		 int way,			/* way to move */
+		 enum list_loc_t where)		/* insert location */
+{
+  word_t order = set->way_order, ahead, behind;
+  int pos, last = cp->assoc - 1;
+
+  /* locate the way in the order */
+  for (pos=0; ORDER_WAY(order, pos) != way; pos++)
+    assert(pos < last);
+
+  /* ways ahead of and behind WAY */
+  ahead = order & ((1 << (pos << 2)) - 1);
+  behind = order >> ((pos + 1) << 2);
+
+  if (where == Head)
+    set->way_order = (behind << ((pos + 1) << 2)) | (ahead << 4) | way;
+  else if (where == Tail)
+    set->way_order = ahead | (behind << (pos << 2)) | (way << (last << 2));
+  else
+    panic("bogus WHERE designator");
+}
+
+/* invalidate block BLK of set SET at NOW, returns the latency of writing
+   back its data */
+static unsigned int			/* latency of the writeback */
+invalidate_blk(struct cache_t *cp,	/* cache instance */
+	       struct cache_blk_t *blk,	/* block to invalidate */
+	       md_addr_t set,		/* set containing block */
+	       tick_t now)		/* time of invalidation */
+{
+  cp->invalidations++;
+  blk->status &= ~CACHE_BLK_VALID;
+  if (!cp->hsize)
+    CACHE_BLK_WAY(cp, blk)->tag = CACHE_TAG_INVALID;
+
+  if (CACHE_BLK_IS_DIRTY(cp, set, blk))
+    {
+      /* write back the invalidated block */
+      cp->writebacks++;
+      return cp->blk_access_fn(Write, CACHE_MK_BADDR(cp, blk->tag, set),
+			       cp->bsize, blk, now);
+    }
+  return 0;
+}
+
 /* create and initialize a general cache structure */
 struct cache_t *			/* pointer to cache created */
 cache_create(char *name,		/* name of the cache */
@@ -324,6 +396,12 @@ cache_create(char *name,		/* name of the cache */
   cp->tagset_mask = ~cp->blk_mask;
   cp->bus_free = 0;
 
+  /* unlimited MSHRs and write buffer, see cache_set_buffers() */
+  cp->nmshrs = 0;
+  cp->mshr_ready = NULL;
+  cp->nwbufs = 0;
+  cp->wbuf_ready = NULL;
+
   /* print derived parameters during debug */
   debug("%s: cp->hsize     = %d", cp->name, cp->hsize);
   debug("%s: cp->blk_mask  = 0x%08x", cp->name, cp->blk_mask);
@@ -338,17 +416,41 @@ cache_create(char *name,		/* name of the cache */
   cp->replacements = 0;
   cp->writebacks = 0;
   cp->invalidations = 0;
+  cp->mshr_merges = 0;
+  cp->mshr_full = 0;
+  cp->wbuf_full = 0;
 
   /* blow away the last block accessed */
   cp->last_tagset = 0;
   cp->last_blk = NULL;
 
-  /* allocate data blocks */
-  cp->data = (byte_t *)calloc(nsets * assoc,
-			      sizeof(struct cache_blk_t) +
-			      (cp->balloc ? (bsize*sizeof(byte_t)) : 0));
-  if (!cp->data)
+  /* allocate cache blocks and their data */
+  cp->blks = (struct cache_blk_t *)calloc(nsets * assoc,
+					  sizeof(struct cache_blk_t));
+  if (!cp->blks)
     fatal("out of virtual memory");
+  cp->data = NULL;
+  if (cp->balloc)
+    {
+      cp->data = (byte_t *)calloc(nsets * assoc, bsize*sizeof(byte_t));
+      if (!cp->data)
+	fatal("out of virtual memory");
+    }
+
+  /* allocate the way array, all ways start out invalid */
+  cp->ways = NULL;
+  if (!cp->hsize)
+    {
+      cp->ways = (struct cache_way_t *)calloc(nsets * assoc,
+					      sizeof(struct cache_way_t));
+      if (!cp->ways)
+	fatal("out of virtual memory");
+      for (i=0; i<nsets*assoc; i++)
+	{
+	  cp->ways[i].tag = CACHE_TAG_INVALID;
+	  cp->ways[i].ready = 0;
+	}
+    }
 
   /* slice up the data blocks */
   for (bindex=0,i=0; i<nsets; i++)
@@ -367,14 +469,17 @@ cache_create(char *name,		/* name of the cache */
       /* NOTE: all the blocks in a set *must* be allocated contiguously,
 	 otherwise, block accesses through SET->BLKS will fail (used
 	 during random replacement selection) */
-      cp->sets[i].blks = CACHE_BINDEX(cp, cp->data, bindex);
+      cp->sets[i].blks = &cp->blks[bindex];
+      cp->sets[i].way_order = 0;
+      cp->sets[i].dirty = 0;
       
       /* link the data blocks into ordered way chain and hash table bucket
          chains, if hash table exists */
       for (j=0; j<assoc; j++)
 	{
 	  /* locate next cache block */
-	  blk = CACHE_BINDEX(cp, cp->data, bindex);
+	  blk = &cp->blks[bindex];
+	  blk->data = cp->balloc ? &cp->data[bindex * bsize] : NULL;
 	  bindex++;
 
 	  /* invalidate new cache block */
@@ -384,9 +489,16 @@ cache_create(char *name,		/* name of the cache */
 	  blk->user_data = (usize != 0
 			    ? (byte_t *)calloc(usize, sizeof(byte_t)) : NULL);
 
+	  /* low-associativity sets order their ways in a single word, in
+	     the same order as the way list below */
+	  if (!cp->hsize)
+	    {
+	      cp->sets[i].way_order = (cp->sets[i].way_order << 4) | j;
+	      continue;
+	    }
+
 	  /* insert cache block into set hash table */
-	  if (cp->hsize)
-	    link_htab_ent(cp, &cp->sets[i], blk);
+	  link_htab_ent(cp, &cp->sets[i], blk);
 
 	  /* insert into head of way list, order is arbitrary at this point */
 	  blk->way_next = cp->sets[i].way_head;
@@ -401,6 +513,56 @@ cache_create(char *name,		/* name of the cache */
   return cp;
 }
 
+/* give cache CP NMSHRS MSHRs and an NWBUFS entry write buffer, zero for
+   either is unlimited */
+void
+cache_set_buffers(struct cache_t *cp,	/* cache instance */
+		  int nmshrs,		/* number of MSHRs */
+		  int nwbufs)		/* number of write buffer entries */
+{
+  if (nmshrs < 0)
+    fatal("number of MSHRs `%d' must be positive or zero", nmshrs);
+  if (nwbufs < 0)
+    fatal("number of write buffers `%d' must be positive or zero", nwbufs);
+
+  /* all entries start out free */
+  cp->nmshrs = nmshrs;
+  if (cp->mshr_ready)
+    free(cp->mshr_ready);
+  cp->mshr_ready = NULL;
+  if (nmshrs)
+    {
+      cp->mshr_ready = (tick_t *)calloc(nmshrs, sizeof(tick_t));
+      if (!cp->mshr_ready)
+	fatal("out of virtual memory");
+    }
+
+  cp->nwbufs = nwbufs;
+  if (cp->wbuf_ready)
+    free(cp->wbuf_ready);
+  cp->wbuf_ready = NULL;
+  if (nwbufs)
+    {
+      cp->wbuf_ready = (tick_t *)calloc(nwbufs, sizeof(tick_t));
+      if (!cp->wbuf_ready)
+	fatal("out of virtual memory");
+    }
+}
+
+/* return the index of the entry of READY[N] that frees up first */
+static int
+first_free(tick_t *ready, int n)
+{
+  int i, first = 0;
+
+  for (i=1; i<n; i++)
+    {
+      if (ready[i] < ready[first])
+	first = i;
+    }
+  return first;
+}
+
 /* parse policy */
 enum cache_policy			/* replacement policy enum */
 cache_char2policy(char c)		/* replacement policy as a char */
@@ -428,6 +590,10 @@ cache_config(struct cache_t *cp,	/* cache instance */
 	  : cp->policy == Random ? "Random"
 	  : cp->policy == FIFO ? "FIFO"
 	  : (abort(), ""));
+  if (cp->nmshrs || cp->nwbufs)
+    fprintf(stream,
+	    "cache: %s: %d MSHRs, %d write buffers (0 is unlimited)\n",
+	    cp->name, cp->nmshrs, cp->nwbufs);
 }
 
 /* register cache stats */
@@ -471,6 +637,21 @@ cache_reg_stats(struct cache_t *cp,	/* cache instance */
   sprintf(buf, "%s.inv_rate", name);
   sprintf(buf1, "%s.invalidations / %s.accesses", name, name);
   stat_reg_formula(sdb, buf, "invalidation rate (i.e., invs/ref)", buf1, NULL);
+  if (cp->nmshrs)
+    {
+      sprintf(buf, "%s.mshr_merges", name);
+      stat_reg_counter(sdb, buf, "total number of hits to blocks being filled",
+		       &cp->mshr_merges, 0, NULL);
+      sprintf(buf, "%s.mshr_full", name);
+      stat_reg_counter(sdb, buf, "total number of misses that waited for "
+		       "an MSHR", &cp->mshr_full, 0, NULL);
+    }
+  if (cp->nwbufs)
+    {
+      sprintf(buf, "%s.wbuf_full", name);
+      stat_reg_counter(sdb, buf, "total number of writes that waited for "
+		       "a write buffer", &cp->wbuf_full, 0, NULL);
+    }
 }
 
 /* print cache stats */
@@ -511,7 +692,7 @@ cache_access(struct cache_t *cp,	/* cache to access */
   md_addr_t set = CACHE_SET(cp, addr);
   md_addr_t bofs = CACHE_BLK(cp, addr);
   struct cache_blk_t *blk, *repl;
-  int lat = 0;
+  int lat = 0, mshr = 0, way;
 
   /* default replacement address */
   if (repl_addr)
@@ -552,13 +733,17 @@ cache_access(struct cache_t *cp,	/* cache to access */
     }
   else
     {
-      /* low-associativity cache, linear search the way list */
-      for (blk=cp->sets[set].way_head;
-	   blk;
-	   blk=blk->way_next)
+      /* low-associativity cache, match the way array of the set, invalid
+	 ways never match */
+      struct cache_way_t *ways = CACHE_SET_WAYS(cp, set);
+
+      for (way=0; way<cp->assoc; way++)
 	{
-	  if (blk->tag == tag && (blk->status & CACHE_BLK_VALID))
-	    goto cache_hit;
+	  if (ways[way].tag == tag)
+	    {
+	      blk = &cp->sets[set].blks[way];
+	      goto cache_hit;
+	    }
 	}
     }
 
@@ -567,18 +752,38 @@ cache_access(struct cache_t *cp,	/* cache to access */
   /* **MISS** */
   cp->misses++;
 
+  /* a primary miss needs an MSHR, wait for the first one to free up */
+  if (cp->nmshrs)
+    {
+      mshr = first_free(cp->mshr_ready, cp->nmshrs);
+      if (cp->mshr_ready[mshr] > now)
+	{
+	  cp->mshr_full++;
+	  lat += cp->mshr_ready[mshr] - now;
+	}
+    }
+
   /* select the appropriate block to replace, and re-link this entry to
      the appropriate place in the way list */
   switch (cp->policy) {
   case LRU:
   case FIFO:
-    repl = cp->sets[set].way_tail;
-    update_way_list(&cp->sets[set], repl, Head);
+    if (cp->hsize)
+      {
+	repl = cp->sets[set].way_tail;
+	update_way_list(&cp->sets[set], repl, Head);
+      }
+    else
+      {
+	way = ORDER_WAY(cp->sets[set].way_order, cp->assoc - 1);
+	repl = &cp->sets[set].blks[way];
+	update_way_order(cp, &cp->sets[set], way, Head);
+      }
     break;
   case Random:
     {
       int bindex = myrand() & (cp->assoc - 1);
-      repl = CACHE_BINDEX(cp, cp->sets[set].blks, bindex);
+      repl = &cp->sets[set].blks[bindex];
     }
     break;
   default:
@@ -602,7 +807,7 @@ cache_access(struct cache_t *cp,	/* cache to access */
 	*repl_addr = CACHE_MK_BADDR(cp, repl->tag, set);
  
       /* don't replace the block until outstanding misses are satisfied */
-      lat += BOUND_POS(repl->ready - now);
+      lat += BOUND_POS(CACHE_BLK_READY(cp, repl) - now);
  
       /* stall until the bus to next level of memory is available */
       lat += BOUND_POS(cp->bus_free - (now + lat));
@@ -610,7 +815,7 @@ cache_access(struct cache_t *cp,	/* cache to access */
       /* track bus resource usage */
       cp->bus_free = MAX(cp->bus_free, (now + lat)) + 1;
 
-      if (repl->status & CACHE_BLK_DIRTY)
+      if (CACHE_BLK_IS_DIRTY(cp, set, repl))
 	{
 	  /* write back the cache block */
 	  cp->writebacks++;
@@ -623,6 +828,11 @@ cache_access(struct cache_t *cp,	/* cache to access */
   /* update block tags */
   repl->tag = tag;
   repl->status = CACHE_BLK_VALID;	/* dirty bit set on update */
+  if (!cp->hsize)
+    {
+      CACHE_BLK_WAY(cp, repl)->tag = tag;
+      cp->sets[set].dirty &= ~CACHE_DIRTY_BIT(cp, set, repl);
+    }
 
   /* read data block */
   lat += cp->blk_access_fn(Read, CACHE_BADDR(cp, addr), cp->bsize,
@@ -636,14 +846,19 @@ cache_access(struct cache_t *cp,	/* cache to access */
 
   /* update dirty status */
   if (cmd == Write)
-    repl->status |= CACHE_BLK_DIRTY;
+    CACHE_BLK_SET_DIRTY(cp, set, repl);
 
   /* get user block data, if requested and it exists */
   if (udata)
     *udata = repl->user_data;
 
-  /* update block status */
-  repl->ready = now+lat;
+  /* update block status, the MSHR is held until the block is filled */
+  if (cp->hsize)
+    repl->ready = now+lat;
+  else
+    CACHE_BLK_WAY(cp, repl)->ready = now+lat;
+  if (cp->nmshrs)
+    cp->mshr_ready[mshr] = now+lat;
 
   /* link this entry back into the hash table */
   if (cp->hsize)
@@ -658,6 +873,11 @@ cache_access(struct cache_t *cp,	/* cache to access */
   /* **HIT** */
   cp->hits++;
 
+  /* a hit to a block being filled is a secondary miss, it merges into
+     the outstanding miss */
+  if (CACHE_BLK_READY(cp, blk) > now)
+    cp->mshr_merges++;
+
   /* copy data out of cache block, if block exists */
   if (cp->balloc)
     {
@@ -666,13 +886,24 @@ cache_access(struct cache_t *cp,	/* cache to access */
 
   /* update dirty status */
   if (cmd == Write)
-    blk->status |= CACHE_BLK_DIRTY;
+    CACHE_BLK_SET_DIRTY(cp, set, blk);
 
   /* if LRU replacement and this is not the first element of list, reorder */
-  if (blk->way_prev && cp->policy == LRU)
+  if (cp->policy == LRU)
     {
-      /* move this block to head of the way (MRU) list */
-      update_way_list(&cp->sets[set], blk, Head);
+      if (cp->hsize)
+	{
+	  /* move this block to head of the way (MRU) list */
+	  if (blk->way_prev)
+	    update_way_list(&cp->sets[set], blk, Head);
+	}
+      else
+	{
+	  /* move this way to the head (MRU) of the way order */
+	  way = blk - cp->sets[set].blks;
+	  if (ORDER_WAY(cp->sets[set].way_order, 0) != way)
+	    update_way_order(cp, &cp->sets[set], way, Head);
+	}
     }
 
   /* tag is unchanged, so hash links (if they exist) are still valid */
@@ -686,13 +917,18 @@ cache_access(struct cache_t *cp,	/* cache to access */
     *udata = blk->user_data;
 
   /* return first cycle data is available to access */
-  return (int) MAX(cp->hit_latency, (blk->ready - now));
+  return (int) MAX(cp->hit_latency, (CACHE_BLK_READY(cp, blk) - now));
 
  cache_fast_hit: /* fast hit handler */
   
   /* **FAST HIT** */
   cp->hits++;
 
+  /* a hit to a block being filled is a secondary miss, it merges into
+     the outstanding miss */
+  if (CACHE_BLK_READY(cp, blk) > now)
+    cp->mshr_merges++;
+
   /* copy data out of cache block, if block exists */
   if (cp->balloc)
     {
@@ -701,7 +937,7 @@ cache_access(struct cache_t *cp,	/* cache to access */
 
   /* update dirty status */
   if (cmd == Write)
-    blk->status |= CACHE_BLK_DIRTY;
+    CACHE_BLK_SET_DIRTY(cp, set, blk);
 
   /* this block hit last, no change in the way list */
 
@@ -716,7 +952,7 @@ cache_access(struct cache_t *cp,	/* cache to access */
   cp->last_blk = blk;
 
   /* return first cycle data is available to access */
-  return (int) MAX(cp->hit_latency, (blk->ready - now));
+  return (int) MAX(cp->hit_latency, (CACHE_BLK_READY(cp, blk) - now));
 }
 
 /* return non-zero if block containing address ADDR is contained in cache
@@ -747,12 +983,13 @@ cache_probe(struct cache_t *cp,		/* cache instance to probe */
   }
   else
   {
-    /* low-associativity cache, linear search the way list */
-    for (blk=cp->sets[set].way_head;
-	 blk;
-	 blk=blk->way_next)
+    /* low-associativity cache, match the way array of the set */
+    struct cache_way_t *ways = CACHE_SET_WAYS(cp, set);
+    int way;
+
+    for (way=0; way<cp->assoc; way++)
     {
-      if (blk->tag == tag && (blk->status & CACHE_BLK_VALID))
+      if (ways[way].tag == tag)
 	  return TRUE;
     }
   }
@@ -761,36 +998,80 @@ cache_probe(struct cache_t *cp,		/* cache instance to probe */
   return FALSE;
 }
 
+/* return non-zero if an access to address ADDR at NOW can start without
+   waiting for an MSHR, i.e., it hits, merges into an outstanding miss, or
+   finds a free MSHR */
+int					/* non-zero if an MSHR is available */
+cache_mshr_avail(struct cache_t *cp,	/* cache instance to probe */
+		 md_addr_t addr,	/* address of access */
+		 tick_t now)		/* time of access */
+{
+  if (!cp->nmshrs
+      || cp->mshr_ready[first_free(cp->mshr_ready, cp->nmshrs)] <= now)
+    return TRUE;
+
+  /* all MSHRs are busy, only hits and secondary misses can start */
+  return cache_probe(cp, addr);
+}
+
+/* queue a write of LAT cycles to the next level of memory in the write
+   buffer of cache CP at NOW, returns the cycles the write waits for a free
+   write buffer entry */
+unsigned int				/* latency of the write */
+cache_wbuf_write(struct cache_t *cp,	/* cache instance */
+		 tick_t now,		/* time of write */
+		 unsigned int lat)	/* latency to drain the write */
+{
+  int wbuf;
+  unsigned int wait = 0;
+
+  /* unlimited write buffers never fill */
+  if (!cp->nwbufs)
+    return 0;
+
+  /* the write holds the first entry to drain until it drains itself */
+  wbuf = first_free(cp->wbuf_ready, cp->nwbufs);
+  if (cp->wbuf_ready[wbuf] > now)
+    {
+      cp->wbuf_full++;
+      wait = cp->wbuf_ready[wbuf] - now;
+    }
+  cp->wbuf_ready[wbuf] = now + wait + lat;
+
+  return wait;
+}
+
 /* flush the entire cache, returns latency of the operation */
 unsigned int				/* latency of the flush operation */
 cache_flush(struct cache_t *cp,		/* cache instance to flush */
 	    tick_t now)			/* time of cache flush */
 {
-  int i, lat = cp->hit_latency; /* min latency to probe cache */
+  int i, pos, lat = cp->hit_latency; /* min latency to probe cache */
   struct cache_blk_t *blk;
 
   /* blow away the last block to hit */
   cp->last_tagset = 0;
   cp->last_blk = NULL;
 
-  /* no way list updates required because all blocks are being invalidated */
+  /* no way list updates required because all blocks are being invalidated,
+     blocks are written back in way list order */
   for (i=0; i<cp->nsets; i++)
     {
-      for (blk=cp->sets[i].way_head; blk; blk=blk->way_next)
+      if (cp->hsize)
 	{
-	  if (blk->status & CACHE_BLK_VALID)
+	  for (blk=cp->sets[i].way_head; blk; blk=blk->way_next)
 	    {
-	      cp->invalidations++;
-	      blk->status &= ~CACHE_BLK_VALID;
-
-	      if (blk->status & CACHE_BLK_DIRTY)
-		{
-		  /* write back the invalidated block */
-          	  cp->writebacks++;
-		  lat += cp->blk_access_fn(Write,
-					   CACHE_MK_BADDR(cp, blk->tag, i),
-					   cp->bsize, blk, now+lat);
-		}
+	      if (blk->status & CACHE_BLK_VALID)
+		lat += invalidate_blk(cp, blk, i, now+lat);
+	    }
+	}
+      else
+	{
+	  for (pos=0; pos<cp->assoc; pos++)
+	    {
+	      blk = &cp->sets[i].blks[ORDER_WAY(cp->sets[i].way_order, pos)];
+	      if (blk->status & CACHE_BLK_VALID)
+		lat += invalidate_blk(cp, blk, i, now+lat);
 	    }
 	}
     }
@@ -826,35 +1107,33 @@ cache_flush_addr(struct cache_t *cp,	/* cache instance to flush */
     }
   else
     {
-      /* low-associativity cache, linear search the way list */
-      for (blk=cp->sets[set].way_head;
-	   blk;
-	   blk=blk->way_next)
+      /* low-associativity cache, match the way array of the set */
+      struct cache_way_t *ways = CACHE_SET_WAYS(cp, set);
+      int way;
+
+      for (blk=NULL, way=0; way<cp->assoc; way++)
 	{
-	  if (blk->tag == tag && (blk->status & CACHE_BLK_VALID))
-	    break;
+	  if (ways[way].tag == tag)
+	    {
+	      blk = &cp->sets[set].blks[way];
+	      break;
+	    }
 	}
     }
 
   if (blk)
     {
-      cp->invalidations++;
-      blk->status &= ~CACHE_BLK_VALID;
-
       /* blow away the last block to hit */
       cp->last_tagset = 0;
       cp->last_blk = NULL;
 
-      if (blk->status & CACHE_BLK_DIRTY)
-	{
-	  /* write back the invalidated block */
-          cp->writebacks++;
-	  lat += cp->blk_access_fn(Write,
-				   CACHE_MK_BADDR(cp, blk->tag, set),
-				   cp->bsize, blk, now+lat);
-	}
+      lat += invalidate_blk(cp, blk, set, now+lat);
+
       /* move this block to tail of the way (LRU) list */
-      update_way_list(&cp->sets[set], blk, Tail);
+      if (cp->hsize)
+	update_way_list(&cp->sets[set], blk, Tail);
+      else
+	update_way_order(cp, &cp->sets[set], blk - cp->sets[set].blks, Tail);
     }
 
   /* return latency of the operation */
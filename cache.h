@@ -80,14 +80,19 @@
  * The caches implemented by this module provide efficient storage management
  * and fast access for all cache geometries.  When sets become highly
  * associative, a hash table (indexed by address) is allocated for each set
- * in the cache.
+ * in the cache.  Low-associativity sets are instead searched through a
+ * contiguous array of their tags, which also holds the time each way is
+ * ready, and keep their replacement order and dirty ways packed into single
+ * words, so lookups never walk the blocks of the set, and hits only touch a
+ * block for its data or user data.
  *
  * This module also tracks latency of accessing the data cache, each cache has
  * a hit latency defined when instantiated, miss latency is returned by the
  * cache's block access function, the caches may service any number of hits
- * under any number of misses, the calling simulator should limit the number
- * of outstanding misses or the number of hits under misses as per the
- * limitations of the particular microarchitecture being simulated.
+ * under any number of misses, unless the number of outstanding misses is
+ * bounded with cache_set_buffers(), the calling simulator should otherwise
+ * limit the number of outstanding misses or the number of hits under misses
+ * as per the limitations of the particular microarchitecture being simulated.
  *
  * Due to the organization of this cache implementation, the latency of a
  * request cannot be affected by a later request to this module.  As a result,
@@ -109,27 +114,40 @@ enum cache_policy {
 #define CACHE_BLK_VALID		0x00000001	/* block in valid, in use */
 #define CACHE_BLK_DIRTY		0x00000002	/* dirty block */
 
+/* tag array value of an invalid way, no address has this tag */
+#define CACHE_TAG_INVALID	((md_addr_t)-1)
+
+/* way of a low-associativity cache, all a lookup or a hit needs */
+struct cache_way_t
+{
+  md_addr_t tag;		/* way tag, CACHE_TAG_INVALID if invalid */
+  tick_t ready;			/* time when way will be accessible, field
+				   is set when a miss fetch is initiated */
+};
+
 /* cache block (or line) definition */
 struct cache_blk_t
 {
   struct cache_blk_t *way_next;	/* next block in the ordered way chain, used
-				   to order blocks for replacement */
+				   to order blocks for replacement in highly
+				   associative caches */
   struct cache_blk_t *way_prev;	/* previous block in the order way chain */
   struct cache_blk_t *hash_next;/* next block in the hash bucket chain, only
 				   used in highly-associative caches */
   /* since hash table lists are typically small, there is no previous
      pointer, deletion requires a trip through the hash table bucket list */
   md_addr_t tag;		/* data block tag value */
-  unsigned int status;		/* block status, see CACHE_BLK_* defs above */
-  tick_t ready;		/* time when block will be accessible, field
-				   is set when a miss fetch is initiated */
+  unsigned int status;		/* block status, see CACHE_BLK_* defs above,
+				   low-associativity caches keep the dirty
+				   bit in the set */
+  tick_t ready;			/* time when block will be accessible, field
+				   is set when a miss fetch is initiated,
+				   highly associative caches only */
   byte_t *user_data;		/* pointer to user defined data, e.g.,
 				   pre-decode data or physical page address */
-  /* DATA should be pointer-aligned due to preceeding field */
-  /* NOTE: this is a variable-size tail array, this must be the LAST field
-     defined in this structure! */
-  byte_t data[1];		/* actual data block starts here, block size
-				   should probably be a multiple of 8 */
+  byte_t *data;			/* actual data block, NULL if !BALLOC, block
+				   data lives apart from the blocks so that
+				   the blocks of a set stay close together */
 };
 
 /* cache set definition (one or more blocks sharing the same set index) */
@@ -137,11 +155,17 @@ struct cache_set_t
 {
   struct cache_blk_t **hash;	/* hash table: for fast access w/assoc, NULL
 				   for low-assoc caches */
-  struct cache_blk_t *way_head;	/* head of way list */
+  struct cache_blk_t *way_head;	/* head of way list, highly associative
+				   caches only */
   struct cache_blk_t *way_tail;	/* tail pf way list */
   struct cache_blk_t *blks;	/* cache blocks, allocated sequentially, so
 				   this pointer can also be used for random
 				   access to cache blocks */
+  word_t way_order;		/* ways in replacement order, MRU first, four
+				   bits per way, low-associativity caches
+				   only */
+  word_t dirty;			/* dirty ways, one bit per way,
+				   low-associativity caches only */
 };
 
 /* cache definition */
@@ -181,6 +205,9 @@ struct cache_t
   int tag_shift;
   md_addr_t tag_mask;		/* use *after* shift */
   md_addr_t tagset_mask;	/* used for fast hit detection */
+  struct cache_way_t *ways;	/* the ASSOC ways of each set, in set order,
+				   way I of BLKS is WAYS[I],
+				   low-associativity caches only */
 
   /* bus resource */
   tick_t bus_free;		/* time when bus to next level of cache is
@@ -192,19 +219,37 @@ struct cache_t
  				   may be more than one cycle, as specified
  				   by the miss handler */
 
+  /* miss status holding registers, a primary miss holds an MSHR until its
+     block is filled, secondary misses to a block being filled merge into
+     its MSHR, a primary miss that finds all MSHRs busy waits for the first
+     one to free up; NMSHRS == 0 is an unlimited number of MSHRs */
+  int nmshrs;			/* number of MSHRs */
+  tick_t *mshr_ready;		/* time each MSHR frees up */
+
+  /* write buffer, writes to the next level of memory (see
+     cache_wbuf_write()) hold an entry until they drain, a write that finds
+     all entries busy waits for the first one to drain; NWBUFS == 0 is an
+     unlimited write buffer */
+  int nwbufs;			/* number of write buffer entries */
+  tick_t *wbuf_ready;		/* time each write buffer entry drains */
+
   /* per-cache stats */
   counter_t hits;		/* total number of hits */
   counter_t misses;		/* total number of misses */
   counter_t replacements;	/* total number of replacements at misses */
   counter_t writebacks;		/* total number of writebacks at misses */
   counter_t invalidations;	/* total number of external invalidations */
+  counter_t mshr_merges;	/* hits to blocks still being filled */
+  counter_t mshr_full;		/* primary misses that waited for an MSHR */
+  counter_t wbuf_full;		/* writes that waited for a write buffer */
 
   /* last block to hit, used to optimize cache hit processing */
   md_addr_t last_tagset;	/* tag of last line accessed */
   struct cache_blk_t *last_blk;	/* cache block last accessed */
 
   /* data blocks */
-  byte_t *data;			/* pointer to data blocks allocation */
+  struct cache_blk_t *blks;	/* pointer to cache blocks allocation */
+  byte_t *data;			/* pointer to block data allocation */
 
   /* NOTE: this is a variable-size tail array, this must be the LAST field
      defined in this structure! */
@@ -227,6 +272,13 @@ cache_create(char *name,		/* name of the cache */
 					   tick_t now),
 	     unsigned int hit_latency);/* latency in cycles for a hit */
 
+/* give cache CP NMSHRS MSHRs and an NWBUFS entry write buffer, zero for
+   either is unlimited */
+void
+cache_set_buffers(struct cache_t *cp,	/* cache instance */
+		  int nmshrs,		/* number of MSHRs */
+		  int nwbufs);		/* number of write buffer entries */
+
 /* parse policy */
 enum cache_policy			/* replacement policy enum */
 cache_char2policy(char c);		/* replacement policy as a char */
@@ -286,6 +338,22 @@ int					/* non-zero if access would hit */
 cache_probe(struct cache_t *cp,		/* cache instance to probe */
 	    md_addr_t addr);		/* address of block to probe */
 
+/* return non-zero if an access to address ADDR at NOW can start without
+   waiting for an MSHR, i.e., it hits, merges into an outstanding miss, or
+   finds a free MSHR */
+int					/* non-zero if an MSHR is available */
+cache_mshr_avail(struct cache_t *cp,	/* cache instance to probe */
+		 md_addr_t addr,	/* address of access */
+		 tick_t now);		/* time of access */
+
+/* queue a write of LAT cycles to the next level of memory in the write
+   buffer of cache CP at NOW, returns the cycles the write waits for a free
+   write buffer entry */
+unsigned int				/* latency of the write */
+cache_wbuf_write(struct cache_t *cp,	/* cache instance */
+		 tick_t now,		/* time of write */
+		 unsigned int lat);	/* latency to drain the write */
+
 /* flush the entire cache, returns latency of the operation */
 unsigned int				/* latency of the flush operation */
 cache_flush(struct cache_t *cp,		/* cache instance to flush */
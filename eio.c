@@ -598,7 +598,7 @@ eio_write_trace(FILE *eio_fd,			/* EIO stream file desc */
     eio_read_trace(sim_eio_fd, icnt, regs, my_mem_fn, mem, inst);
   else
     {
-      sys_syscall(regs, my_mem_fn, mem, inst, FALSE);
+      sys_syscall(regs, my_mem_fn, mem, inst, FALSE, icnt);
     }
 
   /* write syscall breakpoint and register outputs ($r2..$r7) */
@@ -648,7 +648,7 @@ eio_read_trace(FILE *eio_fd,			/* EIO stream file desc */
   /* exit() system calls get executed for real... */
   if (MD_EXIT_SYSCALL(regs))
     {
-      sys_syscall(regs, mem_fn, mem, inst, FALSE);
+      sys_syscall(regs, mem_fn, mem, inst, FALSE, icnt);
       panic("returned from exit() system call");
     }
 
@@ -184,6 +184,17 @@ usage(FILE *fd, int argc, char **argv)
 
 static int running = FALSE;
 
+/* pre-stats hook function, or NULL */
+static void (*hook_stats)(void) = NULL;
+
+/* register a function called just before the final stats are printed,
+   lets a simulator quiesce any work still in flight, e.g., worker threads */
+void
+sim_stats_hook(void (*fn)(void))	/* pre-stats hook function */
+{
+  hook_stats = fn;
+}
+
 /* print all simulator stats */
 void
 sim_print_stats(FILE *fd)		/* output stream */
@@ -215,6 +226,10 @@ sim_print_stats(FILE *fd)		/* output stream */
 static void
 exit_now(int exit_code)
 {
+  /* let the simulator settle its stats */
+  if (hook_stats)
+    hook_stats();
+
   /* print simulation stats */
   sim_print_stats(stderr);
 
@@ -51,6 +51,9 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#ifdef MEM_FLAT
+#include <sys/mman.h>
+#endif /* MEM_FLAT */
 
 #include "host.h"
 #include "misc.h"
@@ -60,17 +63,56 @@
 #include "memory.h"
 
 
+#ifdef MEM_FLAT
+/* (re)map the flat guest address window of memory space MEM, all zero and
+   untouched */
+static void
+mem_flat_map(struct mem_t *mem)		/* memory space to map */
+{
+  if (mem->flat)
+    munmap(mem->flat, MD_FLAT_SIZE);
+
+  /* reserve the whole window, the host allocates and zero-fills pages as
+     they are touched */
+  mem->flat = mmap(NULL, MD_FLAT_SIZE, PROT_READ|PROT_WRITE,
+		   MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+  if (mem->flat == (byte_t *)MAP_FAILED)
+    fatal("cannot map the %ldM flat guest address window",
+	  (long)(MD_FLAT_SIZE >> 20));
+
+  if (!mem->flat_touched)
+    {
+      mem->flat_touched = calloc(BITMAP_SIZE(MEM_FLAT_PAGES),
+				 sizeof(BITMAP_ENT_TYPE));
+      if (!mem->flat_touched)
+	fatal("out of virtual memory");
+    }
+  else
+    BITMAP_CLEAR_MAP(mem->flat_touched, BITMAP_SIZE(MEM_FLAT_PAGES));
+}
+#endif /* MEM_FLAT */
+
 /* create a flat memory space */
 struct mem_t *
 mem_create(char *name)			/* name of the memory space */
 {
   struct mem_t *mem;
+  int i;
 
   mem = calloc(1, sizeof(struct mem_t));
   if (!mem)
     fatal("out of virtual memory");
 
   mem->name = mystrdup(name);
+
+  /* the translation cache starts out empty */
+  for (i=0; i < MEM_XC_SIZE; i++)
+    mem->xc[i].vpn = MEM_XC_INVALID;
+
+#ifdef MEM_FLAT
+  mem_flat_map(mem);
+#endif /* MEM_FLAT */
+
   return mem;
 }
 
@@ -80,9 +122,10 @@ mem_translate(struct mem_t *mem,	/* memory space to access */
 	      md_addr_t addr)		/* virtual address to translate */
 {
   struct mem_pte_t *pte, *prev;
+  struct mem_xc_t *xc = MEM_XC_ENT(mem, addr);
 
-  /* got here via a first level miss in the page tables */
-  mem->ptab_misses++; mem->ptab_accesses++;
+  /* got here via a first level miss, i.e., in the translation cache */
+  mem->ptab_misses++;
 
   /* locate accessed PTE */
   for (prev=NULL, pte=mem->ptab[MEM_PTAB_SET(addr)];
@@ -94,32 +137,53 @@ mem_translate(struct mem_t *mem,	/* memory space to access */
 	  /* move this PTE to head of the bucket list */
 	  if (prev)
 	    {
+	      mem->ptab_bucket_misses++;
 	      prev->next = pte->next;
 	      pte->next = mem->ptab[MEM_PTAB_SET(addr)];
 	      mem->ptab[MEM_PTAB_SET(addr)] = pte;
 	    }
+
+	  /* replace the translation cache entry */
+	  xc->vpn = MEM_VPN(addr);
+	  xc->page = pte->page;
 	  return pte->page;
 	}
     }
 
+  /* not the first entry either */
+  if (mem->ptab[MEM_PTAB_SET(addr)])
+    mem->ptab_bucket_misses++;
+
   /* no translation found, return NULL */
   return NULL;
 }
 
-/* allocate a memory page */
-void
+/* allocate a memory page, returns pointer to host page */
+byte_t *
 mem_newpage(struct mem_t *mem,		/* memory space to allocate in */
 	    md_addr_t addr)		/* virtual address to allocate */
 {
   byte_t *page;
   struct mem_pte_t *pte;
 
-  /* see misc.c for details on the getcore() function */
-  page = getcore(MD_PAGE_SIZE);
-  if (!page)
-    fatal("out of virtual memory");
+#ifdef MEM_FLAT
+  if (MEM_IN_FLAT(addr))
+    {
+      /* the page is already mapped, mark it touched */
+      page = MEM_FLAT_ADDR(mem, addr & ~(md_addr_t)(MD_PAGE_SIZE - 1));
+      (void)BITMAP_SET(mem->flat_touched, 0, MEM_FLAT_PAGE_NUM(addr));
+    }
+  else
+#endif /* MEM_FLAT */
+    {
+      /* see misc.c for details on the getcore() function */
+      page = getcore(MD_PAGE_SIZE);
+      if (!page)
+	fatal("out of virtual memory");
+    }
 
-  /* generate a new PTE */
+  /* generate a new PTE, also for flat window pages, so MEM_FORALL()
+     visits them */
   pte = calloc(1, sizeof(struct mem_pte_t));
   if (!pte)
     fatal("out of virtual memory");
@@ -132,6 +196,13 @@ mem_newpage(struct mem_t *mem,		/* memory space to allocate in */
 
   /* one more page allocated */
   mem->page_count++;
+
+  /* the page is likely to be accessed next, replace the translation cache
+     entry, which cannot hold this page already */
+  MEM_XC_ENT(mem, addr)->vpn = MEM_VPN(addr);
+  MEM_XC_ENT(mem, addr)->page = page;
+
+  return page;
 }
 
 /* generic memory access function, it's safe because alignments and permissions
@@ -235,9 +306,11 @@ mem_reg_stats(struct mem_t *mem,	/* memory space to declare */
 		   buf1, "%11.0fk");
 
   sprintf(buf, "%s.ptab_misses", mem->name);
-  stat_reg_counter(sdb, buf, "total first level page table misses",
+  stat_reg_counter(sdb, buf,
+		   "total first level page table (translation cache) misses",
 		   &mem->ptab_misses, mem->ptab_misses, NULL);
 
+#ifndef NO_PTAB_STATS
   sprintf(buf, "%s.ptab_accesses", mem->name);
   stat_reg_counter(sdb, buf, "total page table accesses",
 		   &mem->ptab_accesses, mem->ptab_accesses, NULL);
@@ -245,6 +318,18 @@ mem_reg_stats(struct mem_t *mem,	/* memory space to declare */
   sprintf(buf, "%s.ptab_miss_rate", mem->name);
   sprintf(buf1, "%s.ptab_misses / %s.ptab_accesses", mem->name, mem->name);
   stat_reg_formula(sdb, buf, "first level page table miss rate", buf1, NULL);
+#endif /* !NO_PTAB_STATS */
+
+  sprintf(buf, "%s.ptab_bucket_misses", mem->name);
+  stat_reg_counter(sdb, buf,
+		   "total page table walks not hitting the bucket head",
+		   &mem->ptab_bucket_misses, mem->ptab_bucket_misses, NULL);
+
+  sprintf(buf, "%s.ptab_bucket_miss_rate", mem->name);
+  sprintf(buf1, "%s.ptab_bucket_misses / %s.ptab_misses",
+	  mem->name, mem->name);
+  stat_reg_formula(sdb, buf, "page table bucket head miss rate, per walk",
+		   buf1, NULL);
 }
 
 /* initialize memory system, call before loader.c */
@@ -253,12 +338,21 @@ mem_init(struct mem_t *mem)	/* memory space to initialize */
 {
   int i;
 
-  /* initialize the first level page table to all empty */
+  /* initialize the first level page table and the translation cache to all
+     empty */
   for (i=0; i < MEM_PTAB_SIZE; i++)
     mem->ptab[i] = NULL;
+  for (i=0; i < MEM_XC_SIZE; i++)
+    mem->xc[i].vpn = MEM_XC_INVALID;
+
+#ifdef MEM_FLAT
+  /* drop anything written to the window */
+  mem_flat_map(mem);
+#endif /* MEM_FLAT */
 
   mem->page_count = 0;
   mem->ptab_misses = 0;
+  mem->ptab_bucket_misses = 0;
   mem->ptab_accesses = 0;
 }
 
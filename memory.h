@@ -59,11 +59,18 @@
 #include "machine.h"
 #include "options.h"
 #include "stats.h"
+#include "bitmap.h"
 
 /* number of entries in page translation hash table (must be power-of-two) */
 #define MEM_PTAB_SIZE		(32*1024)
 #define MEM_LOG_PTAB_SIZE	15
 
+/* number of entries in the direct-mapped address translation cache (xc)
+   that sits in front of the page table (must be power-of-two); this is a
+   simulator speedup, not a model of the simulated machine's TLBs */
+#define MEM_XC_SIZE		1024
+#define MEM_LOG_XC_SIZE		10
+
 /* page table entry */
 struct mem_pte_t {
   struct mem_pte_t *next;	/* next translation in this bucket */
@@ -71,16 +78,34 @@ struct mem_pte_t {
   byte_t *page;			/* page pointer */
 };
 
+/* address translation cache entry, maps a virtual page number to its host page */
+struct mem_xc_t {
+  md_addr_t vpn;		/* virtual page number, MEM_XC_INVALID if
+				   the entry is empty */
+  byte_t *page;			/* host page pointer */
+};
+
 /* memory object */
 struct mem_t {
   /* memory object state */
   char *name;				/* name of this memory space */
+  struct mem_xc_t xc[MEM_XC_SIZE];	/* translation cache, only holds
+					   allocated pages */
   struct mem_pte_t *ptab[MEM_PTAB_SIZE];/* inverted page table */
+#ifdef MEM_FLAT
+  byte_t *flat;				/* host mapping of the guest address
+					   window, see MEM_IN_FLAT() */
+  BITMAP_PTR_TYPE flat_touched;		/* pages of the window written */
+#endif /* MEM_FLAT */
 
   /* memory object stats */
   counter_t page_count;			/* total number of pages allocated */
-  counter_t ptab_misses;		/* total first level page tbl misses */
-  counter_t ptab_accesses;		/* total page table accesses */
+  counter_t ptab_misses;		/* total first level misses, i.e.,
+					   translation cache misses */
+  counter_t ptab_bucket_misses;		/* total page table walks that missed
+					   the head of their bucket */
+  counter_t ptab_accesses;		/* total page table accesses, not
+					   counted if NO_PTAB_STATS */
 };
 
 /* memory access command */
@@ -115,16 +140,83 @@ typedef enum md_fault_type
   (((PTE)->tag << (MD_LOG_PAGE_SIZE + MEM_LOG_PTAB_SIZE))		\
    | ((IDX) << MD_LOG_PAGE_SIZE))
 
+/* empty translation cache entry, no address has this page number */
+#define MEM_XC_INVALID		((md_addr_t)-1)
+
+/* compute virtual page number */
+#define MEM_VPN(ADDR)		((ADDR) >> MD_LOG_PAGE_SIZE)
+
+/* compute translation cache entry, the page number is folded so the text,
+   data and stack segments, which are a large power of two apart, do not
+   conflict */
+#define MEM_XC_ENT(MEM, ADDR)						\
+  (&(MEM)->xc[(MEM_VPN(ADDR) ^ (MEM_VPN(ADDR) >> MEM_LOG_XC_SIZE))	\
+	       & (MEM_XC_SIZE - 1)])
+
+/* count a page table access, the counter is a memory increment on every
+   simulated memory access, fast builds compile it out with -DNO_PTAB_STATS */
+#ifndef NO_PTAB_STATS
+#define MEM_PTAB_ACCESS(MEM)	((MEM)->ptab_accesses++)
+#else /* NO_PTAB_STATS */
+#define MEM_PTAB_ACCESS(MEM)	((void)0)
+#endif /* NO_PTAB_STATS */
+
+/*
+ * flat guest memory, enabled with -DMEM_FLAT: the guest addresses from
+ * MD_FLAT_BASE to MD_FLAT_BASE + MD_FLAT_SIZE are backed by one sparse host
+ * mapping, which the host zero-fills on demand, so reads of the window are
+ * a single add and load; a page of the window is allocated on its first
+ * write, which marks it touched and enters it into the page table, so the
+ * page table iterator still sees every allocated page; addresses outside of
+ * the window use the page table as usual
+ */
+
+#ifdef MEM_FLAT
+
+/* number of pages in the flat window */
+#define MEM_FLAT_PAGES		(MD_FLAT_SIZE >> MD_LOG_PAGE_SIZE)
+
+/* is ADDR in the flat window? */
+#define MEM_IN_FLAT(ADDR)						\
+  ((md_addr_t)((ADDR) - MD_FLAT_BASE) < (md_addr_t)MD_FLAT_SIZE)
+
+/* compute page number within the flat window */
+#define MEM_FLAT_PAGE_NUM(ADDR)						\
+  ((int)(((ADDR) - MD_FLAT_BASE) >> MD_LOG_PAGE_SIZE))
+
+/* compute host address of window address ADDR */
+#define MEM_FLAT_ADDR(MEM, ADDR)	((MEM)->flat + ((ADDR) - MD_FLAT_BASE))
+
+/* has window address ADDR been written? */
+#define MEM_FLAT_TOUCHED(MEM, ADDR)					\
+  BITMAP_SET_P((MEM)->flat_touched, 0, MEM_FLAT_PAGE_NUM(ADDR))
+
 /* locate host page for virtual address ADDR, returns NULL if unallocated */
 #define MEM_PAGE(MEM, ADDR)						\
-  (/* first attempt to hit in first entry, otherwise call xlation fn */	\
-   ((MEM)->ptab[MEM_PTAB_SET(ADDR)]					\
-    && (MEM)->ptab[MEM_PTAB_SET(ADDR)]->tag == MEM_PTAB_TAG(ADDR))	\
-   ? (/* hit - return the page address on host */			\
-      (MEM)->ptab_accesses++,						\
-      (MEM)->ptab[MEM_PTAB_SET(ADDR)]->page)				\
-   : (/* first level miss - call the translation helper function */	\
-      mem_translate((MEM), (ADDR))))
+  (MEM_IN_FLAT(ADDR)							\
+   ? (MEM_FLAT_TOUCHED(MEM, ADDR)					\
+      ? MEM_FLAT_ADDR(MEM, (ADDR) & ~(md_addr_t)(MD_PAGE_SIZE - 1))	\
+      : NULL)								\
+   : MEM_PTAB_PAGE(MEM, ADDR))
+
+#else /* !MEM_FLAT */
+
+/* locate host page for virtual address ADDR, returns NULL if unallocated */
+#define MEM_PAGE(MEM, ADDR)	MEM_PTAB_PAGE(MEM, ADDR)
+
+#endif /* MEM_FLAT */
+
+/* locate host page for virtual address ADDR in the page table, returns NULL
+   if unallocated */
+#define MEM_PTAB_PAGE(MEM, ADDR)					\
+  (/* first attempt to hit in the translation cache, otherwise call	\
+      the translation fn, which walks the page table */			\
+   MEM_PTAB_ACCESS(MEM),						\
+   (MEM_XC_ENT(MEM, ADDR)->vpn == MEM_VPN(ADDR)			\
+    ? (/* hit - return the page address on host */			\
+       MEM_XC_ENT(MEM, ADDR)->page)					\
+    : (/* miss - call the translation helper function */		\
+       mem_translate((MEM), (ADDR)))))
 
 /* compute address of access within a host page */
 #define MEM_OFFSET(ADDR)	((ADDR) & (MD_PAGE_SIZE - 1))
@@ -133,35 +225,62 @@ typedef enum md_fault_type
 #define MEM_TICKLE(MEM, ADDR)						\
   (!MEM_PAGE(MEM, ADDR)							\
    ? (/* allocate page at address ADDR */				\
-      mem_newpage(MEM, ADDR))						\
+      (void)mem_newpage(MEM, ADDR))					\
    : (/* nada... */ (void)0))
 
 /* memory page iterator */
 #define MEM_FORALL(MEM, ITER, PTE)					\
   for ((ITER)=0; (ITER) < MEM_PTAB_SIZE; (ITER)++)			\
-    for ((PTE)=(MEM)->ptab[i]; (PTE) != NULL; (PTE)=(PTE)->next)
+    for ((PTE)=(MEM)->ptab[(ITER)]; (PTE) != NULL; (PTE)=(PTE)->next)
 
 
 /*
  * memory accessors macros, fast but difficult to debug...
  */
 
-/* safe version, works only with scalar types */
-/* FIXME: write a more efficient GNU C expression for this... */
+/* safe version, works only with scalar types, GNU C translates the
+   address only once, flat window reads need no translation */
+#if defined(__GNUC__) && defined(MEM_FLAT)
+#define MEM_READ(MEM, ADDR, TYPE)					\
+  ({ md_addr_t __mem_addr = (md_addr_t)(ADDR);				\
+     byte_t *__mem_page;						\
+     (MEM_IN_FLAT(__mem_addr)						\
+      ? *((TYPE *)MEM_FLAT_ADDR(MEM, __mem_addr))			\
+      : ((__mem_page = MEM_PTAB_PAGE(MEM, __mem_addr))			\
+	 ? *((TYPE *)(__mem_page + MEM_OFFSET(__mem_addr)))		\
+	 : /* page not yet allocated, return zero value */ (TYPE)0)); })
+#elif defined(__GNUC__)
+#define MEM_READ(MEM, ADDR, TYPE)					\
+  ({ md_addr_t __mem_addr = (md_addr_t)(ADDR);				\
+     byte_t *__mem_page = MEM_PAGE(MEM, __mem_addr);			\
+     (__mem_page							\
+      ? *((TYPE *)(__mem_page + MEM_OFFSET(__mem_addr)))		\
+      : /* page not yet allocated, return zero value */ (TYPE)0); })
+#else /* !__GNUC__ */
 #define MEM_READ(MEM, ADDR, TYPE)					\
   (MEM_PAGE(MEM, (md_addr_t)(ADDR))					\
    ? *((TYPE *)(MEM_PAGE(MEM, (md_addr_t)(ADDR)) + MEM_OFFSET(ADDR)))	\
    : /* page not yet allocated, return zero value */ 0)
+#endif /* __GNUC__ */
 
 /* unsafe version, works with any type */
 #define __UNCHK_MEM_READ(MEM, ADDR, TYPE)				\
   (*((TYPE *)(MEM_PAGE(MEM, (md_addr_t)(ADDR)) + MEM_OFFSET(ADDR))))
 
-/* safe version, works only with scalar types */
-/* FIXME: write a more efficient GNU C expression for this... */
+/* safe version, works only with scalar types, GNU C translates the
+   address only once, unless the page has to be allocated */
+#ifdef __GNUC__
+#define MEM_WRITE(MEM, ADDR, TYPE, VAL)					\
+  ({ md_addr_t __mem_addr = (md_addr_t)(ADDR);				\
+     byte_t *__mem_page = MEM_PAGE(MEM, __mem_addr);			\
+     if (!__mem_page)							\
+       __mem_page = mem_newpage(MEM, __mem_addr);			\
+     *((TYPE *)(__mem_page + MEM_OFFSET(__mem_addr))) = (VAL); })
+#else /* !__GNUC__ */
 #define MEM_WRITE(MEM, ADDR, TYPE, VAL)					\
   (MEM_TICKLE(MEM, (md_addr_t)(ADDR)),					\
    *((TYPE *)(MEM_PAGE(MEM, (md_addr_t)(ADDR)) + MEM_OFFSET(ADDR))) = (VAL))
+#endif /* __GNUC__ */
       
 /* unsafe version, works with any type */
 #define __UNCHK_MEM_WRITE(MEM, ADDR, TYPE, VAL)				\
@@ -213,8 +332,8 @@ byte_t *
 mem_translate(struct mem_t *mem,	/* memory space to access */
 	      md_addr_t addr);		/* virtual address to translate */
 
-/* allocate a memory page */
-void
+/* allocate a memory page, returns pointer to host page */
+byte_t *
 mem_newpage(struct mem_t *mem,		/* memory space to allocate in */
 	    md_addr_t addr);		/* virtual address to allocate */
 
@@ -55,13 +55,14 @@
 
 #include "host.h"
 #include "misc.h"
+#include "bitmap.h"
 #include "resource.h"
 
 /* create a resource pool */
 struct res_pool *
 res_create_pool(char *name, struct res_desc *pool, int ndesc)
 {
-  int i, j, k, index, ninsts;
+  int i, j, k, index, ninsts, maxlat;
   struct res_desc *inst_pool;
   struct res_pool *res;
 
@@ -102,7 +103,7 @@ res_create_pool(char *name, struct res_desc *pool, int ndesc)
   res->resources = inst_pool;
 
   /* fill in the resource table map - slow to build, but fast to access */
-  for (i=0; i<ninsts; i++)
+  for (maxlat=0,i=0; i<ninsts; i++)
     {
       struct res_template *plate;
       for (j=0; j<MAX_RES_CLASSES; j++)
@@ -111,7 +112,12 @@ res_create_pool(char *name, struct res_desc *pool, int ndesc)
 	  if (plate->class)
 	    {
 	      assert(plate->class < MAX_RES_CLASSES);
-	      res->table[plate->class][res->nents[plate->class]++] = plate;
+	      if (res->nents[plate->class] == MAX_INSTS_PER_CLASS)
+		fatal("too many functional units, "
+		      "increase MAX_INSTS_PER_CLASS");
+	      plate->slot = res->nents[plate->class]++;
+	      res->table[plate->class][plate->slot] = plate;
+	      maxlat = MAX(maxlat, plate->issuelat);
 	    }
 	  else
 	    /* all done with this instance */
@@ -119,6 +125,19 @@ res_create_pool(char *name, struct res_desc *pool, int ndesc)
 	}
     }
 
+  /* all units start out free */
+  for (i=0; i<MAX_RES_CLASSES; i++)
+    res->free[i] = (res->nents[i] == 32
+		    ? ~0U : (1U << res->nents[i]) - 1);
+
+  /* allocate the release wheel, larger than the longest issue latency */
+  for (res->wheel_size=2; res->wheel_size <= maxlat; res->wheel_size <<= 1);
+  res->wheel = (struct res_desc **)
+    calloc(res->wheel_size, sizeof(struct res_desc *));
+  if (!res->wheel)
+    fatal("out of virtual memory");
+  res->now = 0;
+
   return res;
 }
 
@@ -126,31 +145,73 @@ res_create_pool(char *name, struct res_desc *pool, int ndesc)
    operation of class CLASS, returns a pointer to the resource template,
    returns NULL, if there are currently no free resources available,
    follow the MASTER link to the master resource descriptor;
-   NOTE: caller is responsible for reseting the busy flag in the beginning
-   of the cycle when the resource can once again accept a new operation */
+   NOTE: the resource stays free until it is reserved with res_busy() */
 struct res_template *
 res_get(struct res_pool *pool, int class)
 {
-  int i;
-
   /* must be a valid class */
   assert(class < MAX_RES_CLASSES);
 
   /* must be at least one resource in this class */
   assert(pool->table[class][0]);
 
-  for (i=0; i<MAX_INSTS_PER_CLASS; i++)
+  /* first free unit of the class, if any */
+  if (!pool->free[class])
+    return NULL;
+  return pool->table[class][BITMAP_ENT_FFS(pool->free[class])];
+}
+
+/* make resource RES of pool POOL busy, it is released by the CYCLES'th
+   following call of res_release() */
+void
+res_busy(struct res_pool *pool, struct res_desc *res, int cycles)
+{
+  int k;
+  struct res_desc **slot;
+
+  if (res->busy)
+    panic("resource already in use");
+  if (cycles <= 0)
+    return;
+  if (cycles >= pool->wheel_size)
+    panic("resource busy time exceeds the release wheel");
+
+  /* a unit serves one or more classes, it is no longer free in any */
+  for (k=0; k<MAX_RES_CLASSES && res->x[k].class; k++)
+    pool->free[res->x[k].class] &= ~(1U << res->x[k].slot);
+
+  /* queue the release */
+  res->busy = cycles;
+  res->release = pool->now + cycles;
+  slot = &pool->wheel[res->release & (pool->wheel_size - 1)];
+  res->next = *slot;
+  *slot = res;
+}
+
+/* step the resource pool POOL CYCLES cycles, releasing the resources whose
+   busy time expires, called at the beginning of each cycle */
+void
+res_release(struct res_pool *pool, int cycles)
+{
+  int k, n;
+  struct res_desc *res, **slot;
+
+  /* every unit is released within a turn of the wheel */
+  n = MIN(cycles, pool->wheel_size);
+  pool->now += cycles - n;
+
+  while (n-- > 0)
     {
-      if (pool->table[class][i])
+      pool->now++;
+      slot = &pool->wheel[pool->now & (pool->wheel_size - 1)];
+      for (res = *slot; res; res = res->next)
 	{
-	  if (!pool->table[class][i]->master->busy)
-	    return pool->table[class][i];
+	  res->busy = FALSE;
+	  for (k=0; k<MAX_RES_CLASSES && res->x[k].class; k++)
+	    pool->free[res->x[k].class] |= 1U << res->x[k].slot;
 	}
-      else
-	break;
+      *slot = NULL;
     }
-  /* none found */
-  return NULL;
 }
 
 /* dump the resource pool POOL to stream STREAM */
@@ -175,7 +236,9 @@ res_dump(struct res_pool *pool, FILE *stream)
 	    break;
 	  fprintf(stream, "\t%s (busy for %d cycles) ",
 		  pool->table[i][j]->master->name,
-		  pool->table[i][j]->master->busy);
+		  (pool->table[i][j]->master->busy
+		   ? (int)(pool->table[i][j]->master->release - pool->now)
+		   : 0));
 	}
       assert(j == pool->nents[i]);
       fprintf(stream, "\n");
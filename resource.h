@@ -57,8 +57,9 @@
 /* maximum number of resource classes supported */
 #define MAX_RES_CLASSES		16
 
-/* maximum number of resource instances for a class supported */
-#define MAX_INSTS_PER_CLASS	8
+/* maximum number of resource instances for a class supported, at most the
+   number of bits in an unsigned int, see the pool free unit maps */
+#define MAX_INSTS_PER_CLASS	32
 
 /* resource descriptor */
 struct res_desc {
@@ -75,7 +76,12 @@ struct res_desc {
 					   before another operation can be
 					   issued on this resource */
     struct res_desc *master;		/* master resource record */
+    int slot;				/* index of this template in the
+					   pool table of its class */
   } x[MAX_RES_CLASSES];
+  unsigned int release;			/* release cycle, if busy */
+  struct res_desc *next;		/* next unit released in the same
+					   cycle */
 };
 
 /* resource pool: one entry per resource instance */
@@ -86,6 +92,14 @@ struct res_pool {
   /* res class -> res template mapping table, lists are NULL terminated */
   int nents[MAX_RES_CLASSES];
   struct res_template *table[MAX_RES_CLASSES][MAX_INSTS_PER_CLASS];
+  /* free units of each class, bit I is set if the unit of TABLE[class][I]
+     is not busy */
+  unsigned int free[MAX_RES_CLASSES];
+  /* release timing wheel, one slot per cycle, each slot lists the units
+     released in its cycle, the wheel is larger than any issue latency */
+  struct res_desc **wheel;
+  int wheel_size;			/* wheel slots, a power of two */
+  unsigned int now;			/* release cycle count */
 };
 
 /* create a resource pool */
@@ -95,10 +109,17 @@ struct res_pool *res_create_pool(char *name, struct res_desc *pool, int ndesc);
    operation of class CLASS, returns a pointer to the resource template,
    returns NULL, if there are currently no free resources available,
    follow the MASTER link to the master resource descriptor;
-   NOTE: caller is responsible for reseting the busy flag in the beginning
-   of the cycle when the resource can once again accept a new operation */
+   NOTE: the resource stays free until it is reserved with res_busy() */
 struct res_template *res_get(struct res_pool *pool, int class);
 
+/* make resource RES of pool POOL busy, it is released by the CYCLES'th
+   following call of res_release() */
+void res_busy(struct res_pool *pool, struct res_desc *res, int cycles);
+
+/* step the resource pool POOL CYCLES cycles, releasing the resources whose
+   busy time expires, called at the beginning of each cycle */
+void res_release(struct res_pool *pool, int cycles);
+
 /* dump the resource pool POOL to stream STREAM */
 void res_dump(struct res_pool *pool, FILE *stream);
 
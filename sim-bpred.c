@@ -434,7 +434,8 @@ sim_uninit(void)
 #endif /* HOST_HAS_QWORD */
 
 /* system call handler macro */
-#define SYSCALL(INST)	sys_syscall(&regs, mem_access, mem, INST, TRUE)
+#define SYSCALL(INST)							\
+  sys_syscall(&regs, mem_access, mem, INST, TRUE, sim_num_insn)
 
 /* start simulation, program loaded, processor precise state initialized */
 void
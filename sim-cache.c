@@ -61,6 +61,7 @@
 #include "regs.h"
 #include "memory.h"
 #include "cache.h"
+#include "stackdist.h"
 #include "loader.h"
 #include "syscall.h"
 #include "dlite.h"
@@ -71,7 +72,10 @@
  * generated for a user-selected cache and TLB configuration, which may include
  * up to two levels of instruction and data cache (with any levels unified),
  * and one level of instruction and data TLBs.  No timing information is
- * generated (hence the distinction, "functional" simulator).
+ * generated (hence the distinction, "functional" simulator).  Stack distance
+ * simulators (see stackdist.h) may also be attached to the instruction and
+ * data reference streams, these measure the miss ratios of a whole grid of
+ * LRU cache configurations in the same run.
  */
 
 /* simulated registers */
@@ -104,6 +108,12 @@ static struct cache_t *itlb = NULL;
 /* data TLB */
 static struct cache_t *dtlb = NULL;
 
+/* data reference stack distance simulator */
+static struct sd_t *stack_dl1 = NULL;
+
+/* instruction reference stack distance simulator */
+static struct sd_t *stack_il1 = NULL;
+
 /* text-based stat profiles */
 #define MAX_PCSTAT_VARS 8
 static struct stat_stat_t *pcstat_stats[MAX_PCSTAT_VARS];
@@ -236,6 +246,11 @@ static char *dtlb_opt /* = "none" */;
 static int flush_on_syscalls /* = FALSE */;
 static int compress_icache_addrs /* = FALSE */;
 
+/* stack distance simulator options */
+static char *stack_dl1_opt /* = "none" */;
+static char *stack_il1_opt /* = "none" */;
+static int stack_sample /* = 1 */;
+
 /* text-based stat profiles */
 static int pcstat_nelt = 0;
 static char *pcstat_vars[MAX_PCSTAT_VARS];
@@ -320,6 +335,39 @@ sim_reg_options(struct opt_odb_t *odb)	/* options database */
 	       &compress_icache_addrs, /* default */FALSE,
 	       /* print */TRUE, NULL);
 
+  opt_reg_string(odb, "-stack:dl1",
+		 "data reference stack distance simulator config, "
+		 "i.e., {<config>|none}",
+		 &stack_dl1_opt, "none", /* print */TRUE, NULL);
+  opt_reg_string(odb, "-stack:il1",
+		 "inst reference stack distance simulator config, "
+		 "i.e., {<config>|dl1|none}",
+		 &stack_il1_opt, "none", /* print */TRUE, NULL);
+  opt_reg_int(odb, "-stack:sample",
+	      "stack distance simulators simulate 1 in this many sets",
+	      &stack_sample, /* default */1, /* print */TRUE, NULL);
+  opt_reg_note(odb,
+"  The stack distance simulator config parameter <config> has the following\n"
+"  format:\n"
+"\n"
+"    <name>:<minsets>:<maxsets>:<bsize>:<maxassoc>\n"
+"\n"
+"    <name>     - name of the stack distance simulator being defined\n"
+"    <minsets>  - smallest number of sets simulated\n"
+"    <maxsets>  - largest number of sets simulated\n"
+"    <bsize>    - block size of all caches simulated\n"
+"    <maxassoc> - largest associativity simulated\n"
+"\n"
+"  Miss rates are reported for LRU caches of every power of two number of\n"
+"  sets from <minsets> to <maxsets>, and every power of two associativity\n"
+"  up to <maxassoc>, all from a single run.  Pointing -stack:il1 at \"dl1\"\n"
+"  simulates the unified reference stream.  With -stack:sample N, only the\n"
+"  references to 1 in N sets of the smallest caches are simulated.\n"
+"\n"
+"    Examples:   -stack:dl1 dstk:64:16384:32:16\n"
+"                -stack:il1 istk:64:1024:32:4 -stack:sample 8\n"
+	       );
+
   opt_reg_string_list(odb, "-pcstat",
 		      "profile stat(s) against text addr's (mult uses ok)",
 		      pcstat_vars, MAX_PCSTAT_VARS, &pcstat_nelt, NULL,
@@ -333,7 +381,7 @@ sim_check_options(struct opt_odb_t *odb,	/* options database */
 		  int argc, char **argv)	/* command line arguments */
 {
   char name[128], c;
-  int nsets, bsize, assoc;
+  int nsets, maxsets, bsize, assoc;
 
   /* use a level 1 D-cache? */
   if (!mystricmp(cache_dl1_opt, "none"))
@@ -458,6 +506,38 @@ sim_check_options(struct opt_odb_t *odb,	/* options database */
 			  cache_char2policy(c), dtlb_access_fn,
 			  /* hit latency */1);
     }
+
+  /* use a data reference stack distance simulator? */
+  if (!mystricmp(stack_dl1_opt, "none"))
+    {
+      stack_dl1 = NULL;
+
+      /* the instruction references cannot be unified with it */
+      if (!mystricmp(stack_il1_opt, "dl1"))
+	fatal("inst stack distance simulator cannot be unified with `none'");
+    }
+  else
+    {
+      if (sscanf(stack_dl1_opt, "%[^:]:%d:%d:%d:%d",
+		 name, &nsets, &maxsets, &bsize, &assoc) != 5)
+	fatal("bad data stack distance parms: "
+	      "<name>:<minsets>:<maxsets>:<bsize>:<maxassoc>");
+      stack_dl1 = sd_create(name, nsets, maxsets, bsize, assoc, stack_sample);
+    }
+
+  /* use an instruction reference stack distance simulator? */
+  if (!mystricmp(stack_il1_opt, "none"))
+    stack_il1 = NULL;
+  else if (!mystricmp(stack_il1_opt, "dl1"))
+    stack_il1 = stack_dl1;
+  else
+    {
+      if (sscanf(stack_il1_opt, "%[^:]:%d:%d:%d:%d",
+		 name, &nsets, &maxsets, &bsize, &assoc) != 5)
+	fatal("bad inst stack distance parms: "
+	      "<name>:<minsets>:<maxsets>:<bsize>:<maxassoc>");
+      stack_il1 = sd_create(name, nsets, maxsets, bsize, assoc, stack_sample);
+    }
 }
 
 /* initialize the simulator */
@@ -505,7 +585,10 @@ sim_load_prog(char *fname,		/* program to load */
 void
 sim_aux_config(FILE *stream)		/* output stream */
 {
-  /* nada */
+  if (stack_dl1)
+    sd_config(stack_dl1, stream);
+  if (stack_il1 && stack_il1 != stack_dl1)
+    sd_config(stack_il1, stream);
 }
 
 /* register simulator-specific statistics */
@@ -544,6 +627,12 @@ sim_reg_stats(struct stat_sdb_t *sdb)	/* stats database */
   if (dtlb)
     cache_reg_stats(dtlb, sdb);
 
+  /* register stack distance simulator stats */
+  if (stack_dl1)
+    sd_reg_stats(stack_dl1, sdb);
+  if (stack_il1 && stack_il1 != stack_dl1)
+    sd_reg_stats(stack_il1, sdb);
+
   for (i=0; i<pcstat_nelt; i++)
     {
       char buf[512], buf1[512];
@@ -655,7 +744,8 @@ sim_uninit(void)
    (cache_dl1								\
     ? cache_access(cache_dl1, Read, (addr), NULL,			\
 		   sizeof(SRC_T), 0, NULL, NULL)			\
-    : 0))
+    : 0),								\
+   (stack_dl1 ? (sd_access(stack_dl1, (addr)), 0) : 0))
 
 #define READ_BYTE(SRC, FAULT)						\
   ((FAULT) = md_fault_none, addr = (SRC),				\
@@ -680,7 +770,8 @@ sim_uninit(void)
    (cache_dl1								\
     ? cache_access(cache_dl1, Write, (addr), NULL,			\
 		   sizeof(DST_T), 0, NULL, NULL)			\
-    : 0))
+    : 0),								\
+   (stack_dl1 ? (sd_access(stack_dl1, (addr)), 0) : 0))
 
 #define WRITE_BYTE(SRC, DST, FAULT)					\
   ((FAULT) = md_fault_none, addr = (DST),				\
@@ -709,6 +800,8 @@ dcache_access_fn(struct mem_t *mem,	/* memory space to access */
     cache_access(dtlb, cmd, addr, NULL, nbytes, 0, NULL, NULL);
   if (cache_dl1)
     cache_access(cache_dl1, cmd, addr, NULL, nbytes, 0, NULL, NULL);
+  if (stack_dl1)
+    sd_access(stack_dl1, addr);
   return mem_access(mem, cmd, addr, p, nbytes);
 }
 
@@ -718,8 +811,9 @@ dcache_access_fn(struct mem_t *mem,	/* memory space to access */
    ? ((dtlb ? cache_flush(dtlb, 0) : 0),				\
       (cache_dl1 ? cache_flush(cache_dl1, 0) : 0),			\
       (cache_dl2 ? cache_flush(cache_dl2, 0) : 0),			\
-      sys_syscall(&regs, mem_access, mem, INST, TRUE))			\
-   : sys_syscall(&regs, dcache_access_fn, mem, INST, TRUE))
+      (stack_dl1 ? (sd_flush(stack_dl1), 0) : 0),			\
+      sys_syscall(&regs, mem_access, mem, INST, TRUE, sim_num_insn))	\
+   : sys_syscall(&regs, dcache_access_fn, mem, INST, TRUE, sim_num_insn))
 
 /* start simulation, program loaded, processor precise state initialized */
 void
@@ -757,6 +851,8 @@ sim_main(void)
       if (cache_il1)
 	cache_access(cache_il1, Read, IACOMPRESS(regs.regs_PC),
 		     NULL, ISCOMPRESS(sizeof(md_inst_t)), 0, NULL, NULL);
+      if (stack_il1)
+	sd_access(stack_il1, IACOMPRESS(regs.regs_PC));
       MD_FETCH_INST(inst, mem, regs.regs_PC);
 
       /* keep an instruction count */
@@ -392,7 +392,7 @@ sim_uninit(void)
   ((trace_fd != NULL && !fastfwding)					\
    ? eio_write_trace(trace_fd, sim_num_insn,				\
 		     &regs, mem_access, mem, INST)			\
-   : sys_syscall(&regs, mem_access, mem, INST, TRUE))
+   : sys_syscall(&regs, mem_access, mem, INST, TRUE, sim_num_insn))
 
 /* start simulation, program loaded, processor precise state initialized */
 void
@@ -294,7 +294,8 @@ sim_uninit(void)
 #endif /* HOST_HAS_QWORD */
 
 /* system call handler macro */
-#define SYSCALL(INST)	sys_syscall(&regs, mem_access, mem, INST, TRUE)
+#define SYSCALL(INST)							\
+  sys_syscall(&regs, mem_access, mem, INST, TRUE, sim_num_insn)
 
 #ifndef NO_INSN_COUNT
 #define INC_INSN_CTR()	sim_num_insn++
@@ -138,6 +138,19 @@ static int btb_nelt = 2;
 static int btb_config[2] =
   { /* nsets */512, /* assoc */4 };
 
+/* value predictor options */
+static struct vpred_opts_t vp_opts;
+
+/* speculate on confidently predicted load values */
+static int vp_spec;
+
+/* value misprediction recovery, i.e., {reissue|squash} */
+static char *vp_recover_opt;
+static enum { vp_recover_reissue, vp_recover_squash } vp_recover;
+
+/* value misprediction recovery latency (cycles) */
+static int vp_recover_lat;
+
 /* instruction decode B/W (insts/cycle) */
 static int ruu_decode_width;
 
@@ -159,18 +172,47 @@ static int RUU_size = 8;
 /* load/store queue (LSQ) size */
 static int LSQ_size = 4;
 
+/* load/store memory dependence predictor, i.e., {none|blind|wait|storeset} */
+static char *mdp_opt;
+static enum { mdp_none, mdp_blind, mdp_wait, mdp_storeset } mdp_type;
+
+/* memory dependence predictor PC table (wait table or SSIT) size */
+static int mdp_size;
+
+/* store set predictor last fetched store table (LFST) size */
+static int mdp_lfst_size;
+
+/* memory dependence predictor clear interval (cycles), 0 for never */
+static int mdp_clear;
+
+/* debug: extra cycles before store addresses are known, loads that do not
+   wait for their store then violate, 0 for none */
+static int lsq_sta_delay;
+
 /* l1 data cache config, i.e., {<config>|none} */
 static char *cache_dl1_opt;
 
 /* l1 data cache hit latency (in cycles) */
 static int cache_dl1_lat;
 
+/* l1 data cache MSHRs, 0 for unlimited */
+static int cache_dl1_mshrs;
+
+/* l1 data cache write buffer entries, 0 for unlimited */
+static int cache_dl1_wbufs;
+
 /* l2 data cache config, i.e., {<config>|none} */
 static char *cache_dl2_opt;
 
 /* l2 data cache hit latency (in cycles) */
 static int cache_dl2_lat;
 
+/* l2 data cache MSHRs, 0 for unlimited */
+static int cache_dl2_mshrs;
+
+/* l2 data cache write buffer entries, 0 for unlimited */
+static int cache_dl2_wbufs;
+
 /* l1 instruction cache config, i.e., {<config>|dl1|dl2|none} */
 static char *cache_il1_opt;
 
@@ -240,6 +282,20 @@ static char *pcstat_vars[MAX_PCSTAT_VARS];
 /* operate in backward-compatible bugs mode (for testing only) */
 static int bugcompat_mode;
 
+/* skip over cycles in which no pipeline stage can make progress */
+static int cycle_skip;
+
+/* maximum number of SMT threads */
+#define MAX_SMT_THREADS		8
+
+/* extra programs run as SMT threads, each a program command line */
+static int smt_nelt = 0;
+static char *smt_progs[MAX_SMT_THREADS-1];
+
+/* SMT fetch policy */
+static char *smt_fetch_opt;
+static enum { smt_fetch_icount, smt_fetch_rr } smt_fetch;
+
 /*
  * functional unit resource configuration
  */
@@ -332,23 +388,19 @@ static counter_t sim_total_branches = 0;
 /* cycle counter */
 static tick_t sim_cycle = 0;
 
-/*start-new*/
-static counter_t num_of_vpred_misses = 0;
-static counter_t num_of_vpred_hits = 0;
-extern counter_t predicted_ok;
-extern counter_t Wrong_Predictions;
-VAL_TAG_TYPE pred_val_main;
-extern int common_ref;
-extern int misses_vpred;
-extern int use_vp=1;
-extern int use_stride=1;
-extern int en_lookup_stride=0;
-extern int use_fsm = 0;
-extern int lookup_accessed;
-extern int update_accessed;
-extern int allocate_accessed;
-extern int found_value;
-/*end-new*/
+/* cycles skipped while the machine was stalled */
+static counter_t sim_skip_cycles = 0;
+
+/* value speculation counters */
+static counter_t vp_spec_loads = 0;	/* loads that used a predicted value */
+static counter_t vp_spec_wrong = 0;	/* ... of those mis-predicted */
+static counter_t vp_recover_insn = 0;	/* insts squashed by value recovery */
+static counter_t vp_reissue_insn = 0;	/* insts reissued by value recovery */
+
+/* memory dependence speculation counters */
+static counter_t mdp_violations = 0;	/* memory order violations */
+static counter_t mdp_false_deps = 0;	/* loads held back by a false dep */
+static counter_t mdp_recover_insn = 0;	/* insts squashed by violations */
 
 /* occupancy counters */
 static counter_t IFQ_count;		/* cumulative IFQ occupancy */
@@ -358,6 +410,9 @@ static counter_t RUU_fcount;		/* cumulative RUU full count */
 static counter_t LSQ_count;		/* cumulative LSQ occupancy */
 static counter_t LSQ_fcount;		/* cumulative LSQ full count */
 
+/* load issue attempts that waited for a free l1 data cache MSHR */
+static counter_t sim_mshr_stalls;
+
 /* total non-speculative bogus addresses seen (debug var) */
 static counter_t sim_invalid_addrs;
 
@@ -380,6 +435,27 @@ static int spec_mode = FALSE;
 /* cycles until fetch issue resumes */
 static unsigned ruu_fetch_issue_delay = 0;
 
+/* number of SMT threads */
+static int smt_nthreads = 1;
+
+/* address space ID of the active thread, ORed into cache and TLB addresses
+   so SMT threads do not hit on each other's lines, zero for thread 0 */
+static md_addr_t thread_asid = 0;
+
+/* number of instructions committed by the active thread, the instruction
+   count its system calls are checked against in its EIO trace */
+static counter_t thread_num_insn = 0;
+
+/* number of loads and stores, loads, and branches committed by the active
+   thread, with thread_num_insn what a memory order violation rewinds */
+static counter_t thread_num_refs = 0;
+static counter_t thread_num_loads = 0;
+static counter_t thread_num_branches = 0;
+
+/* commit, issue, and dispatch bandwidth left in the current cycle, shared
+   by all SMT threads */
+static int commit_slots, issue_slots, dispatch_slots;
+
 /* perfect prediction enabled */
 static int pred_perfect = FALSE;
 
@@ -408,6 +484,9 @@ static struct cache_t *dtlb;
 /* branch predictor */
 static struct bpred_t *pred;
 
+/* value predictor */
+static struct vpred_t *vpred = NULL;
+
 /* functional unit resource pool */
 static struct res_pool *fu_pool = NULL;
 
@@ -463,8 +542,8 @@ dl1_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
 	return lat;
       else
 	{
-	  /* FIXME: unlimited write buffers */
-	  return 0;
+	  /* the write drains from the write buffer */
+	  return cache_wbuf_write(cache_dl1, now, lat);
 	}
     }
   else
@@ -474,8 +553,8 @@ dl1_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
 	return mem_access_latency(bsize);
       else
 	{
-	  /* FIXME: unlimited write buffers */
-	  return 0;
+	  /* the write drains from the write buffer */
+	  return cache_wbuf_write(cache_dl1, now, mem_access_latency(bsize));
 	}
     }
 }
@@ -493,8 +572,8 @@ dl2_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
     return mem_access_latency(bsize);
   else
     {
-      /* FIXME: unlimited write buffers */
-      return 0;
+      /* the write drains from the write buffer */
+      return cache_wbuf_write(cache_dl2, now, mem_access_latency(bsize));
     }
 }
 
@@ -669,6 +748,25 @@ sim_reg_options(struct opt_odb_t *odb)
 "  Predictor `comb' combines a bimodal and a 2-level predictor.\n"
                );
 
+  /* value predictor options */
+  vpred_reg_options(odb, &vp_opts, /* !sweep */FALSE);
+
+  opt_reg_flag(odb, "-vp:spec",
+	       "speculate on confidently predicted load values, i.e., of fsm "
+	       "state 2 or 3, implies -vp:fsm",
+	       &vp_spec, /* default */FALSE,
+	       /* print */TRUE, /* format */NULL);
+
+  opt_reg_string(odb, "-vp:recover",
+		 "value misprediction recovery {reissue|squash}",
+		 &vp_recover_opt, /* default */"reissue",
+		 /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-vp:recover_lat",
+	      "value misprediction recovery latency (cycles)",
+	      &vp_recover_lat, /* default */1,
+	      /* print */TRUE, /* format */NULL);
+
   opt_reg_string(odb, "-bpred",
 		 "branch predictor type {nottaken|taken|perfect|bimod|2lev|comb}",
                  &pred_type, /* default */"bimod",
@@ -753,6 +851,32 @@ sim_reg_options(struct opt_odb_t *odb)
 	      &LSQ_size, /* default */8,
 	      /* print */TRUE, /* format */NULL);
 
+  opt_reg_string(odb, "-lsq:mdp",
+		 "memory dependence predictor {none|blind|wait|storeset}",
+		 &mdp_opt, /* default */"none",
+		 /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-lsq:mdp_size",
+	      "memory dependence predictor wait table or SSIT size",
+	      &mdp_size, /* default */1024,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-lsq:lfst_size",
+	      "store set predictor last fetched store table (LFST) size",
+	      &mdp_lfst_size, /* default */128,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-lsq:mdp_clear",
+	      "memory dependence predictor clear interval (cycles), 0 = never",
+	      &mdp_clear, /* default */1000000,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-lsq:sta_delay",
+	      "debug: extra store address latency (cycles), forces memory "
+	      "order violations",
+	      &lsq_sta_delay, /* default */0,
+	      /* print */TRUE, /* format */NULL);
+
   /* cache options */
 
   opt_reg_string(odb, "-cache:dl1",
@@ -780,6 +904,17 @@ sim_reg_options(struct opt_odb_t *odb)
 	      &cache_dl1_lat, /* default */1,
 	      /* print */TRUE, /* format */NULL);
 
+  opt_reg_int(odb, "-cache:dl1mshr",
+	      "l1 data cache MSHRs, loads wait to issue while all are busy "
+	      "(0 = unlimited)",
+	      &cache_dl1_mshrs, /* default */0,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-cache:dl1wbuf",
+	      "l1 data cache write buffer entries (0 = unlimited)",
+	      &cache_dl1_wbufs, /* default */0,
+	      /* print */TRUE, /* format */NULL);
+
   opt_reg_string(odb, "-cache:dl2",
 		 "l2 data cache config, i.e., {<config>|none}",
 		 &cache_dl2_opt, "ul2:1024:64:4:l",
@@ -790,6 +925,16 @@ sim_reg_options(struct opt_odb_t *odb)
 	      &cache_dl2_lat, /* default */6,
 	      /* print */TRUE, /* format */NULL);
 
+  opt_reg_int(odb, "-cache:dl2mshr",
+	      "l2 data cache MSHRs (0 = unlimited)",
+	      &cache_dl2_mshrs, /* default */0,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-cache:dl2wbuf",
+	      "l2 data cache write buffer entries (0 = unlimited)",
+	      &cache_dl2_wbufs, /* default */0,
+	      /* print */TRUE, /* format */NULL);
+
   opt_reg_string(odb, "-cache:il1",
 		 "l1 inst cache config, i.e., {<config>|dl1|dl2|none}",
 		 &cache_il1_opt, "il1:512:32:1:l",
@@ -889,6 +1034,21 @@ sim_reg_options(struct opt_odb_t *odb)
 		      pcstat_vars, MAX_PCSTAT_VARS, &pcstat_nelt, NULL,
 		      /* !print */FALSE, /* format */NULL, /* accrue */TRUE);
 
+  opt_reg_flag(odb, "-cycle:skip",
+	       "skip over cycles in which no pipeline stage can make progress",
+	       &cycle_skip, /* default */TRUE, /* print */TRUE, NULL);
+
+  opt_reg_string_list(odb, "-smt:prog",
+		      "run program as an extra SMT thread, i.e., \"<prog> "
+		      "<args>\" (mult uses ok)",
+		      smt_progs, MAX_SMT_THREADS-1, &smt_nelt, NULL,
+		      /* print */TRUE, /* format */NULL, /* accrue */TRUE);
+
+  opt_reg_string(odb, "-smt:fetch",
+		 "SMT fetch thread selection policy {icount|rr}",
+		 &smt_fetch_opt, /* default */"icount",
+		 /* print */TRUE, /* format */NULL);
+
   opt_reg_flag(odb, "-bugcompat",
 	       "operate in backward-compatible bugs mode (for testing only)",
 	       &bugcompat_mode, /* default */FALSE, /* print */TRUE, NULL);
@@ -995,6 +1155,21 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
   else
     fatal("cannot parse predictor type `%s'", pred_type);
 
+  /* only predictions the classification fsm trusts are speculated on */
+  if (vp_spec)
+    vp_opts.use_fsm = TRUE;
+  if (!vpred_check_options(&vp_opts, &vpred) && vp_spec)
+    fatal("value speculation `-vp:spec' requires value prediction `-vp'");
+
+  if (!mystricmp(vp_recover_opt, "reissue"))
+    vp_recover = vp_recover_reissue;
+  else if (!mystricmp(vp_recover_opt, "squash"))
+    vp_recover = vp_recover_squash;
+  else
+    fatal("unknown value misprediction recovery `%s'", vp_recover_opt);
+  if (vp_recover_lat < 0)
+    fatal("value misprediction recovery latency must be >= 0");
+
   if (!bpred_spec_opt)
     bpred_spec_update = spec_CT;
   else if (!mystricmp(bpred_spec_opt, "ID"))
@@ -1019,6 +1194,36 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
   if (LSQ_size < 2 || (LSQ_size & (LSQ_size-1)) != 0)
     fatal("LSQ size must be a positive number > 1 and a power of two");
 
+  if (!mystricmp(mdp_opt, "none"))
+    mdp_type = mdp_none;
+  else if (!mystricmp(mdp_opt, "blind"))
+    mdp_type = mdp_blind;
+  else if (!mystricmp(mdp_opt, "wait"))
+    mdp_type = mdp_wait;
+  else if (!mystricmp(mdp_opt, "storeset"))
+    mdp_type = mdp_storeset;
+  else
+    fatal("unknown memory dependence predictor `%s'", mdp_opt);
+  if (mdp_size < 1 || (mdp_size & (mdp_size-1)) != 0)
+    fatal("memory dependence predictor size must be a power of two");
+  if (mdp_lfst_size < 1 || (mdp_lfst_size & (mdp_lfst_size-1)) != 0)
+    fatal("LFST size must be a power of two");
+  if (mdp_clear < 0)
+    fatal("memory dependence predictor clear interval must be >= 0");
+  if (lsq_sta_delay < 0)
+    fatal("store address delay must be >= 0");
+
+  if (!mystricmp(smt_fetch_opt, "icount"))
+    smt_fetch = smt_fetch_icount;
+  else if (!mystricmp(smt_fetch_opt, "rr"))
+    smt_fetch = smt_fetch_rr;
+  else
+    fatal("unknown SMT fetch policy `%s'", smt_fetch_opt);
+  if (smt_nelt > 0 && ptrace_nelt > 0)
+    fatal("pipetracing is not supported with SMT threads");
+  if (smt_nelt > 0 && sizeof(md_addr_t) * 8 < 64)
+    fatal("SMT threads need a 64-bit target address space");
+
   /* use a level 1 D-cache? */
   if (!mystricmp(cache_dl1_opt, "none"))
     {
@@ -1037,6 +1242,7 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
       cache_dl1 = cache_create(name, nsets, bsize, /* balloc */FALSE,
 			       /* usize */0, assoc, cache_char2policy(c),
 			       dl1_access_fn, /* hit lat */cache_dl1_lat);
+      cache_set_buffers(cache_dl1, cache_dl1_mshrs, cache_dl1_wbufs);
 
       /* is the level 2 D-cache defined? */
       if (!mystricmp(cache_dl2_opt, "none"))
@@ -1050,6 +1256,7 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
 	  cache_dl2 = cache_create(name, nsets, bsize, /* balloc */FALSE,
 				   /* usize */0, assoc, cache_char2policy(c),
 				   dl2_access_fn, /* hit lat */cache_dl2_lat);
+	  cache_set_buffers(cache_dl2, cache_dl2_mshrs, cache_dl2_wbufs);
 	}
     }
 
@@ -1202,9 +1409,13 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
 void
 sim_aux_config(FILE *stream)            /* output stream */
 {
-  /* nada */
+  if (vpred)
+    vpred_config(vpred, stream);
 }
 
+/* register the per-thread stats of an SMT run */
+static void smt_reg_stats(struct stat_sdb_t *sdb);
+
 /* register simulator-specific statistics */
 void
 sim_reg_stats(struct stat_sdb_t *sdb)   /* stats database */
@@ -1252,6 +1463,9 @@ sim_reg_stats(struct stat_sdb_t *sdb)   /* stats database */
   stat_reg_counter(sdb, "sim_cycle",
 		   "total simulation time in cycles",
 		   &sim_cycle, /* initial value */0, /* format */NULL);
+  stat_reg_counter(sdb, "sim_skip_cycles",
+		   "total cycles skipped while the machine was stalled",
+		   &sim_skip_cycles, /* initial value */0, /* format */NULL);
   stat_reg_formula(sdb, "sim_IPC",
 		   "instructions per cycle",
 		   "sim_num_insn / sim_cycle", /* format */NULL);
@@ -1265,21 +1479,6 @@ sim_reg_stats(struct stat_sdb_t *sdb)   /* stats database */
 		   "instruction per branch",
 		   "sim_num_insn / sim_num_branches", /* format */NULL);
 
- /*start-new*/
-  stat_reg_int(sdb, "num_of_vpred_hits",
-         "num_of_vpred_hits",
-         &num_of_vpred_hits, 0, NULL);
-  stat_reg_int(sdb, "num_of_vpred_misses",
-         "num_of_vpred_misses",
-         &num_of_vpred_misses, 0, NULL);
-  stat_reg_int(sdb, "Correct_Prediction",
-        "total correct predictions made",
-        &predicted_ok, 0, NULL);
-  stat_reg_int(sdb, "Wrong_Predictions",
-       "Wrong_Predictions made by Value prediction",
-         &Wrong_Predictions, 0, NULL);
- /*end-new*/
-
   /* occupancy stats */
   stat_reg_counter(sdb, "IFQ_count", "cumulative IFQ occupancy",
                    &IFQ_count, /* initial value */0, /* format */NULL);
@@ -1331,6 +1530,46 @@ sim_reg_stats(struct stat_sdb_t *sdb)   /* stats database */
   /* register predictor stats */
   if (pred)
     bpred_reg_stats(pred, sdb);
+  if (vpred)
+    vpred_reg_stats(vpred, sdb);
+  if (vpred && vp_spec)
+    {
+      stat_reg_counter(sdb, "vp_spec_loads",
+		       "total number of loads that used a predicted value",
+		       &vp_spec_loads, 0, NULL);
+      stat_reg_counter(sdb, "vp_spec_wrong",
+		       "total number of mis-predicted values used",
+		       &vp_spec_wrong, 0, NULL);
+      stat_reg_counter(sdb, "vp_recover_insn",
+		       "total number of insts squashed by value recovery",
+		       &vp_recover_insn, 0, NULL);
+      stat_reg_counter(sdb, "vp_reissue_insn",
+		       "total number of insts reissued by value recovery",
+		       &vp_reissue_insn, 0, NULL);
+      stat_reg_formula(sdb, "vp_spec_rate",
+		       "fraction of loads that used a predicted value",
+		       "vp_spec_loads / sim_num_loads", NULL);
+      stat_reg_formula(sdb, "vp_spec_acc",
+		       "fraction of used predicted values that were correct",
+		       "1 - (vp_spec_wrong / vp_spec_loads)", NULL);
+    }
+
+  /* register memory dependence speculation stats */
+  stat_reg_counter(sdb, "mdp_violations",
+		   "total number of memory order violations",
+		   &mdp_violations, 0, NULL);
+  stat_reg_counter(sdb, "mdp_false_deps",
+		   "total number of loads held back by a false store dep",
+		   &mdp_false_deps, 0, NULL);
+  stat_reg_counter(sdb, "mdp_recover_insn",
+		   "total number of insts squashed by violation recovery",
+		   &mdp_recover_insn, 0, NULL);
+  stat_reg_formula(sdb, "mdp_violation_rate",
+		   "memory order violations per load",
+		   "mdp_violations / sim_num_loads", NULL);
+  stat_reg_formula(sdb, "mdp_false_dep_rate",
+		   "loads held back by a false store dep per load",
+		   "mdp_false_deps / sim_num_loads", NULL);
 
   /* register cache stats */
   if (cache_il1
@@ -1341,6 +1580,10 @@ sim_reg_stats(struct stat_sdb_t *sdb)   /* stats database */
     cache_reg_stats(cache_il2, sdb);
   if (cache_dl1)
     cache_reg_stats(cache_dl1, sdb);
+  if (cache_dl1 && cache_dl1->nmshrs)
+    stat_reg_counter(sdb, "sim_mshr_stalls",
+		     "total load issue attempts that waited for a dl1 MSHR",
+		     &sim_mshr_stalls, /* initial value */0, /* format */NULL);
   if (cache_dl2)
     cache_reg_stats(cache_dl2, sdb);
   if (itlb)
@@ -1353,6 +1596,10 @@ sim_reg_stats(struct stat_sdb_t *sdb)   /* stats database */
 		   "total non-speculative bogus addresses seen (debug var)",
                    &sim_invalid_addrs, /* initial value */0, /* format */NULL);
 
+  /* register per-thread stats */
+  if (smt_nelt > 0)
+    smt_reg_stats(sdb);
+
   for (i=0; i<pcstat_nelt; i++)
     {
       char buf[512], buf1[512];
@@ -1393,9 +1640,12 @@ static void lsq_init(void);
 static void rslink_init(int nlinks);
 static void eventq_init(void);
 static void readyq_init(void);
+static void lsq_dep_init(void);
 static void cv_init(void);
 static void tracer_init(void);
 static void fetch_init(void);
+static void smt_init(void);
+static void smt_load(char **envp);
 
 /* initialize the simulator */
 void
@@ -1434,7 +1684,7 @@ simoo_mstate_obj(FILE *stream,			/* output stream */
 		 struct regs_t *regs,		/* registers to access */
 		 struct mem_t *mem);		/* memory space to access */
 
-/* total RS links allocated at program start */
+/* RS links allocated at program start, the pool grows on demand */
 #define MAX_RS_LINKS                    4096
 
 /* load program into simulated state */
@@ -1443,6 +1693,10 @@ sim_load_prog(char *fname,		/* program to load */
 	      int argc, char **argv,	/* program arguments */
 	      char **envp)		/* program environment */
 {
+  /* set aside the initial thread state for any extra SMT threads */
+  if (smt_nelt > 0)
+    smt_init();
+
   /* load program text and data, set up environment, memory, and regs */
   ld_load_prog(fname, argc, argv, envp, &regs, mem, TRUE);
 
@@ -1469,6 +1723,11 @@ sim_load_prog(char *fname,		/* program to load */
   readyq_init();
   ruu_init();
   lsq_init();
+  lsq_dep_init();
+
+  /* load the programs of any extra SMT threads */
+  if (smt_nelt > 0)
+    smt_load(envp);
 
   /* initialize the DLite debugger */
   dlite_init(simoo_reg_obj, simoo_mem_obj, simoo_mstate_obj);
@@ -1497,11 +1756,27 @@ sim_uninit(void)
 /* inst tag type, used to tag an operation instance in the RUU */
 typedef unsigned int INST_TAG_TYPE;
 
+/* a tagged reference to an LSQ entry, valid while that entry is in the LSQ */
+struct lsq_link {
+  struct RUU_station *rs;		/* LSQ entry, NULL if none */
+  INST_TAG_TYPE tag;			/* LSQ entry tag when linked */
+};
+
+/* initialize an LSQ link, and check that it refers to a valid entry */
+#define LSQLINK_INIT(L, RS)	((L).rs = (RS), (L).tag = (RS)->tag)
+#define LSQLINK_VALID(L)	((L).rs && (L).tag == (L).rs->tag)
+
 /* inst sequence type, used to order instructions in the ready list, if
    this rolls over the ready list order temporarily will get messed up,
    but execution will continue and complete correctly */
 typedef unsigned int INST_SEQ_TYPE;
 
+/* RS link handle, the index of an RS link in the RS link pool */
+typedef unsigned int rslink_t;
+
+/* the NULL RS link handle, pool entry 0 is never allocated */
+#define RSLINK_NIL		0
+
 
 /* total input dependencies possible */
 #define MAX_IDEPS               3
@@ -1523,40 +1798,73 @@ typedef unsigned int INST_SEQ_TYPE;
    into the RUU and the load/store inserted into the LSQ, allowing the add
    to wake up the load/store when effective address computation has finished */
 struct RUU_station {
-  /* inst info */
-  md_inst_t IR;			/* instruction bits */
-  enum md_opcode op;			/* decoded instruction opcode */
-  md_addr_t PC, next_PC, pred_PC;	/* inst PC, next PC, predicted PC */
-  int in_LSQ;				/* non-zero if op is in LSQ */
-  int ea_comp;				/* non-zero if op is an addr comp */
-  int recover_inst;			/* start of mis-speculation? */
-  int stack_recover_idx;		/* non-speculative TOS for RSB pred */
-  struct bpred_update_t dir_update;	/* bpred direction update info */
-  int spec_mode;			/* non-zero if issued in spec_mode */
-  md_addr_t addr;			/* effective address for ld/st's */
+  /* instruction status */
   INST_TAG_TYPE tag;			/* RUU slot tag, increment to
 					   squash operation */
   INST_SEQ_TYPE seq;			/* instruction sequence, used to
 					   sort the ready list and tag inst */
-  unsigned int ptrace_seq;		/* pipetrace sequence number */
-  int slip;
-  /* instruction status */
-  int queued;				/* operands ready and queued */
-  int issued;				/* operation is/was executing */
-  int completed;			/* operation has completed execution */
-  /* output operand dependency list, these lists are used to
-     limit the number of associative searches into the RUU when
-     instructions complete and need to wake up dependent insts */
-  int onames[MAX_ODEPS];		/* output logical names (NA=unused) */
-  struct RS_link *odep_list[MAX_ODEPS];	/* chains to consuming operations */
-
-  /* input dependent links, the output chains rooted above use these
+  enum md_opcode op;			/* decoded instruction opcode */
+  byte_t queued;			/* operands ready and queued */
+  byte_t issued;			/* operation is/was executing */
+  byte_t completed;			/* operation has completed execution */
+  byte_t in_LSQ;			/* non-zero if op is in LSQ */
+  byte_t ea_comp;			/* non-zero if op is an addr comp */
+  byte_t recover_inst;			/* start of mis-speculation? */
+  byte_t spec_mode;			/* non-zero if issued in spec_mode */
+
+  /* input dependent links, the output chains rooted below use these
      fields to mark input operands as ready, when all these fields have
      been set non-zero, the RUU operation has all of its register
      operands, it may commence execution as soon as all of its memory
      operands are known to be read (see lsq_refresh() for details on
      enforcing memory dependencies) */
-  int idep_ready[MAX_IDEPS];		/* input operand ready? */
+  byte_t idep_ready[MAX_IDEPS];		/* input operand ready? */
+
+  /* load value speculation */
+  byte_t vp_spec;			/* loaded value predicted, consumers
+					   take it at dispatch */
+  byte_t vp_mispred;			/* predicted value is wrong, recover
+					   at writeback */
+  byte_t vp_dep;			/* an input may be a wrong value, with
+					   reissue recovery the output chains
+					   are kept until commit */
+  byte_t vp_reissue;			/* executing with a wrong value, the
+					   result event is dropped */
+  /* memory dependences */
+  byte_t mdp_wait;			/* load waits for all older stores */
+  byte_t mdp_ckpt;			/* load may violate, checkpointed */
+  byte_t mdp_false;			/* load held back by a false dep */
+
+  md_addr_t addr;			/* effective address for ld/st's */
+  int ea_index;				/* RUU index of the eff addr op, the
+					   squash point of a recovering load */
+  int st_next;				/* next store in the LSQ store
+					   address hash bucket */
+  struct lsq_link mdp_pred;		/* load: predicted store, store:
+					   previous store in its store set */
+  struct lsq_link mdp_true;		/* load: store with an unknown addr
+					   it reads from */
+
+  /* output operand dependency list, these lists are used to
+     limit the number of associative searches into the RUU when
+     instructions complete and need to wake up dependent insts */
+  int onames[MAX_ODEPS];		/* output logical names (NA=unused) */
+  rslink_t odep_list[MAX_ODEPS];	/* chains to consuming operations */
+
+  struct RUU_cold *cold;		/* cold part of this station */
+};
+
+/* the cold part of an RUU station, the instruction and branch state used
+   only at dispatch, branch recovery and commit, and by the pipetrace; it
+   is kept in an array parallel to the RUU or LSQ, so the wakeup, select
+   and commit scans only touch the dense hot stations */
+struct RUU_cold {
+  md_inst_t IR;				/* instruction bits */
+  md_addr_t PC, next_PC, pred_PC;	/* inst PC, next PC, predicted PC */
+  int stack_recover_idx;		/* non-speculative TOS for RSB pred */
+  struct bpred_update_t dir_update;	/* bpred direction update info */
+  unsigned int ptrace_seq;		/* pipetrace sequence number */
+  int slip;
 };
 
 /* non-zero if all register operands are ready, update with MAX_IDEPS */
@@ -1573,9 +1881,15 @@ static int RUU_num;			/* num entries currently in RUU */
 static void
 ruu_init(void)
 {
+  int i;
+  struct RUU_cold *cold;
+
   RUU = calloc(RUU_size, sizeof(struct RUU_station));
-  if (!RUU)
+  cold = calloc(RUU_size, sizeof(struct RUU_cold));
+  if (!RUU || !cold)
     fatal("out of virtual memory");
+  for (i=0; i<RUU_size; i++)
+    RUU[i].cold = &cold[i];
 
   RUU_num = 0;
   RUU_head = RUU_tail = 0;
@@ -1599,10 +1913,10 @@ ruu_dumpent(struct RUU_station *rs,		/* ptr to RUU station */
   else
     fprintf(stream, "       opcode: %s, inst: `",
 	    MD_OP_NAME(rs->op));
-  md_print_insn(rs->IR, rs->PC, stream);
+  md_print_insn(rs->cold->IR, rs->cold->PC, stream);
   fprintf(stream, "'\n");
   myfprintf(stream, "         PC: 0x%08p, NPC: 0x%08p (pred_PC: 0x%08p)\n",
-	    rs->PC, rs->next_PC, rs->pred_PC);
+	    rs->cold->PC, rs->cold->next_PC, rs->cold->pred_PC);
   fprintf(stream, "         in_LSQ: %s, ea_comp: %s, recover_inst: %s\n",
 	  rs->in_LSQ ? "t" : "f",
 	  rs->ea_comp ? "t" : "f",
@@ -1610,7 +1924,7 @@ ruu_dumpent(struct RUU_station *rs,		/* ptr to RUU station */
   myfprintf(stream, "         spec_mode: %s, addr: 0x%08p, tag: 0x%08x\n",
 	    rs->spec_mode ? "t" : "f", rs->addr, rs->tag);
   fprintf(stream, "         seq: 0x%08x, ptrace_seq: 0x%08x\n",
-	  rs->seq, rs->ptrace_seq);
+	  rs->seq, rs->cold->ptrace_seq);
   fprintf(stream, "         queued: %s, issued: %s, completed: %s\n",
 	  rs->queued ? "t" : "f",
 	  rs->issued ? "t" : "f",
@@ -1691,9 +2005,15 @@ static int LSQ_num;                     /* num entries currently in LSQ */
 static void
 lsq_init(void)
 {
+  int i;
+  struct RUU_cold *cold;
+
   LSQ = calloc(LSQ_size, sizeof(struct RUU_station));
-  if (!LSQ)
+  cold = calloc(LSQ_size, sizeof(struct RUU_cold));
+  if (!LSQ || !cold)
     fatal("out of virtual memory");
+  for (i=0; i<LSQ_size; i++)
+    LSQ[i].cold = &cold[i];
 
   LSQ_num = 0;
   LSQ_head = LSQ_tail = 0;
@@ -1740,9 +2060,9 @@ lsq_dump(FILE *stream)				/* output stream */
    updating the lists that point to it, which significantly improves the
    performance of (all to frequent) squash events */
 struct RS_link {
-  struct RS_link *next;			/* next entry in list */
-  struct RUU_station *rs;		/* referenced RUU resv station */
+  rslink_t next;			/* next entry in list */
   INST_TAG_TYPE tag;			/* inst instance sequence number */
+  struct RUU_station *rs;		/* referenced RUU resv station */
   union {
     tick_t when;			/* time stamp of entry (for eventq) */
     INST_SEQ_TYPE seq;			/* inst sequence */
@@ -1750,16 +2070,26 @@ struct RS_link {
   } x;
 };
 
+/* RS link pool, a single array of links that refer to each other by pool
+   index, so the lists stay compact and the pool can be grown by moving it;
+   NOTE: the pool moves when RSLINK_NEW grows it, so RS_link pointers into
+   the pool must not be held across RSLINK_NEW */
+static struct RS_link *rslink_pool;
+static unsigned int rslink_pool_size;
+
 /* RS link free list, grab RS_LINKs from here, when needed */
-static struct RS_link *rslink_free_list;
+static rslink_t rslink_free_list;
+
+/* RS link of handle L */
+#define RSLINK(L)			(&rslink_pool[(L)])
 
 /* NULL value for an RS link */
-#define RSLINK_NULL_DATA		{ NULL, NULL, 0 }
+#define RSLINK_NULL_DATA		{ RSLINK_NIL, 0, NULL }
 static struct RS_link RSLINK_NULL = RSLINK_NULL_DATA;
 
 /* create and initialize an RS link */
 #define RSLINK_INIT(RSL, RS)						\
-  ((RSL).next = NULL, (RSL).rs = (RS), (RSL).tag = (RS)->tag)
+  ((RSL).next = RSLINK_NIL, (RSL).rs = (RS), (RSL).tag = (RS)->tag)
 
 /* non-zero if RS link is NULL */
 #define RSLINK_IS_NULL(LINK)            ((LINK)->rs == NULL)
@@ -1770,71 +2100,90 @@ static struct RS_link RSLINK_NULL = RSLINK_NULL_DATA;
 /* extra RUU reservation station pointer */
 #define RSLINK_RS(LINK)                 ((LINK)->rs)
 
-/* get a new RS link record */
+/* get a new RS link record, returns its handle in DST, the pool is doubled
+   when no free links remain */
 #define RSLINK_NEW(DST, RS)						\
   { struct RS_link *n_link;						\
     if (!rslink_free_list)						\
-      panic("out of rs links");						\
-    n_link = rslink_free_list;						\
-    rslink_free_list = rslink_free_list->next;				\
-    n_link->next = NULL;						\
+      rslink_grow(2 * rslink_pool_size);				\
+    (DST) = rslink_free_list;						\
+    n_link = RSLINK(DST);						\
+    rslink_free_list = n_link->next;					\
+    n_link->next = RSLINK_NIL;						\
     n_link->rs = (RS); n_link->tag = n_link->rs->tag;			\
-    (DST) = n_link;							\
   }
 
-/* free an RS link record */
+/* free an RS link record, LINK is its handle */
 #define RSLINK_FREE(LINK)						\
-  {  struct RS_link *f_link = (LINK);					\
+  {  rslink_t f_idx = (LINK);						\
+     struct RS_link *f_link = RSLINK(f_idx);				\
      f_link->rs = NULL; f_link->tag = 0;				\
      f_link->next = rslink_free_list;					\
-     rslink_free_list = f_link;						\
+     rslink_free_list = f_idx;						\
   }
 
-/* FIXME: could this be faster!!! */
-/* free an RS link list */
+/* free an RS link list, the list is spliced onto the free list whole */
 #define RSLINK_FREE_LIST(LINK)						\
-  {  struct RS_link *fl_link, *fl_link_next;				\
-     for (fl_link=(LINK); fl_link; fl_link=fl_link_next)		\
+  {  rslink_t fl_idx = (LINK);						\
+     struct RS_link *fl_link;						\
+     if (fl_idx != RSLINK_NIL)						\
        {								\
-	 fl_link_next = fl_link->next;					\
-	 RSLINK_FREE(fl_link);						\
+	 for (fl_link=RSLINK(fl_idx); ; fl_link=RSLINK(fl_link->next))	\
+	   {								\
+	     fl_link->rs = NULL; fl_link->tag = 0;			\
+	     if (fl_link->next == RSLINK_NIL)				\
+	       break;							\
+	   }								\
+	 fl_link->next = rslink_free_list;				\
+	 rslink_free_list = fl_idx;					\
        }								\
   }
 
-/* initialize the free RS_LINK pool */
+/* grow the RS link pool to SIZE links, and put the new links on the free
+   list, lowest index first */
 static void
-rslink_init(int nlinks)			/* total number of RS_LINK available */
+rslink_grow(unsigned int size)		/* new pool size */
 {
-  int i;
+  unsigned int i;
   struct RS_link *link;
 
-  rslink_free_list = NULL;
-  for (i=0; i<nlinks; i++)
+  if (size <= rslink_pool_size)
+    fatal("out of rs links");
+
+  rslink_pool = realloc(rslink_pool, size * sizeof(struct RS_link));
+  if (!rslink_pool)
+    fatal("out of virtual memory");
+
+  for (i=size-1; i >= MAX(rslink_pool_size, 1); i--)
     {
-      link = calloc(1, sizeof(struct RS_link));
-      if (!link)
-	fatal("out of virtual memory");
+      link = RSLINK(i);
+      link->rs = NULL; link->tag = 0;
       link->next = rslink_free_list;
-      rslink_free_list = link;
+      rslink_free_list = i;
     }
+  rslink_pool_size = size;
+}
+
+/* initialize the free RS_LINK pool */
+static void
+rslink_init(int nlinks)			/* initial number of RS_LINKs */
+{
+  rslink_pool = NULL;
+  rslink_pool_size = 0;
+  rslink_free_list = RSLINK_NIL;
+
+  /* pool entry 0 is RSLINK_NIL */
+  rslink_grow(nlinks + 1);
 }
 
 /* service all functional unit release events, this function is called
-   once per cycle, and it used to step the BUSY timers attached to each
-   functional unit in the function unit resource pool, as long as a functional
-   unit's BUSY count is > 0, it cannot be issued an operation */
+   once per cycle, it releases the functional units whose issue latency
+   expires this cycle, as long as a functional unit is busy, it cannot be
+   issued an operation */
 static void
 ruu_release_fu(void)
 {
-  int i;
-
-  /* walk all resource units, decrement busy counts by one */
-  for (i=0; i<fu_pool->num_resources; i++)
-    {
-      /* resource is released when BUSY hits zero */
-      if (fu_pool->resources[i].busy > 0)
-	fu_pool->resources[i].busy--;
-    }
+  res_release(fu_pool, 1);
 }
 
 
@@ -1844,51 +2193,163 @@ ruu_release_fu(void)
  * drains this queue
  */
 
-/* pending event queue, sorted from soonest to latest event (in time), NOTE:
-   RS_LINK nodes are used for the event queue list so that it need not be
-   updated during squash events */
-static struct RS_link *event_queue;
+/* pending event queue, a timing wheel of EVENTQ_WHEEL_SIZE slots, one per
+   cycle, each slot lists the events of its cycle, latest queued first;
+   events further in the future than the wheel covers wait on an overflow
+   heap until their cycle comes within reach, NOTE: RS_LINK nodes are used
+   for the event lists so that they need not be updated during squash
+   events */
+
+/* timing wheel size, a power of two, larger than most operation latencies */
+#define EVENTQ_WHEEL_SIZE	1024
+
+static rslink_t *event_wheel;
+
+/* cycle of the slot being drained, the wheel covers events from this cycle
+   to EVENTQ_WHEEL_SIZE-1 cycles later */
+static tick_t eventq_cycle;
+
+/* number of events on the wheel */
+static int eventq_num;
+
+/* overflow heap entry, SEQ orders events of the same cycle */
+struct eventq_ent {
+  tick_t when;				/* time stamp of entry */
+  counter_t seq;			/* insertion order */
+  rslink_t ev;				/* event record */
+};
+
+/* overflow heap, a binary min-heap by (when, seq) */
+static struct eventq_ent *event_heap;
+static int event_heap_num, event_heap_size;
+static counter_t event_heap_seq;
+
+/* non-zero if overflow heap entry A is to be serviced before B */
+#define EVENTQ_ENT_BEFORE(A, B)						\
+  ((A)->when < (B)->when || ((A)->when == (B)->when && (A)->seq < (B)->seq))
 
 /* initialize the event queue structures */
 static void
 eventq_init(void)
 {
-  event_queue = NULL;
+  int i;
+
+  event_wheel = calloc(EVENTQ_WHEEL_SIZE, sizeof(rslink_t));
+  if (!event_wheel)
+    fatal("out of virtual memory");
+  for (i=0; i<EVENTQ_WHEEL_SIZE; i++)
+    event_wheel[i] = RSLINK_NIL;
+  eventq_cycle = 0;
+  eventq_num = 0;
+
+  event_heap_size = 64;
+  event_heap = calloc(event_heap_size, sizeof(struct eventq_ent));
+  if (!event_heap)
+    fatal("out of virtual memory");
+  event_heap_num = 0;
+  event_heap_seq = 0;
+}
+
+/* dump an event queue event, if it is still valid */
+static void
+eventq_dumpev(struct RS_link *ev,		/* event record */
+	      FILE *stream)			/* output stream */
+{
+  /* is event still valid? */
+  if (RSLINK_VALID(ev))
+    {
+      struct RUU_station *rs = RSLINK_RS(ev);
+
+      fprintf(stream, "idx: %2d: @ %.0f\n",
+	      (int)(rs - (rs->in_LSQ ? LSQ : RUU)), (double)ev->x.when);
+      ruu_dumpent(rs, rs - (rs->in_LSQ ? LSQ : RUU),
+		  stream, /* !header */FALSE);
+    }
 }
 
 /* dump the contents of the event queue */
 static void
 eventq_dump(FILE *stream)			/* output stream */
 {
-  struct RS_link *ev;
+  int i;
+  rslink_t ev;
 
   if (!stream)
     stream = stderr;
 
   fprintf(stream, "** event queue state **\n");
 
-  for (ev = event_queue; ev != NULL; ev = ev->next)
+  /* wheel events in time order, then the unsorted overflow heap */
+  for (i=0; i<EVENTQ_WHEEL_SIZE; i++)
     {
-      /* is event still valid? */
-      if (RSLINK_VALID(ev))
-	{
-	  struct RUU_station *rs = RSLINK_RS(ev);
+      for (ev = event_wheel[(eventq_cycle + i) & (EVENTQ_WHEEL_SIZE-1)];
+	   ev != RSLINK_NIL; ev = RSLINK(ev)->next)
+	eventq_dumpev(RSLINK(ev), stream);
+    }
+  for (i=0; i<event_heap_num; i++)
+    eventq_dumpev(RSLINK(event_heap[i].ev), stream);
+}
 
-	  fprintf(stream, "idx: %2d: @ %.0f\n",
-		  (int)(rs - (rs->in_LSQ ? LSQ : RUU)), (double)ev->x.when);
-	  ruu_dumpent(rs, rs - (rs->in_LSQ ? LSQ : RUU),
-		      stream, /* !header */FALSE);
-	}
+/* add event EV to the overflow heap */
+static void
+eventq_heap_push(rslink_t ev)			/* event record */
+{
+  int i, parent;
+  struct eventq_ent ent;
+
+  if (event_heap_num == event_heap_size)
+    {
+      event_heap_size *= 2;
+      event_heap =
+	realloc(event_heap, event_heap_size * sizeof(struct eventq_ent));
+      if (!event_heap)
+	fatal("out of virtual memory");
     }
+
+  ent.when = RSLINK(ev)->x.when;
+  ent.seq = event_heap_seq++;
+  ent.ev = ev;
+
+  /* sift up */
+  for (i = event_heap_num++; i > 0; i = parent)
+    {
+      parent = (i - 1) / 2;
+      if (!EVENTQ_ENT_BEFORE(&ent, &event_heap[parent]))
+	break;
+      event_heap[i] = event_heap[parent];
+    }
+  event_heap[i] = ent;
+}
+
+/* remove and return the earliest event on the overflow heap */
+static rslink_t
+eventq_heap_pop(void)
+{
+  int i, child;
+  rslink_t ev = event_heap[0].ev;
+  struct eventq_ent *last = &event_heap[--event_heap_num];
+
+  /* sift the last entry down from the root */
+  for (i = 0; (child = 2*i + 1) < event_heap_num; i = child)
+    {
+      if (child + 1 < event_heap_num
+	  && EVENTQ_ENT_BEFORE(&event_heap[child + 1], &event_heap[child]))
+	child++;
+      if (!EVENTQ_ENT_BEFORE(&event_heap[child], last))
+	break;
+      event_heap[i] = event_heap[child];
+    }
+  event_heap[i] = *last;
+
+  return ev;
 }
 
-/* insert an event for RS into the event queue, event queue is sorted from
-   earliest to latest event, event and associated side-effects will be
-   apparent at the start of cycle WHEN */
+/* insert an event for RS into the event queue, event and associated
+   side-effects will be apparent at the start of cycle WHEN */
 static void
 eventq_queue_event(struct RUU_station *rs, tick_t when)
 {
-  struct RS_link *prev, *ev, *new_ev;
+  rslink_t new_ev, *slot;
 
   if (rs->completed)
     panic("event completed");
@@ -1898,25 +2359,55 @@ eventq_queue_event(struct RUU_station *rs, tick_t when)
 
   /* get a free event record */
   RSLINK_NEW(new_ev, rs);
-  new_ev->x.when = when;
+  RSLINK(new_ev)->x.when = when;
+
+  if (when - eventq_cycle >= EVENTQ_WHEEL_SIZE)
+    {
+      /* beyond the wheel, wait on the overflow heap */
+      eventq_heap_push(new_ev);
+      return;
+    }
+
+  /* insert at the beginning of the slot list, events of the same cycle
+     are serviced latest queued first */
+  slot = &event_wheel[when & (EVENTQ_WHEEL_SIZE-1)];
+  RSLINK(new_ev)->next = *slot;
+  *slot = new_ev;
+  eventq_num++;
+}
 
-  /* locate insertion point */
-  for (prev=NULL, ev=event_queue;
-       ev && ev->x.when < when;
-       prev=ev, ev=ev->next);
+/* advance the wheel to the next cycle, overflow heap events of the new
+   cycle join its slot behind any events queued on the wheel, which were
+   all queued later */
+static void
+eventq_advance(void)
+{
+  rslink_t ev, list = RSLINK_NIL, *tail;
 
-  if (prev)
+  if (!eventq_num)
     {
-      /* insert middle or end */
-      new_ev->next = prev->next;
-      prev->next = new_ev;
+      /* nothing on the wheel, skip straight to the next event */
+      eventq_cycle = (event_heap_num
+		      ? MIN(sim_cycle, event_heap[0].when) : sim_cycle);
     }
   else
+    eventq_cycle++;
+
+  if (!event_heap_num || event_heap[0].when > eventq_cycle)
+    return;
+
+  /* earliest queued first off the heap, so LIST ends up latest first */
+  while (event_heap_num && event_heap[0].when <= eventq_cycle)
     {
-      /* insert at beginning */
-      new_ev->next = event_queue;
-      event_queue = new_ev;
+      ev = eventq_heap_pop();
+      RSLINK(ev)->next = list;
+      list = ev;
+      eventq_num++;
     }
+
+  for (tail = &event_wheel[eventq_cycle & (EVENTQ_WHEEL_SIZE-1)];
+       *tail != RSLINK_NIL; tail = &RSLINK(*tail)->next);
+  *tail = list;
 }
 
 /* return the next event that has already occurred, returns NULL when no
@@ -1924,144 +2415,328 @@ eventq_queue_event(struct RUU_station *rs, tick_t when)
 static struct RUU_station *
 eventq_next_event(void)
 {
-  struct RS_link *ev;
+  rslink_t ev, *slot;
 
-  if (event_queue && event_queue->x.when <= sim_cycle)
+  for (;;)
     {
-      /* unlink and return first event on priority list */
-      ev = event_queue;
-      event_queue = event_queue->next;
-
-      /* event still valid? */
-      if (RSLINK_VALID(ev))
+      slot = &event_wheel[eventq_cycle & (EVENTQ_WHEEL_SIZE-1)];
+      if (*slot != RSLINK_NIL)
 	{
-	  struct RUU_station *rs = RSLINK_RS(ev);
+	  /* unlink and return first event of the slot */
+	  ev = *slot;
+	  *slot = RSLINK(ev)->next;
+	  eventq_num--;
 
-	  /* reclaim event record */
-	  RSLINK_FREE(ev);
+	  /* event still valid? */
+	  if (RSLINK_VALID(RSLINK(ev)))
+	    {
+	      struct RUU_station *rs = RSLINK_RS(RSLINK(ev));
 
-	  /* event is valid, return resv station */
-	  return rs;
-	}
-      else
-	{
-	  /* reclaim event record */
-	  RSLINK_FREE(ev);
+	      /* reclaim event record */
+	      RSLINK_FREE(ev);
+
+	      /* event is valid, return resv station */
+	      return rs;
+	    }
 
-	  /* receiving inst was squashed, return next event */
-	  return eventq_next_event();
+	  /* receiving inst was squashed, reclaim event record and return
+	     next event */
+	  RSLINK_FREE(ev);
+	  continue;
 	}
+
+      /* slot drained, no event is ready until the next cycle */
+      if (eventq_cycle >= sim_cycle)
+	return NULL;
+      eventq_advance();
     }
-  else
+}
+
+/* return the cycle of the earliest queued event, or 0 if the queue is
+   empty, NOTE: events of squashed instructions are counted as well */
+static tick_t
+eventq_next_when(void)
+{
+  int i;
+
+  if (eventq_num)
     {
-      /* no event or no event is ready */
-      return NULL;
+      /* the wheel holds events of the next EVENTQ_WHEEL_SIZE-1 cycles, all
+	 earlier than any on the overflow heap */
+      for (i=0; i<EVENTQ_WHEEL_SIZE; i++)
+	{
+	  if (event_wheel[(eventq_cycle + i) & (EVENTQ_WHEEL_SIZE-1)]
+	      != RSLINK_NIL)
+	    return eventq_cycle + i;
+	}
+      panic("event queue count out of sync");
     }
-}
 
+  return event_heap_num ? event_heap[0].when : 0;
+}
 
 /*
  * the ready instruction queue implementation follows, the ready instruction
  * queue indicates which instruction have all of there *register* dependencies
  * satisfied, instruction will issue when 1) all memory dependencies for
  * the instruction have been satisfied (see lsq_refresh() for details on how
- * this is accomplished) and 2) resources are available; ready queue is fully
- * constructed each cycle before any operation is issued from it -- this
- * ensures that instruction issue priorities are properly observed; NOTE:
- * RS_LINK nodes are used for the event queue list so that it need not be
- * updated during squash events
+ * this is accomplished) and 2) resources are available; the ready queue is
+ * a set of bitmaps indexed by RUU and LSQ slot, one per issue priority class,
+ * ruu_issue() scans them from the RUU and LSQ heads, so it visits ready
+ * instructions oldest first and never reorders the queue; NOTE: squashed
+ * instructions are removed from the queue by ruu_recover()
  */
 
+/* a ready queue bitmap, one bit per RUU or LSQ slot */
+struct readyq_map {
+  BITMAP_PTR_TYPE map;			/* ready bitmap */
+  int sz;				/* bitmap size, in ints */
+  int num;				/* number of bits set */
+};
+
 /* the ready instruction queue */
-static struct RS_link *ready_queue;
+static struct readyq_map ready_lsq;	/* loads and stores, by LSQ slot */
+static struct readyq_map ready_ruu_hi;	/* long latency and control ops */
+static struct readyq_map ready_ruu_lo;	/* all other ops, by RUU slot */
+
+/* an oldest first scan of a ready queue bitmap */
+struct readyq_iter {
+  struct readyq_map *ready;		/* ready bitmap */
+  struct RUU_station *queue;		/* RUU or LSQ */
+  int size;				/* queue size */
+  int head;				/* queue head, the oldest slot */
+  int off;				/* next offset from HEAD to visit */
+};
 
-/* initialize the event queue structures */
+/* a scan of the ready queue in ready instruction scheduling policy order,
+   see readyq_enqueue(), HI and LSQ scan the loads/stores and long latency
+   ops, merged by age, LO all others */
+struct readyq_scan {
+  struct readyq_iter hi, lsq, lo;
+  struct RUU_station *next_hi;		/* next HI inst to visit */
+  struct RUU_station *next_lsq;		/* next LSQ inst to visit */
+};
+
+/* allocate a ready queue bitmap for a queue of SIZE slots */
 static void
-readyq_init(void)
+readyq_map_init(struct readyq_map *ready, int size)
 {
-  ready_queue = NULL;
+  ready->sz = BITMAP_SIZE(size);
+  ready->map = calloc(ready->sz, sizeof(BITMAP_ENT_TYPE));
+  if (!ready->map)
+    fatal("out of virtual memory");
+  ready->num = 0;
 }
 
-/* dump the contents of the ready queue */
+/* set bit BIT of ready queue bitmap READY */
+static INLINE void
+readyq_map_set(struct readyq_map *ready, int bit)
+{
+  (void)BITMAP_SET(ready->map, ready->sz, bit);
+  ready->num++;
+}
+
+/* clear bit BIT of ready queue bitmap READY, if it is set */
+static INLINE void
+readyq_map_clear(struct readyq_map *ready, int bit)
+{
+  if (BITMAP_SET_P(ready->map, ready->sz, bit))
+    {
+      (void)BITMAP_CLEAR(ready->map, ready->sz, bit);
+      ready->num--;
+    }
+}
+
+/* initialize the event queue structures */
 static void
-readyq_dump(FILE *stream)			/* output stream */
+readyq_init(void)
 {
-  struct RS_link *link;
+  readyq_map_init(&ready_lsq, LSQ_size);
+  readyq_map_init(&ready_ruu_hi, RUU_size);
+  readyq_map_init(&ready_ruu_lo, RUU_size);
+}
 
-  if (!stream)
-    stream = stderr;
+/* return the first bit set in MAP in [FROM, TO), or -1 if none */
+static INLINE int
+readyq_ffs(BITMAP_PTR_TYPE map, int from, int to)
+{
+  int w = from / 32, bit;
+  BITMAP_ENT_TYPE bits;
 
-  fprintf(stream, "** ready queue state **\n");
+  if (from >= to)
+    return -1;
 
-  for (link = ready_queue; link != NULL; link = link->next)
+  bits = map[w] & (~0U << (from % 32));
+  for (;;)
     {
-      /* is entry still valid? */
-      if (RSLINK_VALID(link))
+      if (bits)
 	{
-	  struct RUU_station *rs = RSLINK_RS(link);
-
-	  ruu_dumpent(rs, rs - (rs->in_LSQ ? LSQ : RUU),
-		      stream, /* header */TRUE);
+	  bit = w * 32 + BITMAP_ENT_FFS(bits);
+	  return bit < to ? bit : -1;
 	}
+      if (++w * 32 >= to)
+	return -1;
+      bits = map[w];
     }
 }
 
-/* insert ready node into the ready list using ready instruction scheduling
-   policy; currently the following scheduling policy is enforced:
-
-     memory and long latency operands, and branch instructions first
-
-   then
-
-     all other instructions, oldest instructions first
-
-  this policy works well because branches pass through the machine quicker
-  which works to reduce branch misprediction latencies, and very long latency
-  instructions (such loads and multiplies) get priority since they are very
-  likely on the program's critical path */
+/* start a scan of ready bitmap READY of queue QUEUE */
 static void
-readyq_enqueue(struct RUU_station *rs)		/* RS to enqueue */
+readyq_iter_init(struct readyq_iter *it,	/* scan state */
+		 struct readyq_map *ready,	/* ready bitmap */
+		 struct RUU_station *queue,	/* RUU or LSQ */
+		 int size,			/* queue size */
+		 int head)			/* queue head */
 {
-  struct RS_link *prev, *node, *new_node;
+  it->ready = ready;
+  it->queue = queue;
+  it->size = size;
+  it->head = head;
+  it->off = 0;
+}
 
-  /* node is now queued */
-  if (rs->queued)
-    panic("node is already queued");
-  rs->queued = TRUE;
+/* return the oldest ready instruction not yet visited by scan IT, or NULL
+   if none */
+static INLINE struct RUU_station *
+readyq_iter_next(struct readyq_iter *it)	/* scan state */
+{
+  int pos = it->head + it->off, bit;
 
-  /* get a free ready list node */
-  RSLINK_NEW(new_node, rs);
-  new_node->x.seq = rs->seq;
+  if (!it->ready->num || it->off >= it->size)
+    return NULL;
 
-  /* locate insertion point */
-  if (rs->in_LSQ || MD_OP_FLAGS(rs->op) & (F_LONGLAT|F_CTRL))
+  /* the queue is circular, scan HEAD..SIZE-1 then 0..HEAD-1 */
+  if (pos < it->size)
     {
-      /* insert loads/stores and long latency ops at the head of the queue */
-      prev = NULL;
-      node = ready_queue;
+      bit = readyq_ffs(it->ready->map, pos, it->size);
+      if (bit >= 0)
+	{
+	  it->off = bit - it->head + 1;
+	  return &it->queue[bit];
+	}
+      pos = 0;
     }
   else
+    pos -= it->size;
+
+  bit = readyq_ffs(it->ready->map, pos, it->head);
+  if (bit >= 0)
     {
-      /* otherwise insert in program order (earliest seq first) */
-      for (prev=NULL, node=ready_queue;
-	   node && node->x.seq < rs->seq;
-	   prev=node, node=node->next);
+      it->off = bit + it->size - it->head + 1;
+      return &it->queue[bit];
     }
 
-  if (prev)
+  it->off = it->size;
+  return NULL;
+}
+
+/* start a scan of the ready queue, instructions queued during the scan
+   may not be visited */
+static void
+readyq_scan_init(struct readyq_scan *scan)	/* scan state */
+{
+  readyq_iter_init(&scan->hi, &ready_ruu_hi, RUU, RUU_size, RUU_head);
+  readyq_iter_init(&scan->lsq, &ready_lsq, LSQ, LSQ_size, LSQ_head);
+  readyq_iter_init(&scan->lo, &ready_ruu_lo, RUU, RUU_size, RUU_head);
+  scan->next_hi = readyq_iter_next(&scan->hi);
+  scan->next_lsq = readyq_iter_next(&scan->lsq);
+}
+
+/* return the next instruction to visit in ready instruction scheduling
+   policy order, or NULL if the whole queue was visited */
+static INLINE struct RUU_station *
+readyq_scan_next(struct readyq_scan *scan)	/* scan state */
+{
+  struct RUU_station *rs;
+
+  if (scan->next_hi
+      && (!scan->next_lsq || scan->next_hi->seq < scan->next_lsq->seq))
+    {
+      rs = scan->next_hi;
+      scan->next_hi = readyq_iter_next(&scan->hi);
+    }
+  else if (scan->next_lsq)
+    {
+      rs = scan->next_lsq;
+      scan->next_lsq = readyq_iter_next(&scan->lsq);
+    }
+  else
+    rs = readyq_iter_next(&scan->lo);
+
+  return rs;
+}
+
+/* dump the contents of the ready queue */
+static void
+readyq_dump(FILE *stream)			/* output stream */
+{
+  struct readyq_scan scan;
+  struct RUU_station *rs;
+
+  if (!stream)
+    stream = stderr;
+
+  fprintf(stream, "** ready queue state **\n");
+
+  readyq_scan_init(&scan);
+  while ((rs = readyq_scan_next(&scan)))
+    ruu_dumpent(rs, rs - (rs->in_LSQ ? LSQ : RUU), stream, /* header */TRUE);
+}
+
+/* insert ready node into the ready queue using ready instruction scheduling
+   policy; currently the following scheduling policy is enforced:
+
+     memory and long latency operands, and branch instructions first
+
+   then
+
+     all other instructions, oldest instructions first
+
+  this policy works well because branches pass through the machine quicker
+  which works to reduce branch misprediction latencies, and very long latency
+  instructions (such loads and multiplies) get priority since they are very
+  likely on the program's critical path */
+static void
+readyq_enqueue(struct RUU_station *rs)		/* RS to enqueue */
+{
+  struct readyq_map *ready;
+  int bit;
+
+  /* node is now queued */
+  if (rs->queued)
+    panic("node is already queued");
+  rs->queued = TRUE;
+
+  if (rs->in_LSQ)
     {
-      /* insert middle or end */
-      new_node->next = prev->next;
-      prev->next = new_node;
+      ready = &ready_lsq;
+      bit = rs - LSQ;
     }
   else
     {
-      /* insert at beginning */
-      new_node->next = ready_queue;
-      ready_queue = new_node;
+      ready = ((MD_OP_FLAGS(rs->op) & (F_LONGLAT|F_CTRL))
+	       ? &ready_ruu_hi : &ready_ruu_lo);
+      bit = rs - RUU;
     }
+  readyq_map_set(ready, bit);
 }
 
+/* remove RS from the ready queue, if it is there */
+static void
+readyq_remove(struct RUU_station *rs)		/* RS to remove */
+{
+  if (!rs->queued)
+    return;
+  rs->queued = FALSE;
+
+  if (rs->in_LSQ)
+    readyq_map_clear(&ready_lsq, rs - LSQ);
+  else
+    {
+      readyq_map_clear(&ready_ruu_hi, rs - RUU);
+      readyq_map_clear(&ready_ruu_lo, rs - RUU);
+    }
+}
 
 /*
  * the create vector maps a logical register to a creator in the RUU (and
@@ -2088,13 +2763,13 @@ static struct CV_link CVLINK_NULL = { NULL, 0 };
    for fast recovery during wrong path execute (see tracer_recover() for
    details on this process */
 static BITMAP_TYPE(MD_TOTAL_REGS, use_spec_cv);
-static struct CV_link create_vector[MD_TOTAL_REGS];
-static struct CV_link spec_create_vector[MD_TOTAL_REGS];
+static struct CV_link *create_vector;
+static struct CV_link *spec_create_vector;
 
 /* these arrays shadow the create vector an indicate when a register was
    last created */
-static tick_t create_vector_rt[MD_TOTAL_REGS];
-static tick_t spec_create_vector_rt[MD_TOTAL_REGS];
+static tick_t *create_vector_rt;
+static tick_t *spec_create_vector_rt;
 
 /* read a create vector entry */
 #define CREATE_VECTOR(N)        (BITMAP_SET_P(use_spec_cv, CV_BMAP_SZ, (N))\
@@ -2118,6 +2793,14 @@ cv_init(void)
 {
   int i;
 
+  create_vector = calloc(MD_TOTAL_REGS, sizeof(struct CV_link));
+  spec_create_vector = calloc(MD_TOTAL_REGS, sizeof(struct CV_link));
+  create_vector_rt = calloc(MD_TOTAL_REGS, sizeof(tick_t));
+  spec_create_vector_rt = calloc(MD_TOTAL_REGS, sizeof(tick_t));
+  if (!create_vector || !spec_create_vector
+      || !create_vector_rt || !spec_create_vector_rt)
+    fatal("out of virtual memory");
+
   /* initially all registers are valid in the architected register file,
      i.e., the create vector entry is CVLINK_NULL */
   for (i=0; i < MD_TOTAL_REGS; i++)
@@ -2132,6 +2815,42 @@ cv_init(void)
   BITMAP_CLEAR_MAP(use_spec_cv, CV_BMAP_SZ);
 }
 
+/* rebuild the non-speculative create vector from the insts in the RUU and
+   LSQ, used after non-speculative insts have been squashed */
+static void
+cv_rebuild(void)
+{
+  int i, j;
+  struct RUU_station *rs;
+  struct CV_link *link;
+
+  for (i=0; i < MD_TOTAL_REGS; i++)
+    create_vector[i] = CVLINK_NULL;
+
+  /* each output comes from its youngest creator still executing, or
+     holding a result that may be wrong */
+  for (i=0; i < RUU_num + LSQ_num; i++)
+    {
+      rs = (i < RUU_num
+	    ? &RUU[(RUU_head + i) % RUU_size]
+	    : &LSQ[(LSQ_head + i - RUU_num) % LSQ_size]);
+      if (rs->completed && !rs->vp_dep)
+	continue;
+
+      for (j=0; j<MAX_ODEPS; j++)
+	{
+	  if (rs->onames[j] == NA)
+	    continue;
+	  link = &create_vector[rs->onames[j]];
+	  if (!link->rs || link->rs->seq < rs->seq)
+	    {
+	      link->rs = rs;
+	      link->odep_num = j;
+	    }
+	}
+    }
+}
+
 /* dump the contents of the create vector */
 static void
 cv_dump(FILE *stream)				/* output stream */
@@ -2161,6 +2880,39 @@ cv_dump(FILE *stream)				/* output stream */
  *  RUU_COMMIT() - instruction retirement pipeline stage
  */
 
+/* forward declarations */
+static void lsq_dep_ready(struct RUU_station *rs, int opnum);
+static void lsq_dep_unready(struct RUU_station *rs, int opnum);
+static void lsq_dep_remove(struct RUU_station *rs);
+static void mdp_recover(struct RUU_station *rs);
+static void fetch_squash(md_addr_t pc);
+
+/* RS, whose inputs may have been wrong values, is retiring, so its result
+   is known to be right, release the output chains kept for value recovery,
+   later consumers read the result from the architected reg file */
+static void
+ruu_vp_release(struct RUU_station *rs)		/* retiring station */
+{
+  int i;
+  struct CV_link link;
+
+  for (i=0; i<MAX_ODEPS; i++)
+    {
+      if (rs->onames[i] == NA)
+	continue;
+
+      link = create_vector[rs->onames[i]];
+      if (link.rs == rs && link.odep_num == i)
+	{
+	  create_vector[rs->onames[i]] = CVLINK_NULL;
+	  create_vector_rt[rs->onames[i]] = sim_cycle;
+	}
+
+      RSLINK_FREE_LIST(rs->odep_list[i]);
+      rs->odep_list[i] = RSLINK_NIL;
+    }
+}
+
 /* this function commits the results of the oldest completed entries from the
    RUU and LSQ to the architected reg file, stores in the LSQ will commit
    their store data to the data cache at this point as well */
@@ -2171,7 +2923,7 @@ ruu_commit(void)
   static counter_t sim_ret_insn = 0;
 
   /* all values must be retired to the architected reg file in program order */
-  while (RUU_num > 0 && committed < ruu_commit_width)
+  while (RUU_num > 0 && committed < commit_slots)
     {
       struct RUU_station *rs = &(RUU[RUU_head]);
 
@@ -2209,19 +2961,16 @@ ruu_commit(void)
 	      fu = res_get(fu_pool, MD_OP_FUCLASS(LSQ[LSQ_head].op));
 	      if (fu)
 		{
-		  /* reserve the functional unit */
-		  if (fu->master->busy)
-		    panic("functional unit already in use");
-
-		  /* schedule functional unit release event */
-		  fu->master->busy = fu->issuelat;
+		  /* reserve the functional unit, and schedule its release */
+		  res_busy(fu_pool, fu->master, fu->issuelat);
 
 		  /* go to the data cache */
 		  if (cache_dl1)
 		    {
 		      /* commit store value to D-cache */
 		      lat =
-			cache_access(cache_dl1, Write, (LSQ[LSQ_head].addr&~3),
+			cache_access(cache_dl1, Write,
+				     (LSQ[LSQ_head].addr&~3) | thread_asid,
 				     NULL, 4, sim_cycle, NULL, NULL);
 		      if (lat > cache_dl1_lat)
 			events |= PEV_CACHEMISS;
@@ -2232,7 +2981,8 @@ ruu_commit(void)
 		    {
 		      /* access the D-TLB */
 		      lat =
-			cache_access(dtlb, Read, (LSQ[LSQ_head].addr & ~3),
+			cache_access(dtlb, Read,
+				     (LSQ[LSQ_head].addr & ~3) | thread_asid,
 				     NULL, 4, sim_cycle, NULL, NULL);
 		      if (lat > 1)
 			events |= PEV_TLBMISS;
@@ -2246,12 +2996,15 @@ ruu_commit(void)
 	    }
 
 	  /* invalidate load/store operation instance */
+	  if (LSQ[LSQ_head].vp_dep)
+	    ruu_vp_release(&LSQ[LSQ_head]);
 	  LSQ[LSQ_head].tag++;
-          sim_slip += (sim_cycle - LSQ[LSQ_head].slip);
+	  lsq_dep_remove(&LSQ[LSQ_head]);
+          sim_slip += (sim_cycle - LSQ[LSQ_head].cold->slip);
 
 	  /* indicate to pipeline trace that this instruction retired */
-	  ptrace_newstage(LSQ[LSQ_head].ptrace_seq, PST_COMMIT, events);
-	  ptrace_endinst(LSQ[LSQ_head].ptrace_seq);
+	  ptrace_newstage(LSQ[LSQ_head].cold->ptrace_seq, PST_COMMIT, events);
+	  ptrace_endinst(LSQ[LSQ_head].cold->ptrace_seq);
 
 	  /* commit head of LSQ as well */
 	  LSQ_head = (LSQ_head + 1) % LSQ_size;
@@ -2263,26 +3016,28 @@ ruu_commit(void)
 	  && (MD_OP_FLAGS(rs->op) & F_CTRL))
 	{
 	  bpred_update(pred,
-		       /* branch address */rs->PC,
-		       /* actual target address */rs->next_PC,
-                       /* taken? */rs->next_PC != (rs->PC +
+		       /* branch address */rs->cold->PC,
+		       /* actual target address */rs->cold->next_PC,
+                       /* taken? */rs->cold->next_PC != (rs->cold->PC +
                                                    sizeof(md_inst_t)),
-                       /* pred taken? */rs->pred_PC != (rs->PC +
+                       /* pred taken? */rs->cold->pred_PC != (rs->cold->PC +
                                                         sizeof(md_inst_t)),
-                       /* correct pred? */rs->pred_PC == rs->next_PC,
+                       /* correct pred? */rs->cold->pred_PC == rs->cold->next_PC,
                        /* opcode */rs->op,
-                       /* dir predictor update pointer */&rs->dir_update);
+                       /* dir predictor update pointer */&rs->cold->dir_update);
 	}
 
       /* invalidate RUU operation instance */
+      if (RUU[RUU_head].vp_dep)
+	ruu_vp_release(&RUU[RUU_head]);
       RUU[RUU_head].tag++;
-      sim_slip += (sim_cycle - RUU[RUU_head].slip);
+      sim_slip += (sim_cycle - RUU[RUU_head].cold->slip);
       /* print retirement trace if in verbose mode */
       if (verbose)
 	{
 	  sim_ret_insn++;
-	  myfprintf(stderr, "%10n @ 0x%08p: ", sim_ret_insn, RUU[RUU_head].PC);
- 	  md_print_insn(RUU[RUU_head].IR, RUU[RUU_head].PC, stderr);
+	  myfprintf(stderr, "%10n @ 0x%08p: ", sim_ret_insn, RUU[RUU_head].cold->PC);
+ 	  md_print_insn(RUU[RUU_head].cold->IR, RUU[RUU_head].cold->PC, stderr);
 	  if (MD_OP_FLAGS(RUU[RUU_head].op) & F_MEM)
 	    myfprintf(stderr, "  mem: 0x%08p", RUU[RUU_head].addr);
 	  fprintf(stderr, "\n");
@@ -2290,8 +3045,8 @@ ruu_commit(void)
 	}
 
       /* indicate to pipeline trace that this instruction retired */
-      ptrace_newstage(RUU[RUU_head].ptrace_seq, PST_COMMIT, events);
-      ptrace_endinst(RUU[RUU_head].ptrace_seq);
+      ptrace_newstage(RUU[RUU_head].cold->ptrace_seq, PST_COMMIT, events);
+      ptrace_endinst(RUU[RUU_head].cold->ptrace_seq);
 
       /* commit head entry of RUU */
       RUU_head = (RUU_head + 1) % RUU_size;
@@ -2302,10 +3057,13 @@ ruu_commit(void)
 
       for (i=0; i<MAX_ODEPS; i++)
 	{
-	  if (rs->odep_list[i])
+	  if (rs->odep_list[i] != RSLINK_NIL)
 	    panic ("retired instruction has odeps\n");
         }
     }
+
+  /* committed insts use up this cycle's shared commit B/W */
+  commit_slots -= committed;
 }
 
 
@@ -2352,14 +3110,16 @@ ruu_recover(int branch_index)			/* index of mis-pred branch */
 	    {
 	      RSLINK_FREE_LIST(LSQ[LSQ_index].odep_list[i]);
 	      /* blow away the consuming op list */
-	      LSQ[LSQ_index].odep_list[i] = NULL;
+	      LSQ[LSQ_index].odep_list[i] = RSLINK_NIL;
 	    }
 
 	  /* squash this LSQ entry */
 	  LSQ[LSQ_index].tag++;
+	  readyq_remove(&LSQ[LSQ_index]);
+	  lsq_dep_remove(&LSQ[LSQ_index]);
 
 	  /* indicate in pipetrace that this instruction was squashed */
-	  ptrace_endinst(LSQ[LSQ_index].ptrace_seq);
+	  ptrace_endinst(LSQ[LSQ_index].cold->ptrace_seq);
 
 	  /* go to next earlier LSQ slot */
 	  LSQ_prev_tail = LSQ_index;
@@ -2372,14 +3132,15 @@ ruu_recover(int branch_index)			/* index of mis-pred branch */
 	{
 	  RSLINK_FREE_LIST(RUU[RUU_index].odep_list[i]);
 	  /* blow away the consuming op list */
-	  RUU[RUU_index].odep_list[i] = NULL;
+	  RUU[RUU_index].odep_list[i] = RSLINK_NIL;
 	}
 
       /* squash this RUU entry */
       RUU[RUU_index].tag++;
+      readyq_remove(&RUU[RUU_index]);
 
       /* indicate in pipetrace that this instruction was squashed */
-      ptrace_endinst(RUU[RUU_index].ptrace_seq);
+      ptrace_endinst(RUU[RUU_index].cold->ptrace_seq);
 
       /* go to next earlier slot in the RUU */
       RUU_prev_tail = RUU_index;
@@ -2407,6 +3168,91 @@ ruu_recover(int branch_index)			/* index of mis-pred branch */
 /* forward declarations */
 static void tracer_recover(void);
 
+/* load with a memory order violation to recover, or NULL */
+static struct RUU_station *mdp_violator = NULL;
+
+/* input OPNUM of RS was a wrong value, RS waits for the value again, if
+   it executed already it executes again, and so do the consumers of its
+   result, NOTE: values forwarded by stores to loads are not tracked */
+static void
+ruu_vp_reset(struct RUU_station *rs,		/* consuming station */
+	     int opnum)				/* input operand number */
+{
+  int i;
+  rslink_t olink_idx;
+  struct RS_link *olink;
+
+  if (rs->in_LSQ)
+    lsq_dep_unready(rs, opnum);
+  rs->idep_ready[opnum] = FALSE;
+
+  /* an executing consumer drops its result event when it occurs */
+  if (rs->issued && !rs->completed)
+    {
+      if (!rs->vp_reissue)
+	vp_reissue_insn++;
+      rs->vp_reissue = TRUE;
+      return;
+    }
+
+  readyq_remove(rs);
+  if (!rs->completed)
+    return;
+
+  vp_reissue_insn++;
+  rs->issued = rs->completed = FALSE;
+
+  /* a completed branch already recovered the mis-predicted path */
+  rs->recover_inst = FALSE;
+
+  /* consumers of a predicted load value took the prediction */
+  if (rs->vp_spec)
+    return;
+
+  for (i=0; i<MAX_ODEPS; i++)
+    {
+      if (rs->onames[i] == NA)
+	continue;
+
+      for (olink_idx=rs->odep_list[i];
+	   olink_idx != RSLINK_NIL;
+	   olink_idx=olink->next)
+	{
+	  olink = RSLINK(olink_idx);
+	  if (RSLINK_VALID(olink))
+	    ruu_vp_reset(olink->rs, olink->x.opnum);
+	}
+    }
+}
+
+/* recover from the mis-predicted value of load RS with reissue recovery,
+   the consumers that took the predicted value at dispatch are reset */
+static void
+ruu_vp_reissue(struct RUU_station *rs)		/* mis-predicted load */
+{
+  int i;
+  rslink_t olink_idx;
+  struct RS_link *olink;
+
+  /* later consumers wait for the loaded value */
+  rs->vp_spec = FALSE;
+
+  for (i=0; i<MAX_ODEPS; i++)
+    {
+      if (rs->onames[i] == NA)
+	continue;
+
+      for (olink_idx=rs->odep_list[i];
+	   olink_idx != RSLINK_NIL;
+	   olink_idx=olink->next)
+	{
+	  olink = RSLINK(olink_idx);
+	  if (RSLINK_VALID(olink))
+	    ruu_vp_reset(olink->rs, olink->x.opnum);
+	}
+    }
+}
+
 /* writeback completed operation results from the functional units to RUU,
    at this point, the output dependency chains of completing instructions
    are also walked to determine if any dependent instruction now has all
@@ -2421,10 +3267,37 @@ ruu_writeback(void)
   /* service all completed events */
   while ((rs = eventq_next_event()))
     {
+      /* RS executed with a wrong value, it executes again once all of its
+	 operands are ready, only loads execute in the LSQ */
+      if (rs->vp_reissue)
+	{
+	  rs->vp_reissue = FALSE;
+	  rs->issued = FALSE;
+	  if (rs->in_LSQ)
+	    lsq_dep_ready(rs, STORE_ADDR_INDEX);
+	  else if (OPERANDS_READY(rs))
+	    readyq_enqueue(rs);
+	  continue;
+	}
+
       /* RS has completed execution and (possibly) produced a result */
       if (!OPERANDS_READY(rs) || rs->queued || !rs->issued || rs->completed)
 	panic("inst completed and !ready, !issued, or completed");
 
+      /* a mis-predicted load value is detected here, with reissue recovery
+	 its consumers are reset and woken with the loaded value after the
+	 recovery latency */
+      if (rs->vp_mispred && vp_recover == vp_recover_reissue)
+	{
+	  rs->vp_mispred = FALSE;
+	  ruu_vp_reissue(rs);
+	  if (vp_recover_lat > 0)
+	    {
+	      eventq_queue_event(rs, sim_cycle + vp_recover_lat);
+	      continue;
+	    }
+	}
+
       /* operation has completed */
       rs->completed = TRUE;
 
@@ -2437,7 +3310,7 @@ ruu_writeback(void)
 	  /* recover processor state and reinit fetch to correct path */
 	  ruu_recover(rs - RUU);
 	  tracer_recover();
-	  bpred_recover(pred, rs->PC, rs->stack_recover_idx);
+	  bpred_recover(pred, rs->cold->PC, rs->cold->stack_recover_idx);
 
 	  /* stall fetch until I-fetch and I-decode recover */
 	  ruu_fetch_issue_delay = ruu_branch_penalty;
@@ -2445,6 +3318,22 @@ ruu_writeback(void)
 	  /* continue writeback of the branch/control instruction */
 	}
 
+      /* does this load reveal a mis-predicted value? */
+      if (rs->vp_mispred)
+	{
+	  int RUU_prev_num = RUU_num;
+
+	  /* squash all insts after the load, they are refetched and run
+	     again with the loaded value */
+	  ruu_recover(rs->ea_index);
+	  tracer_recover();
+	  bpred_recover(pred, rs->cold->PC, rs->cold->stack_recover_idx);
+	  vp_recover_insn += RUU_prev_num - RUU_num;
+
+	  /* stall fetch until the pipeline recovers */
+	  ruu_fetch_issue_delay = vp_recover_lat;
+	}
+
       /* if we speculatively update branch-predictor, do it here */
       if (pred
 	  && bpred_spec_update == spec_WB
@@ -2452,20 +3341,20 @@ ruu_writeback(void)
 	  && (MD_OP_FLAGS(rs->op) & F_CTRL))
 	{
 	  bpred_update(pred,
-		       /* branch address */rs->PC,
-		       /* actual target address */rs->next_PC,
-		       /* taken? */rs->next_PC != (rs->PC +
+		       /* branch address */rs->cold->PC,
+		       /* actual target address */rs->cold->next_PC,
+		       /* taken? */rs->cold->next_PC != (rs->cold->PC +
 						   sizeof(md_inst_t)),
-		       /* pred taken? */rs->pred_PC != (rs->PC +
+		       /* pred taken? */rs->cold->pred_PC != (rs->cold->PC +
 							sizeof(md_inst_t)),
-		       /* correct pred? */rs->pred_PC == rs->next_PC,
+		       /* correct pred? */rs->cold->pred_PC == rs->cold->next_PC,
 		       /* opcode */rs->op,
-		       /* dir predictor update pointer */&rs->dir_update);
+		       /* dir predictor update pointer */&rs->cold->dir_update);
 	}
 
       /* entered writeback stage, indicate in pipe trace */
-      ptrace_newstage(rs->ptrace_seq, PST_WRITEBACK,
-		      rs->recover_inst ? PEV_MPDETECT : 0);
+      ptrace_newstage(rs->cold->ptrace_seq, PST_WRITEBACK,
+		      (rs->recover_inst || rs->vp_mispred) ? PEV_MPDETECT : 0);
 
       /* broadcast results to consuming operations, this is more efficiently
          accomplished by walking the output dependency chains of the
@@ -2475,14 +3364,16 @@ ruu_writeback(void)
 	  if (rs->onames[i] != NA)
 	    {
 	      struct CV_link link;
-	      struct RS_link *olink, *olink_next;
+	      rslink_t olink_idx, olink_next;
+	      struct RS_link *olink;
 
 	      if (rs->spec_mode)
 		{
 		  /* update the speculative create vector, future operations
 		     get value from later creator or architected reg file */
 		  link = spec_create_vector[rs->onames[i]];
-		  if (/* !NULL */link.rs
+		  if (!rs->vp_dep
+		      && /* !NULL */link.rs
 		      && /* refs RS */(link.rs == rs && link.odep_num == i))
 		    {
 		      /* the result can now be read from a physical register,
@@ -2498,7 +3389,8 @@ ruu_writeback(void)
 		     operations get value from later creator or architected
 		     reg file */
 		  link = create_vector[rs->onames[i]];
-		  if (/* !NULL */link.rs
+		  if (!rs->vp_dep
+		      && /* !NULL */link.rs
 		      && /* refs RS */(link.rs == rs && link.odep_num == i))
 		    {
 		      /* the result can now be read from a physical register,
@@ -2510,18 +3402,27 @@ ruu_writeback(void)
 		}
 
 	      /* walk output list, queue up ready operations */
-	      for (olink=rs->odep_list[i]; olink; olink=olink_next)
+	      for (olink_idx=rs->odep_list[i];
+		   olink_idx != RSLINK_NIL;
+		   olink_idx=olink_next)
 		{
-		  if (RSLINK_VALID(olink))
+		  olink = RSLINK(olink_idx);
+
+		  /* consumers of a predicted value took it at dispatch */
+		  if (RSLINK_VALID(olink) && !rs->vp_spec)
 		    {
 		      if (olink->rs->idep_ready[olink->x.opnum])
 			panic("output dependence already satisfied");
 
 		      /* input is now ready */
 		      olink->rs->idep_ready[olink->x.opnum] = TRUE;
+		      if (olink->rs->in_LSQ)
+			lsq_dep_ready(olink->rs, olink->x.opnum);
 
-		      /* are all the register operands of target ready? */
-		      if (OPERANDS_READY(olink->rs))
+		      /* are all the register operands of target ready?  a
+			 target still executing with a wrong value is
+			 queued when its result event is dropped */
+		      if (OPERANDS_READY(olink->rs) && !olink->rs->issued)
 			{
 			  /* yes! enqueue instruction as ready, NOTE: stores
 			     complete at dispatch, so no need to enqueue
@@ -2537,16 +3438,26 @@ ruu_writeback(void)
 		  /* grab link to next element prior to free */
 		  olink_next = olink->next;
 
-		  /* free dependence link element */
-		  RSLINK_FREE(olink);
+		  /* free dependence link element, unless the result may be
+		     wrong and its consumers may have to be reset */
+		  if (!rs->vp_dep)
+		    RSLINK_FREE(olink_idx);
 		}
 	      /* blow away the consuming op list */
-	      rs->odep_list[i] = NULL;
+	      if (!rs->vp_dep)
+		rs->odep_list[i] = RSLINK_NIL;
 
 	    } /* if not NA output */
 
 	} /* for all outputs */
 
+      /* does a store address reveal a memory order violation? */
+      if (mdp_violator)
+	{
+	  mdp_recover(mdp_violator);
+	  mdp_violator = NULL;
+	}
+
    } /* for all writeback events */
 
 }
@@ -2556,77 +3467,607 @@ ruu_writeback(void)
  *  LSQ_REFRESH() - memory access dependence checker/scheduler
  */
 
-/* this function locates ready instructions whose memory dependencies have
-   been satisfied, this is accomplished by walking the LSQ for loads, looking
-   for blocking memory dependency condition (e.g., earlier store with an
-   unknown address) */
-#define MAX_STD_UNKNOWNS		64
+/* memory dependence state: loads whose register operands are ready wait in
+   LSQ_WAIT until no older store may write their address, stores with known
+   addresses are kept in an address hash and stores with unknown addresses
+   in LSQ_STA_UNKNOWN, so a waiting load is checked against the older stores
+   without walking the LSQ, and only after an older store resolved */
+static struct readyq_map lsq_wait;		/* loads waiting on stores */
+static struct readyq_map lsq_sta_unknown;	/* stores w/ unknown addrs */
+
+/* LSQ slot of the oldest load or store with new memory dependence state
+   since the last refresh, or -1 if none, waiting loads from this slot on
+   are checked at the next refresh */
+static int lsq_check;
+
+/* store address hash, buckets list stores by LSQ slot, chained through
+   st_next, -1 terminated */
+static int *lsq_store_hash;
+static md_addr_t lsq_store_hash_mask;
+#define LSQ_STORE_HASH(ADDR)		(((ADDR) >> 2) & lsq_store_hash_mask)
+
+/* age of LSQ slot INDEX, i.e., its offset from the LSQ head */
+#define LSQ_OFFSET(INDEX)						\
+  ((INDEX) >= LSQ_head ? (INDEX) - LSQ_head : (INDEX) + LSQ_size - LSQ_head)
+
+/* non-zero if RS is a load or a store */
+#define LSQ_IS_LOAD(RS)							\
+  ((MD_OP_FLAGS((RS)->op) & (F_MEM|F_LOAD)) == (F_MEM|F_LOAD))
+#define LSQ_IS_STORE(RS)						\
+  ((MD_OP_FLAGS((RS)->op) & (F_MEM|F_STORE)) == (F_MEM|F_STORE))
+
+/* memory dependence predictor, with a predictor other than none a load may
+   issue ahead of older stores with unknown addresses: with blind all loads
+   do, with wait those whose wait table bit is clear do, and with storeset a
+   load only waits for the last fetched store in its store set (and, as
+   stores in a set are ordered, the stores before it in the set) */
+static char *mdp_wait_table;		/* wait table, by load PC */
+static int *mdp_ssit;			/* store set id table, by PC, or -1 */
+static struct lsq_link *mdp_lfst;	/* last fetched store, by set id */
+static tick_t mdp_clear_cycle;		/* next predictor clear */
+#define MDP_INDEX(PC)		(((PC) / sizeof(md_inst_t)) & (mdp_size - 1))
+
+/* a load that may read from an older store with an unknown address without
+   waiting for it is checkpointed at dispatch, as it is executed there and
+   so are the insts after it: the checkpoint holds the non-speculative trace
+   generator state after the load, and while any checkpoint is live the old
+   contents of memory written by non-speculative stores are logged, so a
+   violation can rewind the trace to the load; the undo log holds at most
+   one entry per store in the LSQ */
+struct mdp_ckpt {
+  struct regs_t regs;			/* registers after the load */
+  counter_t num_insn;			/* thread's committed counters at the
+					   load */
+  counter_t num_refs;
+  counter_t num_loads;
+  counter_t num_branches;
+  unsigned long log_pos;		/* undo log tail at the load */
+};
+static struct mdp_ckpt *mdp_ckpts;	/* checkpoints, by LSQ slot */
+static struct readyq_map mdp_ckpt_map;	/* live checkpoints */
+
+struct mdp_log_ent {
+  md_addr_t addr;			/* store address */
+  int nbytes;				/* store size */
+  byte_t data[sizeof(qword_t)];		/* old contents of memory */
+};
+static struct mdp_log_ent *mdp_log;	/* undo log, a ring of LSQ_size */
+static unsigned long mdp_log_head;	/* oldest entry of a live ckpt */
+static unsigned long mdp_log_tail;	/* next entry */
+
+/* initialize the memory dependence state */
 static void
-lsq_refresh(void)
+lsq_dep_init(void)
+{
+  int i, size;
+
+  readyq_map_init(&lsq_wait, LSQ_size);
+  readyq_map_init(&lsq_sta_unknown, LSQ_size);
+  lsq_check = -1;
+
+  /* at least two buckets per LSQ entry */
+  for (size = 1; size < 2*LSQ_size; size <<= 1);
+  lsq_store_hash = calloc(size, sizeof(int));
+  if (!lsq_store_hash)
+    fatal("out of virtual memory");
+  for (i=0; i<size; i++)
+    lsq_store_hash[i] = -1;
+  lsq_store_hash_mask = size - 1;
+
+  if (mdp_type == mdp_none)
+    return;
+
+  if (mdp_type == mdp_wait)
+    {
+      mdp_wait_table = calloc(mdp_size, sizeof(char));
+      if (!mdp_wait_table)
+	fatal("out of virtual memory");
+    }
+  else if (mdp_type == mdp_storeset)
+    {
+      mdp_ssit = calloc(mdp_size, sizeof(int));
+      mdp_lfst = calloc(mdp_lfst_size, sizeof(struct lsq_link));
+      if (!mdp_ssit || !mdp_lfst)
+	fatal("out of virtual memory");
+      for (i=0; i<mdp_size; i++)
+	mdp_ssit[i] = -1;
+    }
+  mdp_clear_cycle = mdp_clear;
+
+  mdp_ckpts = calloc(LSQ_size, sizeof(struct mdp_ckpt));
+  mdp_log = calloc(LSQ_size, sizeof(struct mdp_log_ent));
+  if (!mdp_ckpts || !mdp_log)
+    fatal("out of virtual memory");
+  readyq_map_init(&mdp_ckpt_map, LSQ_size);
+  mdp_log_head = mdp_log_tail = 0;
+}
+
+/* note new memory dependence state at LSQ slot INDEX */
+static INLINE void
+lsq_dep_touch(int index)
+{
+  if (lsq_check < 0 || LSQ_OFFSET(index) < LSQ_OFFSET(lsq_check))
+    lsq_check = index;
+}
+
+/* add store RS, its address is now known, to the store address hash */
+static void
+lsq_store_insert(struct RUU_station *rs)	/* store LSQ entry */
 {
-  int i, j, index, n_std_unknowns;
-  md_addr_t std_unknowns[MAX_STD_UNKNOWNS];
-
-  /* scan entire queue for ready loads: scan from oldest instruction
-     (head) until we reach the tail or an unresolved store, after which no
-     other instruction will become ready */
-  for (i=0, index=LSQ_head, n_std_unknowns=0;
-       i < LSQ_num;
-       i++, index=(index + 1) % LSQ_size)
+  int *bucket = &lsq_store_hash[LSQ_STORE_HASH(rs->addr)];
+
+  readyq_map_clear(&lsq_sta_unknown, rs - LSQ);
+  rs->st_next = *bucket;
+  *bucket = rs - LSQ;
+}
+
+/* remove store RS from the store address hash */
+static void
+lsq_store_remove(struct RUU_station *rs)	/* store LSQ entry */
+{
+  int *link;
+
+  for (link = &lsq_store_hash[LSQ_STORE_HASH(rs->addr)];
+       *link != rs - LSQ;
+       link = &LSQ[*link].st_next)
     {
-      /* terminate search for ready loads after first unresolved store,
-	 as no later load could be resolved in its presence */
-      if (/* store? */
-	  (MD_OP_FLAGS(LSQ[index].op) & (F_MEM|F_STORE)) == (F_MEM|F_STORE))
+      if (*link < 0)
+	panic("store not in the store address hash");
+    }
+  *link = rs->st_next;
+}
+
+/* return the youngest store older than load RS with a known address that
+   writes its address, or NULL if none */
+static struct RUU_station *
+lsq_store_alias(struct RUU_station *rs)		/* load LSQ entry */
+{
+  int index, off, ld_off = LSQ_OFFSET(rs - LSQ), st_off = -1;
+  struct RUU_station *st = NULL;
+
+  for (index = lsq_store_hash[LSQ_STORE_HASH(rs->addr)];
+       index >= 0;
+       index = LSQ[index].st_next)
+    {
+      /* FIXME: not dealing with partials! */
+      off = LSQ_OFFSET(index);
+      if (LSQ[index].addr == rs->addr && off < ld_off && off > st_off)
 	{
-	  if (!STORE_ADDR_READY(&LSQ[index]))
-	    {
-	      /* FIXME: a later STD + STD known could hide the STA unknown */
-	      /* sta unknown, blocks all later loads, stop search */
-	      break;
-	    }
-	  else if (!OPERANDS_READY(&LSQ[index]))
-	    {
-	      /* sta known, but std unknown, may block a later store, record
-		 this address for later referral, we use an array here because
-		 for most simulations the number of entries to search will be
-		 very small */
-	      if (n_std_unknowns == MAX_STD_UNKNOWNS)
-		fatal("STD unknown array overflow, increase MAX_STD_UNKNOWNS");
-	      std_unknowns[n_std_unknowns++] = LSQ[index].addr;
-	    }
-	  else /* STORE_ADDR_READY() && OPERANDS_READY() */
-	    {
-	      /* a later STD known hides an earlier STD unknown */
-	      for (j=0; j<n_std_unknowns; j++)
-		{
-		  if (std_unknowns[j] == /* STA/STD known */LSQ[index].addr)
-		    std_unknowns[j] = /* bogus addr */0;
-		}
-	    }
+	  st = &LSQ[index];
+	  st_off = off;
+	}
+    }
+  return st;
+}
+
+/* return the store older than load RS with an unknown address that RS
+   reads from, or NULL if RS reads from a store with a known address or
+   from memory, addresses are known to the trace generator long before the
+   pipeline computes them */
+static struct RUU_station *
+lsq_store_producer(struct RUU_station *rs)	/* load LSQ entry */
+{
+  struct readyq_iter it;
+  struct RUU_station *st, *known, *unknown = NULL;
+  int ld_off = LSQ_OFFSET(rs - LSQ);
+
+  if (!lsq_sta_unknown.num)
+    return NULL;
+
+  readyq_iter_init(&it, &lsq_sta_unknown, LSQ, LSQ_size, LSQ_head);
+  while ((st = readyq_iter_next(&it)) && LSQ_OFFSET(st - LSQ) < ld_off)
+    {
+      /* FIXME: not dealing with partials! */
+      if (st->addr == rs->addr)
+	unknown = st;
+    }
+
+  known = lsq_store_alias(rs);
+  if (unknown && known && LSQ_OFFSET(known - LSQ) > LSQ_OFFSET(unknown - LSQ))
+    return NULL;
+  return unknown;
+}
+
+/* clear the memory dependence predictor if its clear interval expired */
+static void
+mdp_clear_tables(void)
+{
+  int i;
+
+  if (!mdp_clear || sim_cycle < mdp_clear_cycle)
+    return;
+  mdp_clear_cycle = sim_cycle + mdp_clear;
+
+  if (mdp_type == mdp_wait)
+    memset(mdp_wait_table, 0, mdp_size);
+  else if (mdp_type == mdp_storeset)
+    {
+      for (i=0; i<mdp_size; i++)
+	mdp_ssit[i] = -1;
+    }
+}
+
+/* predict the memory dependences of load or store RS at dispatch */
+static void
+mdp_predict(struct RUU_station *rs)		/* LSQ entry */
+{
+  int ssid;
+
+  rs->mdp_wait = (mdp_type == mdp_none);
+  rs->mdp_pred.rs = NULL;
+  if (mdp_type == mdp_none || mdp_type == mdp_blind)
+    return;
+
+  mdp_clear_tables();
+  if (mdp_type == mdp_wait)
+    {
+      if (LSQ_IS_LOAD(rs))
+	rs->mdp_wait = mdp_wait_table[MDP_INDEX(rs->cold->PC)];
+      return;
+    }
+
+  /* store sets, loads wait for the last fetched store in their set, which
+     in turn waits for the store fetched before it */
+  ssid = mdp_ssit[MDP_INDEX(rs->cold->PC)];
+  if (ssid < 0)
+    return;
+  if (LSQLINK_VALID(mdp_lfst[ssid]))
+    rs->mdp_pred = mdp_lfst[ssid];
+  if (LSQ_IS_STORE(rs))
+    LSQLINK_INIT(mdp_lfst[ssid], rs);
+}
+
+/* train the memory dependence predictor on a violation of load RS */
+static void
+mdp_train(struct RUU_station *rs,		/* load LSQ entry */
+	  struct RUU_station *st)		/* store it reads from */
+{
+  int *ld_ssid, *st_ssid;
+
+  if (mdp_type == mdp_wait)
+    mdp_wait_table[MDP_INDEX(rs->cold->PC)] = TRUE;
+  else if (mdp_type == mdp_storeset)
+    {
+      /* put the load and the store into the same set, merging sets into
+	 the one with the smaller id */
+      ld_ssid = &mdp_ssit[MDP_INDEX(rs->cold->PC)];
+      st_ssid = &mdp_ssit[MDP_INDEX(st->cold->PC)];
+      if (*ld_ssid < 0 && *st_ssid < 0)
+	*ld_ssid = *st_ssid = MDP_INDEX(rs->cold->PC) & (mdp_lfst_size - 1);
+      else if (*ld_ssid < 0)
+	*ld_ssid = *st_ssid;
+      else if (*st_ssid < 0 || *st_ssid > *ld_ssid)
+	*st_ssid = *ld_ssid;
+      else
+	*ld_ssid = *st_ssid;
+    }
+}
+
+/* non-zero if load RS waits for store ST, in the predicted store's set */
+static int
+mdp_waits_for(struct RUU_station *rs,		/* load LSQ entry */
+	      struct RUU_station *st)		/* store LSQ entry */
+{
+  struct lsq_link link;
+
+  if (rs->mdp_wait)
+    return TRUE;
+  for (link = rs->mdp_pred; LSQLINK_VALID(link); link = link.rs->mdp_pred)
+    {
+      if (link.rs == st)
+	return TRUE;
+    }
+  return FALSE;
+}
+
+/* non-zero if the stores load RS is predicted to depend on are resolved,
+   i.e., the predicted store and those before it in its set */
+static int
+mdp_stores_ready(struct RUU_station *rs)	/* load LSQ entry */
+{
+  struct lsq_link link;
+
+  for (link = rs->mdp_pred; LSQLINK_VALID(link); link = link.rs->mdp_pred)
+    {
+      if (!STORE_ADDR_READY(link.rs))
+	return FALSE;
+    }
+  return TRUE;
+}
+
+/* checkpoint the trace generator after load RS, which may violate */
+static void
+mdp_ckpt_take(struct RUU_station *rs)		/* load LSQ entry */
+{
+  struct mdp_ckpt *ckpt = &mdp_ckpts[rs - LSQ];
+
+  ckpt->regs = regs;
+  ckpt->num_insn = thread_num_insn;
+  ckpt->num_refs = thread_num_refs;
+  ckpt->num_loads = thread_num_loads;
+  ckpt->num_branches = thread_num_branches;
+  ckpt->log_pos = mdp_log_tail;
+  if (!mdp_ckpt_map.num)
+    mdp_log_head = mdp_log_tail;
+
+  rs->mdp_ckpt = TRUE;
+  readyq_map_set(&mdp_ckpt_map, rs - LSQ);
+}
+
+/* release the checkpoint of load RS, it can no longer violate */
+static void
+mdp_ckpt_release(struct RUU_station *rs)	/* load LSQ entry */
+{
+  struct readyq_iter it;
+  struct RUU_station *oldest;
+
+  rs->mdp_ckpt = FALSE;
+  readyq_map_clear(&mdp_ckpt_map, rs - LSQ);
+
+  /* the undo log is needed back to the oldest live checkpoint */
+  readyq_iter_init(&it, &mdp_ckpt_map, LSQ, LSQ_size, LSQ_head);
+  oldest = readyq_iter_next(&it);
+  mdp_log_head = oldest ? mdp_ckpts[oldest - LSQ].log_pos : mdp_log_tail;
+}
+
+/* log the contents of memory at ADDR, about to be written by a
+   non-speculative store, while there are live checkpoints */
+static void
+mdp_log_store(md_addr_t addr,			/* store address */
+	      int nbytes)			/* store size */
+{
+  struct mdp_log_ent *ent;
+
+  if (mdp_log_tail - mdp_log_head >= LSQ_size)
+    panic("memory dependence undo log overflow");
+
+  ent = &mdp_log[mdp_log_tail++ % LSQ_size];
+  ent->addr = addr;
+  ent->nbytes = nbytes;
+  mem_access(mem, Read, addr, ent->data, nbytes);
+}
+
+/* load or store RS entered the LSQ */
+static void
+lsq_dep_dispatch(struct RUU_station *rs)	/* LSQ entry */
+{
+  struct RUU_station *st;
+
+  rs->mdp_ckpt = rs->mdp_false = FALSE;
+  rs->mdp_true.rs = NULL;
+  mdp_predict(rs);
+
+  if (LSQ_IS_STORE(rs))
+    {
+      if (STORE_ADDR_READY(rs))
+	lsq_store_insert(rs);
+      else
+	readyq_map_set(&lsq_sta_unknown, rs - LSQ);
+    }
+  else if (LSQ_IS_LOAD(rs))
+    {
+      /* a correct path load that reads from a store with an unknown
+	 address without waiting for it may violate */
+      if ((st = lsq_store_producer(rs)) != NULL)
+	{
+	  LSQLINK_INIT(rs->mdp_true, st);
+	  if (!rs->spec_mode && !mdp_waits_for(rs, st))
+	    mdp_ckpt_take(rs);
 	}
 
-      if (/* load? */
-	  ((MD_OP_FLAGS(LSQ[index].op) & (F_MEM|F_LOAD)) == (F_MEM|F_LOAD))
-	  && /* queued? */!LSQ[index].queued
-	  && /* waiting? */!LSQ[index].issued
-	  && /* completed? */!LSQ[index].completed
-	  && /* regs ready? */OPERANDS_READY(&LSQ[index]))
+      if (OPERANDS_READY(rs))
 	{
-	  /* no STA unknown conflict (because we got to this check), check for
-	     a STD unknown conflict */
-	  for (j=0; j<n_std_unknowns; j++)
-	    {
-	      /* found a relevant STD unknown? */
-	      if (std_unknowns[j] == LSQ[index].addr)
-		break;
-	    }
-	  if (j == n_std_unknowns)
+	  readyq_map_set(&lsq_wait, rs - LSQ);
+	  lsq_dep_touch(rs - LSQ);
+	}
+    }
+}
+
+/* the address of store ST is known, check the checkpointed loads that
+   read from it, those that issued violated, the others need not wait for
+   another store any more, and are checked again against ST */
+static void
+mdp_check(struct RUU_station *st)		/* store LSQ entry */
+{
+  struct readyq_iter it;
+  struct RUU_station *rs;
+
+  readyq_iter_init(&it, &mdp_ckpt_map, LSQ, LSQ_size, LSQ_head);
+  it.off = LSQ_OFFSET(st - LSQ) + 1;
+  while ((rs = readyq_iter_next(&it)))
+    {
+      if (rs->mdp_true.rs != st || !LSQLINK_VALID(rs->mdp_true))
+	continue;
+
+      if (rs->issued)
+	{
+	  /* violation, recovered after writeback of the store address */
+	  if (!mdp_violator
+	      || LSQ_OFFSET(rs - LSQ) < LSQ_OFFSET(mdp_violator - LSQ))
+	    mdp_violator = rs;
+	  continue;
+	}
+
+      mdp_ckpt_release(rs);
+      readyq_remove(rs);
+      if (OPERANDS_READY(rs))
+	{
+	  readyq_map_set(&lsq_wait, rs - LSQ);
+	  lsq_dep_touch(rs - LSQ);
+	}
+    }
+}
+
+/* input operand OPNUM of load or store RS is now ready */
+static void
+lsq_dep_ready(struct RUU_station *rs,		/* LSQ entry */
+	      int opnum)			/* input operand number */
+{
+  if (LSQ_IS_STORE(rs))
+    {
+      /* STA or STD known, later loads may no longer be blocked */
+      if (opnum == STORE_ADDR_INDEX)
+	{
+	  lsq_store_insert(rs);
+	  if (mdp_ckpt_map.num)
+	    mdp_check(rs);
+	}
+      lsq_dep_touch(rs - LSQ);
+    }
+  else if (LSQ_IS_LOAD(rs) && OPERANDS_READY(rs) && !rs->issued)
+    {
+      readyq_map_set(&lsq_wait, rs - LSQ);
+      lsq_dep_touch(rs - LSQ);
+    }
+}
+
+/* input operand OPNUM of load or store RS is no longer ready, its producer
+   executes again */
+static void
+lsq_dep_unready(struct RUU_station *rs,		/* LSQ entry */
+		int opnum)			/* input operand number */
+{
+  if (LSQ_IS_STORE(rs))
+    {
+      /* the store address is unknown again, later loads wait for it */
+      if (opnum == STORE_ADDR_INDEX && STORE_ADDR_READY(rs))
+	{
+	  lsq_store_remove(rs);
+	  readyq_map_set(&lsq_sta_unknown, rs - LSQ);
+	}
+    }
+  else if (LSQ_IS_LOAD(rs))
+    readyq_map_clear(&lsq_wait, rs - LSQ);
+}
+
+/* load or store RS left the LSQ, it was committed or squashed */
+static void
+lsq_dep_remove(struct RUU_station *rs)		/* LSQ entry */
+{
+  if (LSQ_IS_STORE(rs))
+    {
+      if (STORE_ADDR_READY(rs))
+	lsq_store_remove(rs);
+      else
+	readyq_map_clear(&lsq_sta_unknown, rs - LSQ);
+    }
+  else
+    {
+      readyq_map_clear(&lsq_wait, rs - LSQ);
+      if (rs->mdp_ckpt)
+	mdp_ckpt_release(rs);
+    }
+}
+
+/* recover from the memory order violation of load RS: the insts after it
+   are squashed and refetched, the trace generator is rewound to the load's
+   checkpoint, and the load executes again once its store is ready */
+static void
+mdp_recover(struct RUU_station *rs)		/* load LSQ entry */
+{
+  struct mdp_ckpt *ckpt = &mdp_ckpts[rs - LSQ];
+  struct mdp_log_ent *ent;
+  int RUU_prev_num = RUU_num;
+
+  mdp_violations++;
+  mdp_train(rs, rs->mdp_true.rs);
+
+  /* squash all insts after the load, and any mis-speculated trace */
+  ruu_recover(rs->ea_index);
+  if (spec_mode)
+    tracer_recover();
+  mdp_recover_insn += RUU_prev_num - RUU_num;
+
+  /* rewind the non-speculative trace to the load */
+  while (mdp_log_tail != ckpt->log_pos)
+    {
+      ent = &mdp_log[--mdp_log_tail % LSQ_size];
+      mem_access(mem, Write, ent->addr, ent->data, ent->nbytes);
+    }
+  regs = ckpt->regs;
+  sim_num_insn -= thread_num_insn - ckpt->num_insn;
+  thread_num_insn = ckpt->num_insn;
+  sim_num_refs -= thread_num_refs - ckpt->num_refs;
+  thread_num_refs = ckpt->num_refs;
+  sim_num_loads -= thread_num_loads - ckpt->num_loads;
+  thread_num_loads = ckpt->num_loads;
+  sim_num_branches -= thread_num_branches - ckpt->num_branches;
+  thread_num_branches = ckpt->num_branches;
+  mdp_ckpt_release(rs);
+  cv_rebuild();
+
+  /* refetch after the load */
+  fetch_squash(regs.regs_NPC);
+  bpred_recover(pred, rs->cold->PC, rs->cold->stack_recover_idx);
+  ruu_fetch_issue_delay = ruu_branch_penalty;
+
+  /* the load executes again, its consumers take the new value, a load
+     executing with a wrong address already drops its result event */
+  rs->vp_spec = rs->vp_mispred = FALSE;
+  if (!rs->vp_reissue)
+    {
+      rs->tag++;
+      rs->issued = rs->completed = FALSE;
+      lsq_dep_ready(rs, STORE_ADDR_INDEX);
+    }
+}
+
+/* this function locates ready instructions whose memory dependencies have
+   been satisfied, this is accomplished by checking the loads waiting for
+   memory dependencies for blocking memory dependency condition (e.g., earlier
+   store with an unknown address), only loads at or after the oldest load
+   or store with new dependence state since the last call are checked */
+static void
+lsq_refresh(void)
+{
+  struct readyq_iter it;
+  struct RUU_station *rs, *st;
+  int sta_off;
+
+  if (lsq_check < 0)
+    return;
+  if (!lsq_wait.num)
+    {
+      lsq_check = -1;
+      return;
+    }
+
+  /* the first unresolved store blocks all later loads that wait for all
+     older stores, as no later load could be resolved in its presence */
+  readyq_iter_init(&it, &lsq_sta_unknown, LSQ, LSQ_size, LSQ_head);
+  st = readyq_iter_next(&it);
+  sta_off = st ? LSQ_OFFSET(st - LSQ) : LSQ_size;
+
+  /* check the waiting loads, oldest first */
+  readyq_iter_init(&it, &lsq_wait, LSQ, LSQ_size, LSQ_head);
+  it.off = LSQ_OFFSET(lsq_check);
+  lsq_check = -1;
+  while ((rs = readyq_iter_next(&it)))
+    {
+      /* a load waiting for an unresolved store is held back by a false
+	 dependence if it reads from no store with an unknown address */
+      if (rs->mdp_wait
+	  ? LSQ_OFFSET(rs - LSQ) > sta_off : !mdp_stores_ready(rs))
+	{
+	  if (!rs->mdp_false && !rs->spec_mode
+	      && !(LSQLINK_VALID(rs->mdp_true)
+		   && !STORE_ADDR_READY(rs->mdp_true.rs)))
 	    {
-	      /* no STA or STD unknown conflicts, put load on ready queue */
-	      readyq_enqueue(&LSQ[index]);
+	      rs->mdp_false = TRUE;
+	      mdp_false_deps++;
 	    }
+	  continue;
 	}
+
+      /* no STA unknown conflict, check for a STD unknown conflict, a later
+	 STD known hides an earlier STD unknown */
+      st = lsq_store_alias(rs);
+      if (st && !OPERANDS_READY(st))
+	continue;
+
+      /* no STA or STD unknown conflicts, put load on ready queue */
+      readyq_map_clear(&lsq_wait, rs - LSQ);
+      readyq_enqueue(rs);
     }
 }
 
@@ -2645,239 +4086,201 @@ lsq_refresh(void)
 static void
 ruu_issue(void)
 {
-  int i, load_lat, tlb_lat, n_issued;
-  struct RS_link *node, *next_node;
+  int load_lat, tlb_lat, n_issued;
+  struct readyq_scan scan;
+  struct RUU_station *rs;
   struct res_template *fu;
 
-  /* FIXME: could be a little more efficient when scanning the ready queue */
-
-  /* copy and then blow away the ready list, NOTE: the ready list is
-     always totally reclaimed each cycle, and instructions that are not
-     issue are explicitly reinserted into the ready instruction queue,
-     this management strategy ensures that the ready instruction queue
-     is always properly sorted */
-  node = ready_queue;
-  ready_queue = NULL;
+  /* scan the ready queue in ready instruction scheduling policy order,
+     instructions that do not issue stay queued in place, so the scan is
+     always properly sorted */
+  readyq_scan_init(&scan);
 
   /* visit all ready instructions (i.e., insts whose register input
      dependencies have been satisfied, stop issue when no more instructions
      are available or issue bandwidth is exhausted */
   for (n_issued=0;
-       node && n_issued < ruu_issue_width;
-       node = next_node)
+       n_issued < issue_slots && (rs = readyq_scan_next(&scan));
+       /* nada */)
     {
-      next_node = node->next;
-
-      /* still valid? */
-      if (RSLINK_VALID(node))
+      /* issue operation, both reg and mem deps have been satisfied */
+      if (!OPERANDS_READY(rs) || !rs->queued
+	  || rs->issued || rs->completed)
+	panic("issued inst !ready, issued, or completed");
+
+      /* node is now un-queued */
+      readyq_remove(rs);
+
+      /* a load that would miss while all dl1 MSHRs are busy cannot
+	 start, leave it on the ready list until an MSHR frees up */
+      if (rs->in_LSQ
+	  && ((MD_OP_FLAGS(rs->op) & (F_MEM|F_LOAD)) == (F_MEM|F_LOAD))
+	  && cache_dl1 && cache_dl1->nmshrs
+	  && MD_VALID_ADDR(rs->addr) && !lsq_store_alias(rs)
+	  && !cache_mshr_avail(cache_dl1, (rs->addr & ~3) | thread_asid,
+			       sim_cycle))
 	{
-	  struct RUU_station *rs = RSLINK_RS(node);
-
-	  /* issue operation, both reg and mem deps have been satisfied */
-	  if (!OPERANDS_READY(rs) || !rs->queued
-	      || rs->issued || rs->completed)
-	    panic("issued inst !ready, issued, or completed");
-
-	  /* node is now un-queued */
-	  rs->queued = FALSE;
-
-	  if (rs->in_LSQ
-	      && ((MD_OP_FLAGS(rs->op) & (F_MEM|F_STORE)) == (F_MEM|F_STORE)))
-	    {
-	      /* stores complete in effectively zero time, result is
-		 written into the load/store queue, the actual store into
-		 the memory system occurs when the instruction is retired
-		 (see ruu_commit()) */
-	      rs->issued = TRUE;
-	      rs->completed = TRUE;
-	      if (rs->onames[0] || rs->onames[1])
-		panic("store creates result");
-
-	      if (rs->recover_inst)
-		panic("mis-predicted store");
-
-	      /* entered execute stage, indicate in pipe trace */
-	      ptrace_newstage(rs->ptrace_seq, PST_WRITEBACK, 0);
+	  sim_mshr_stalls++;
+	  readyq_enqueue(rs);
+	  continue;
+	}
 
-	      /* one more inst issued */
-	      n_issued++;
-	    }
-	  else
+      if (rs->in_LSQ
+	  && ((MD_OP_FLAGS(rs->op) & (F_MEM|F_STORE)) == (F_MEM|F_STORE)))
+	{
+	  /* stores complete in effectively zero time, result is
+	     written into the load/store queue, the actual store into
+	     the memory system occurs when the instruction is retired
+	     (see ruu_commit()) */
+	  rs->issued = TRUE;
+	  rs->completed = TRUE;
+	  if (rs->onames[0] || rs->onames[1])
+	    panic("store creates result");
+
+	  if (rs->recover_inst)
+	    panic("mis-predicted store");
+
+	  /* entered execute stage, indicate in pipe trace */
+	  ptrace_newstage(rs->cold->ptrace_seq, PST_WRITEBACK, 0);
+
+	  /* one more inst issued */
+	  n_issued++;
+	}
+      else
+	{
+	  /* issue the instruction to a functional unit */
+	  if (MD_OP_FUCLASS(rs->op) != NA)
 	    {
-	      /* issue the instruction to a functional unit */
-	      if (MD_OP_FUCLASS(rs->op) != NA)
+	      fu = res_get(fu_pool, MD_OP_FUCLASS(rs->op));
+	      if (fu)
 		{
-		  fu = res_get(fu_pool, MD_OP_FUCLASS(rs->op));
-		  if (fu)
+		  /* got one! issue inst to functional unit */
+		  rs->issued = TRUE;
+		  /* reserve the functional unit, and schedule its release */
+		  res_busy(fu_pool, fu->master, fu->issuelat);
+
+		  /* schedule a result writeback event */
+		  if (rs->in_LSQ
+		      && ((MD_OP_FLAGS(rs->op) & (F_MEM|F_LOAD))
+			  == (F_MEM|F_LOAD)))
 		    {
-		      /* got one! issue inst to functional unit */
-		      rs->issued = TRUE;
-		      /* reserve the functional unit */
-		      if (fu->master->busy)
-			panic("functional unit already in use");
-
-		      /* schedule functional unit release event */
-		      fu->master->busy = fu->issuelat;
-
-		      /* schedule a result writeback event */
-		      if (rs->in_LSQ
-			  && ((MD_OP_FLAGS(rs->op) & (F_MEM|F_LOAD))
-			      == (F_MEM|F_LOAD)))
+		      int events = 0;
+
+		      /* for loads, determine cache access latency:
+			 first scan LSQ to see if a store forward is
+			 possible, if not, access the data cache */
+		      load_lat = 0;
+		      if (lsq_store_alias(rs))
+			{
+			  /* hit in the LSQ */
+			  load_lat = 1;
+			}
+
+		      /* was the value store forwared from the LSQ? */
+		      if (!load_lat)
 			{
-			  int events = 0;
-
-			  /* for loads, determine cache access latency:
-			     first scan LSQ to see if a store forward is
-			     possible, if not, access the data cache */
-			  load_lat = 0;
-			  i = (rs - LSQ);
-			  if (i != LSQ_head)
-			    {
-			      for (;;)
-				{
-				  /* go to next earlier LSQ entry */
-				  i = (i + (LSQ_size-1)) % LSQ_size;
-
-				  /* FIXME: not dealing with partials! */
-				  if ((MD_OP_FLAGS(LSQ[i].op) & F_STORE)
-				      && (LSQ[i].addr == rs->addr))
-				    {
-				      /* hit in the LSQ */
-				      load_lat = 1;
-				      break;
-				    }
-
-				  /* scan finished? */
-				  if (i == LSQ_head)
-				    break;
-				}
-			    }
+			  int valid_addr = MD_VALID_ADDR(rs->addr);
+
+			  if (!spec_mode && !valid_addr)
+			    sim_invalid_addrs++;
 
-			  /* was the value store forwared from the LSQ? */
-			  if (!load_lat)
+			  /* no! go to the data cache if addr is valid */
+			  if (cache_dl1 && valid_addr)
 			    {
-			      int valid_addr = MD_VALID_ADDR(rs->addr);
-
-			      if (!spec_mode && !valid_addr)
-				sim_invalid_addrs++;
-
-			      /* no! go to the data cache if addr is valid */
-			      if (cache_dl1 && valid_addr)
-				{
-				  /* access the cache if non-faulting */
-				  load_lat =
-				    cache_access(cache_dl1, Read,
-						 (rs->addr & ~3), NULL, 4,
-						 sim_cycle, NULL, NULL);
-				  if (load_lat > cache_dl1_lat)
-				    events |= PEV_CACHEMISS;
-				}
-			      else
-				{
-				  /* no caches defined, just use op latency */
-				  load_lat = fu->oplat;
-				}
+			      /* access the cache if non-faulting */
+			      load_lat =
+				cache_access(cache_dl1, Read,
+					     (rs->addr & ~3) | thread_asid,
+					     NULL, 4,
+					     sim_cycle, NULL, NULL);
+			      if (load_lat > cache_dl1_lat)
+				events |= PEV_CACHEMISS;
 			    }
-
-			  /* all loads and stores must to access D-TLB */
-			  if (dtlb && MD_VALID_ADDR(rs->addr))
+			  else
 			    {
-			      /* access the D-DLB, NOTE: this code will
-				 initiate speculative TLB misses */
-			      tlb_lat =
-				cache_access(dtlb, Read, (rs->addr & ~3),
-					     NULL, 4, sim_cycle, NULL, NULL);
-			      if (tlb_lat > 1)
-				events |= PEV_TLBMISS;
-
-			      /* D-cache/D-TLB accesses occur in parallel */
-			      load_lat = MAX(tlb_lat, load_lat);
+			      /* no caches defined, just use op latency */
+			      load_lat = fu->oplat;
 			    }
-
-			  /* use computed cache access latency */
-			  eventq_queue_event(rs, sim_cycle + load_lat);
-
-			  /* entered execute stage, indicate in pipe trace */
-			  ptrace_newstage(rs->ptrace_seq, PST_EXECUTE,
-					  ((rs->ea_comp ? PEV_AGEN : 0)
-					   | events));
 			}
-		      else /* !load && !store */
-			{
-			  /* use deterministic functional unit latency */
-			  eventq_queue_event(rs, sim_cycle + fu->oplat);
 
-			  /* entered execute stage, indicate in pipe trace */
-			  ptrace_newstage(rs->ptrace_seq, PST_EXECUTE,
-					  rs->ea_comp ? PEV_AGEN : 0);
+		      /* all loads and stores must to access D-TLB */
+		      if (dtlb && MD_VALID_ADDR(rs->addr))
+			{
+			  /* access the D-DLB, NOTE: this code will
+			     initiate speculative TLB misses */
+			  tlb_lat =
+			    cache_access(dtlb, Read,
+					 (rs->addr & ~3) | thread_asid,
+					 NULL, 4, sim_cycle, NULL, NULL);
+			  if (tlb_lat > 1)
+			    events |= PEV_TLBMISS;
+
+			  /* D-cache/D-TLB accesses occur in parallel */
+			  load_lat = MAX(tlb_lat, load_lat);
 			}
 
-		      /* one more inst issued */
-		      n_issued++;
+		      /* use computed cache access latency */
+		      eventq_queue_event(rs, sim_cycle + load_lat);
+
+		      /* entered execute stage, indicate in pipe trace */
+		      ptrace_newstage(rs->cold->ptrace_seq, PST_EXECUTE,
+				      ((rs->ea_comp ? PEV_AGEN : 0)
+				       | events));
 		    }
-		  else /* no functional unit */
+		  else /* !load && !store */
 		    {
-		      /* insufficient functional unit resources, put operation
-			 back onto the ready list, we'll try to issue it
-			 again next cycle */
-		      readyq_enqueue(rs);
-		    }
-		}
-	      else /* does not require a functional unit! */
-		{
-		  /* FIXME: need better solution for these */
-		  /* the instruction does not need a functional unit */
-		  rs->issued = TRUE;
+		      int lat = fu->oplat;
+
+		      /* debug: delay the address of a store */
+		      if (lsq_sta_delay && rs->ea_comp)
+			{
+			  enum md_opcode op;
 
-		  /* schedule a result event */
-		  eventq_queue_event(rs, sim_cycle + 1);
+			  MD_SET_OPCODE(op, rs->cold->IR);
+			  if (MD_OP_FLAGS(op) & F_STORE)
+			    lat += lsq_sta_delay;
+			}
+
+		      /* use deterministic functional unit latency */
+		      eventq_queue_event(rs, sim_cycle + lat);
 
-		  /* entered execute stage, indicate in pipe trace */
-		  ptrace_newstage(rs->ptrace_seq, PST_EXECUTE,
-				  rs->ea_comp ? PEV_AGEN : 0);
+		      /* entered execute stage, indicate in pipe trace */
+		      ptrace_newstage(rs->cold->ptrace_seq, PST_EXECUTE,
+				      rs->ea_comp ? PEV_AGEN : 0);
+		    }
 
 		  /* one more inst issued */
 		  n_issued++;
 		}
-	    } /* !store */
-
-	}
-      /* else, RUU entry was squashed */
-
-      /* reclaim ready list entry, NOTE: this is done whether or not the
-         instruction issued, since the instruction was once again reinserted
-         into the ready queue if it did not issue, this ensures that the ready
-         queue is always properly sorted */
-      RSLINK_FREE(node);
-    }
-
-  /* put any instruction not issued back into the ready queue, go through
-     normal channels to ensure instruction stay ordered correctly */
-  for (; node; node = next_node)
-    {
-      next_node = node->next;
-
-      /* still valid? */
-      if (RSLINK_VALID(node))
-        {
-	  struct RUU_station *rs = RSLINK_RS(node);
+	      else /* no functional unit */
+		{
+		  /* insufficient functional unit resources, put operation
+		     back onto the ready list, we'll try to issue it
+		     again next cycle */
+		  readyq_enqueue(rs);
+		}
+	    }
+	  else /* does not require a functional unit! */
+	    {
+	      /* FIXME: need better solution for these */
+	      /* the instruction does not need a functional unit */
+	      rs->issued = TRUE;
 
-          /* node is now un-queued */
-          rs->queued = FALSE;
+	      /* schedule a result event */
+	      eventq_queue_event(rs, sim_cycle + 1);
 
-	  /* not issued, put operation back onto the ready list, we'll try to
-	     issue it again next cycle */
-          readyq_enqueue(rs);
-        }
-      /* else, RUU entry was squashed */
+	      /* entered execute stage, indicate in pipe trace */
+	      ptrace_newstage(rs->cold->ptrace_seq, PST_EXECUTE,
+			      rs->ea_comp ? PEV_AGEN : 0);
 
-      /* reclaim ready list entry, NOTE: this is done whether or not the
-         instruction issued, since the instruction was once again reinserted
-         into the ready queue if it did not issue, this ensures that the ready
-         queue is always properly sorted */
-      RSLINK_FREE(node);
+	      /* one more inst issued */
+	      n_issued++;
+	    }
+	} /* !store */
     }
 
+  /* issued insts use up this cycle's shared issue B/W */
+  issue_slots -= n_issued;
 }
 
 
@@ -2946,23 +4349,27 @@ rspec_dump(FILE *stream)			/* output stream */
 }
 
 
-/* speculative memory hash table size, NOTE: this must be a power-of-two */
-#define STORE_HASH_SIZE		32
+/* initial speculative memory buffer size, NOTE: this must be a
+   power-of-two */
+#define SPEC_MEM_SIZE		256
 
-/* speculative memory hash table definition, accesses go through this hash
-   table when accessing memory in speculative mode, the hash table flush the
-   table when recovering from mispredicted branches */
+/* speculative memory buffer definition, accesses go through this buffer
+   when accessing memory in speculative mode, it is an open addressed hash
+   table, linearly probed, that is kept at most half full by doubling it;
+   an entry is only live if it was written in the current generation, so
+   the buffer is flushed when recovering from mispredicted branches by
+   starting a new generation */
 struct spec_mem_ent {
-  struct spec_mem_ent *next;		/* ptr to next hash table bucket */
   md_addr_t addr;			/* virtual address of spec state */
+  unsigned int gen;			/* generation entry was written in */
   unsigned int data[2];			/* spec buffer, up to 8 bytes */
 };
 
-/* speculative memory hash table */
-static struct spec_mem_ent *store_htable[STORE_HASH_SIZE];
-
-/* speculative memory hash table bucket free list */
-static struct spec_mem_ent *bucket_free_list = NULL;
+/* speculative memory buffer */
+static struct spec_mem_ent *spec_mem;
+static unsigned int spec_mem_size;	/* entries, a power of two */
+static unsigned int spec_mem_num;	/* live entries */
+static unsigned int spec_mem_gen;	/* current generation */
 
 
 /* program counter */
@@ -2993,7 +4400,6 @@ static void
 tracer_recover(void)
 {
   int i;
-  struct spec_mem_ent *ent, *ent_next;
 
   /* better be in mis-speculative trace generation mode */
   if (!spec_mode)
@@ -3007,20 +4413,25 @@ tracer_recover(void)
   BITMAP_CLEAR_MAP(use_spec_F, F_BMAP_SZ);
   BITMAP_CLEAR_MAP(use_spec_C, C_BMAP_SZ);
 
-  /* reset memory state back to non-speculative state */
-  /* FIXME: could version stamps be used here?!?!? */
-  for (i=0; i<STORE_HASH_SIZE; i++)
+  /* reset memory state back to non-speculative state, all entries of the
+     speculative memory buffer die with their generation, clear the buffer
+     only when the generation number wraps */
+  spec_mem_num = 0;
+  if (++spec_mem_gen == 0)
     {
-      /* release all hash table buckets */
-      for (ent=store_htable[i]; ent; ent=ent_next)
-	{
-	  ent_next = ent->next;
-	  ent->next = bucket_free_list;
-	  bucket_free_list = ent;
-	}
-      store_htable[i] = NULL;
+      for (i=0; i < spec_mem_size; i++)
+	spec_mem[i].gen = 0;
+      spec_mem_gen = 1;
     }
 
+  /* restart fetch on the correct path */
+  fetch_squash(recover_PC);
+}
+
+/* squash the IFETCH -> DISPATCH queue and restart fetch at PC */
+static void
+fetch_squash(md_addr_t pc)			/* new fetch PC */
+{
   /* if pipetracing, indicate squash of instructions in the inst fetch queue */
   if (ptrace_active)
     {
@@ -3038,15 +4449,13 @@ tracer_recover(void)
   /* reset IFETCH state */
   fetch_num = 0;
   fetch_tail = fetch_head = 0;
-  fetch_pred_PC = fetch_regs_PC = recover_PC;
+  fetch_pred_PC = fetch_regs_PC = pc;
 }
 
 /* initialize the speculative instruction state generator state */
 static void
 tracer_init(void)
 {
-  int i;
-
   /* initially in non-speculative mode */
   spec_mode = FALSE;
 
@@ -3055,15 +4464,60 @@ tracer_init(void)
   BITMAP_CLEAR_MAP(use_spec_F, F_BMAP_SZ);
   BITMAP_CLEAR_MAP(use_spec_C, C_BMAP_SZ);
 
-  /* memory state is from non-speculative memory pages */
-  for (i=0; i<STORE_HASH_SIZE; i++)
-    store_htable[i] = NULL;
+  /* memory state is from non-speculative memory pages, generation zero
+     entries are never live */
+  spec_mem_size = SPEC_MEM_SIZE;
+  spec_mem = calloc(spec_mem_size, sizeof(struct spec_mem_ent));
+  if (!spec_mem)
+    fatal("out of virtual memory");
+  spec_mem_num = 0;
+  spec_mem_gen = 1;
 }
 
 
-/* speculative memory hash table address hash function */
+/* speculative memory buffer address hash function */
 #define HASH_ADDR(ADDR)							\
-  ((((ADDR) >> 24)^((ADDR) >> 16)^((ADDR) >> 8)^(ADDR)) & (STORE_HASH_SIZE-1))
+  ((((ADDR) >> 2) ^ ((ADDR) >> 18)) & (spec_mem_size - 1))
+
+/* return the live speculative memory buffer entry of ADDR, or the free
+   entry it would be allocated in */
+static struct spec_mem_ent *
+spec_mem_lookup(md_addr_t addr)			/* virtual address */
+{
+  struct spec_mem_ent *ent;
+  unsigned int index;
+
+  for (index = HASH_ADDR(addr); ; index = (index + 1) & (spec_mem_size - 1))
+    {
+      ent = &spec_mem[index];
+      if (ent->gen != spec_mem_gen || ent->addr == addr)
+	return ent;
+    }
+}
+
+/* double the size of the speculative memory buffer, rehashing the live
+   entries */
+static void
+spec_mem_grow(void)
+{
+  struct spec_mem_ent *old = spec_mem, *ent;
+  unsigned int i, old_size = spec_mem_size;
+
+  spec_mem_size *= 2;
+  spec_mem = calloc(spec_mem_size, sizeof(struct spec_mem_ent));
+  if (!spec_mem)
+    fatal("out of virtual memory");
+
+  for (i=0; i < old_size; i++)
+    {
+      if (old[i].gen == spec_mem_gen)
+	{
+	  ent = spec_mem_lookup(old[i].addr);
+	  *ent = old[i];
+	}
+    }
+  free(old);
+}
 
 /* this functional provides a layer of mis-speculated state over the
    non-speculative memory state, when in mis-speculation trace generation mode,
@@ -3081,8 +4535,9 @@ spec_mem_access(struct mem_t *mem,		/* memory space to access */
 		void *p,			/* input/output buffer */
 		int nbytes)			/* number of bytes to access */
 {
-  int i, index;
-  struct spec_mem_ent *ent, *prev;
+  int i;
+  struct spec_mem_ent *ent;
+  static struct spec_mem_ent discard;
 
   /* FIXME: partially overlapping writes are not combined... */
   /* FIXME: partially overlapping reads are not handled correctly... */
@@ -3110,44 +4565,28 @@ spec_mem_access(struct mem_t *mem,		/* memory space to access */
     }
 
   /* has this memory state been copied on mis-speculative write? */
-  index = HASH_ADDR(addr);
-  for (prev=NULL,ent=store_htable[index]; ent; prev=ent,ent=ent->next)
-    {
-      if (ent->addr == addr)
-	{
-	  /* reorder chains to speed access into hash table */
-	  if (prev != NULL)
-	    {
-	      /* not at head of list, relink the hash table entry at front */
-	      prev->next = ent->next;
-              ent->next = store_htable[index];
-              store_htable[index] = ent;
-	    }
-	  break;
-	}
-    }
+  ent = spec_mem_lookup(addr);
+  if (ent->gen != spec_mem_gen)
+    ent = NULL;
 
-  /* no, if it is a write, allocate a hash table entry to hold the data */
+  /* no, if it is a write, allocate a buffer entry to hold the data */
   if (!ent && cmd == Write)
     {
-      /* try to get an entry from the free list, if available */
-      if (!bucket_free_list)
+      if (bugcompat_mode)
 	{
-	  /* otherwise, call calloc() to get the needed storage */
-	  bucket_free_list = calloc(1, sizeof(struct spec_mem_ent));
-	  if (!bucket_free_list)
-	    fatal("out of virtual memory");
+	  /* the write is lost */
+	  ent = &discard;
 	}
-      ent = bucket_free_list;
-      bucket_free_list = bucket_free_list->next;
-
-      if (!bugcompat_mode)
+      else
 	{
-	  /* insert into hash table */
-	  ent->next = store_htable[index];
-	  store_htable[index] = ent;
+	  /* keep the buffer at most half full */
+	  if (2*(spec_mem_num + 1) > spec_mem_size)
+	    spec_mem_grow();
+	  ent = spec_mem_lookup(addr);
 	  ent->addr = addr;
+	  ent->gen = spec_mem_gen;
 	  ent->data[0] = 0; ent->data[1] = 0;
+	  spec_mem_num++;
 	}
     }
 
@@ -3263,16 +4702,16 @@ mspec_dump(FILE *stream)			/* output stream */
 
   fprintf(stream, "spec_mode: %s\n", spec_mode ? "t" : "f");
 
-  for (i=0; i<STORE_HASH_SIZE; i++)
+  for (i=0; i < spec_mem_size; i++)
     {
-      /* dump contents of all hash table buckets */
-      for (ent=store_htable[i]; ent; ent=ent->next)
-	{
-	  myfprintf(stream, "[0x%08p]: %12.0f/0x%08x:%08x\n",
-		    ent->addr, (double)(*((double *)ent->data)),
-		    *((unsigned int *)&ent->data[0]),
-		    *(((unsigned int *)&ent->data[0]) + 1));
-	}
+      /* dump contents of all live buffer entries */
+      ent = &spec_mem[i];
+      if (ent->gen != spec_mem_gen)
+	continue;
+      myfprintf(stream, "[0x%08p]: %12.0f/0x%08x:%08x\n",
+		ent->addr, (double)(*((double *)ent->data)),
+		*((unsigned int *)&ent->data[0]),
+		*(((unsigned int *)&ent->data[0]) + 1));
     }
 }
 
@@ -3322,7 +4761,7 @@ ruu_link_idep(struct RUU_station *rs,		/* rs station to link */
 	      int idep_name)			/* input register name */
 {
   struct CV_link head;
-  struct RS_link *link;
+  rslink_t link;
 
   /* any dependence? */
   if (idep_name == NA)
@@ -3345,13 +4784,28 @@ ruu_link_idep(struct RUU_station *rs,		/* rs station to link */
     }
   /* else, creator operation will make this value sometime in the future */
 
-  /* indicate value will be created sometime in the future, i.e., operand
-     is not yet ready for use */
-  rs->idep_ready[idep_num] = FALSE;
+  /* a load with a predicted value provides it at dispatch, as does a
+     completed creator whose result may be wrong, with reissue recovery RS
+     is still linked, so it can be reset if the value is wrong */
+  if (head.rs->vp_spec || head.rs->completed)
+    {
+      rs->idep_ready[idep_num] = TRUE;
+      if (vp_recover == vp_recover_squash)
+	return;
+      rs->vp_dep = TRUE;
+    }
+  else
+    {
+      /* indicate value will be created sometime in the future, i.e.,
+	 operand is not yet ready for use */
+      rs->idep_ready[idep_num] = FALSE;
+      if (head.rs->vp_dep)
+	rs->vp_dep = TRUE;
+    }
 
   /* link onto creator's output list of dependant operand */
-  RSLINK_NEW(link, rs); link->x.opnum = idep_num;
-  link->next = head.rs->odep_list[head.odep_num];
+  RSLINK_NEW(link, rs); RSLINK(link)->x.opnum = idep_num;
+  RSLINK(link)->next = head.rs->odep_list[head.odep_num];
   head.rs->odep_list[head.odep_num] = link;
 }
 
@@ -3376,7 +4830,7 @@ ruu_install_odep(struct RUU_station *rs,	/* creating RUU station */
   rs->onames[odep_num] = odep_name;
 
   /* initialize output chain to empty list */
-  rs->odep_list[odep_num] = NULL;
+  rs->odep_list[odep_num] = RSLINK_NIL;
 
   /* indicate this operation is latest creator of ODEP_NAME */
   CVLINK_INIT(cv, rs, odep_num);
@@ -3590,7 +5044,8 @@ ruu_install_odep(struct RUU_station *rs,	/* creating RUU station */
   (DST_V = (SRC), addr = (DST),						\
    (spec_mode								\
     ? ((FAULT) = spec_mem_access(mem, Write, addr, &DST_V, sizeof(DST_V)))\
-    : ((FAULT) = mem_access(mem, Write, addr, &DST_V, sizeof(DST_V)))))
+    : ((mdp_ckpt_map.num ? mdp_log_store(addr, sizeof(DST_V)) : (void)0),\
+       (FAULT) = mem_access(mem, Write, addr, &DST_V, sizeof(DST_V)))))
 
 #define WRITE_BYTE(SRC, DST, FAULT)					\
   __WRITE_SPECMEM((SRC), (DST), temp_byte, (FAULT))
@@ -3607,7 +5062,7 @@ ruu_install_odep(struct RUU_station *rs,	/* creating RUU station */
 #define SYSCALL(INST)							\
   (/* only execute system calls in non-speculative mode */		\
    (spec_mode ? panic("speculative syscall") : (void) 0),		\
-   sys_syscall(&regs, mem_access, mem, INST, TRUE))
+   sys_syscall(&regs, mem_access, mem, INST, TRUE, thread_num_insn))
 
 /* default register state accessor, used by DLite */
 static char *					/* err str, NULL for no err */
@@ -3751,6 +5206,7 @@ ruu_dispatch(void)
   int is_write;				/* store? */
   int made_check;			/* used to ensure DLite entry */
   int br_taken, br_pred_taken;		/* if br, taken?  predicted taken? */
+  int ld_vp_spec, ld_vp_mispred;	/* load value used?  mis-predicted? */
   int fetch_redirected = FALSE;
   byte_t temp_byte = 0;			/* temp variable for spec mem access */
   half_t temp_half = 0;			/* " ditto " */
@@ -3763,7 +5219,7 @@ ruu_dispatch(void)
   made_check = FALSE;
   n_dispatched = 0;
   while (/* instruction decode B/W left? */
-	 n_dispatched < (ruu_decode_width * fetch_speed)
+	 n_dispatched < dispatch_slots
 	 /* RUU and LSQ not full? */
 	 && RUU_num < RUU_size && LSQ_num < LSQ_size
 	 /* insts still available from fetch unit? */
@@ -3794,29 +5250,6 @@ ruu_dispatch(void)
       /* compute default next PC */
       regs.regs_NPC = regs.regs_PC + sizeof(md_inst_t);
 
-      /*start-new*/
-      if(is_PRED)
-      {
-        int data;
-        int found;
-        VAL_TAG_TYPE calc_val;
-        mem_access(mem,Read,addr,&data,sizeof(word_t));
-        calc_val.value.single_p = data;
-        calc_val.fsm_pred = MISS;
-        lookup(addr,inst,&pred_val_main,mem);
-        found = update(addr,inst,pred_val_main,calc_val,common_ref++);
-        if(found == MISS)
-        {
-          allocate(addr,inst,calc_val,common_ref++);
-          num_of_vpred_misses++;
-        }
-        else
-        {
-          num_of_vpred_hits++;
-        }
-      }
-      /*end-new*/
-
       /* drain RUU for TRAPs and system calls */
       if (MD_OP_FLAGS(op) & F_TRAP)
 	{
@@ -3839,6 +5272,7 @@ ruu_dispatch(void)
 	{
 	  /* one more non-speculative instruction executed */
 	  sim_num_insn++;
+	  thread_num_insn++;
 	}
 
       /* default effective address (none) and access */
@@ -3911,7 +5345,10 @@ ruu_dispatch(void)
 	{
 	  sim_total_refs++;
 	  if (!spec_mode)
-	    sim_num_refs++;
+	    {
+	      sim_num_refs++;
+	      thread_num_refs++;
+	    }
 
 	  if (MD_OP_FLAGS(op) & F_STORE)
 	    is_write = TRUE;
@@ -3919,7 +5356,37 @@ ruu_dispatch(void)
 	    {
 	      sim_total_loads++;
 	      if (!spec_mode)
-		sim_num_loads++;
+		{
+		  sim_num_loads++;
+		  thread_num_loads++;
+		}
+	    }
+	}
+
+      /* predict the loaded value, then train on the actual one, only
+	 loads on the correct path see architected memory */
+      ld_vp_spec = ld_vp_mispred = FALSE;
+      if (vpred && !spec_mode && is_PRED)
+	{
+	  word_t data;
+	  VAL_TAG_TYPE calc_val, pred_val;
+
+	  mem_access(mem, Read, addr, &data, sizeof(word_t));
+	  calc_val.value.single_p = data;
+	  calc_val.fsm_pred = MISS;
+	  vpred_access(vpred, regs.regs_PC, addr, inst, calc_val, &pred_val);
+
+	  /* speculate on a confident prediction, i.e., one the fsm gates
+	     through (-vp:spec sets -vp:fsm), whether it is right is known
+	     now but only acted upon when the load writes back */
+	  if (vp_spec && pred_val.fsm_pred == 1)
+	    {
+	      ld_vp_spec = TRUE;
+	      ld_vp_mispred =
+		(pred_val.value.single_p != calc_val.value.single_p);
+	      vp_spec_loads++;
+	      if (ld_vp_mispred)
+		vp_spec_wrong++;
 	    }
 	}
 
@@ -3973,22 +5440,24 @@ ruu_dispatch(void)
 
 	  /* fill in RUU reservation station */
 	  rs = &RUU[RUU_tail];
-          rs->slip = sim_cycle - 1;
-	  rs->IR = inst;
+          rs->cold->slip = sim_cycle - 1;
+	  rs->cold->IR = inst;
 	  rs->op = op;
-	  rs->PC = regs.regs_PC;
-	  rs->next_PC = regs.regs_NPC; rs->pred_PC = pred_PC;
+	  rs->cold->PC = regs.regs_PC;
+	  rs->cold->next_PC = regs.regs_NPC; rs->cold->pred_PC = pred_PC;
 	  rs->in_LSQ = FALSE;
 	  rs->ea_comp = FALSE;
 	  rs->recover_inst = FALSE;
-          rs->dir_update = *dir_update_ptr;
-	  rs->stack_recover_idx = stack_recover_idx;
+          rs->cold->dir_update = *dir_update_ptr;
+	  rs->cold->stack_recover_idx = stack_recover_idx;
 	  rs->spec_mode = spec_mode;
 	  rs->addr = 0;
 	  /* rs->tag is already set */
 	  rs->seq = ++inst_seq;
 	  rs->queued = rs->issued = rs->completed = FALSE;
-	  rs->ptrace_seq = pseq;
+	  rs->vp_spec = rs->vp_mispred = FALSE;
+	  rs->vp_dep = rs->vp_reissue = FALSE;
+	  rs->cold->ptrace_seq = pseq;
 
 	  /* split ld/st's into two operations: eff addr comp + mem access */
 	  if (MD_OP_FLAGS(op) & F_MEM)
@@ -3999,27 +5468,31 @@ ruu_dispatch(void)
 
 	      /* fill in LSQ reservation station */
 	      lsq = &LSQ[LSQ_tail];
-              lsq->slip = sim_cycle - 1;
-	      lsq->IR = inst;
+              lsq->cold->slip = sim_cycle - 1;
+	      lsq->cold->IR = inst;
 	      lsq->op = op;
-	      lsq->PC = regs.regs_PC;
-	      lsq->next_PC = regs.regs_NPC; lsq->pred_PC = pred_PC;
+	      lsq->cold->PC = regs.regs_PC;
+	      lsq->cold->next_PC = regs.regs_NPC; lsq->cold->pred_PC = pred_PC;
 	      lsq->in_LSQ = TRUE;
 	      lsq->ea_comp = FALSE;
 	      lsq->recover_inst = FALSE;
-	      lsq->dir_update.pdir1 = lsq->dir_update.pdir2 = NULL;
-	      lsq->dir_update.pmeta = NULL;
-	      lsq->stack_recover_idx = 0;
+	      lsq->cold->dir_update.pdir1 = lsq->cold->dir_update.pdir2 = NULL;
+	      lsq->cold->dir_update.pmeta = NULL;
+	      lsq->cold->stack_recover_idx = stack_recover_idx;
 	      lsq->spec_mode = spec_mode;
 	      lsq->addr = addr;
 	      /* lsq->tag is already set */
 	      lsq->seq = ++inst_seq;
 	      lsq->queued = lsq->issued = lsq->completed = FALSE;
-	      lsq->ptrace_seq = ptrace_seq++;
+	      lsq->vp_spec = ld_vp_spec;
+	      lsq->vp_mispred = ld_vp_mispred;
+	      lsq->vp_dep = lsq->vp_reissue = FALSE;
+	      lsq->ea_index = RUU_tail;
+	      lsq->cold->ptrace_seq = ptrace_seq++;
 
 	      /* pipetrace this uop */
-	      ptrace_newuop(lsq->ptrace_seq, "internal ld/st", lsq->PC, 0);
-	      ptrace_newstage(lsq->ptrace_seq, PST_DISPATCH, 0);
+	      ptrace_newuop(lsq->cold->ptrace_seq, "internal ld/st", lsq->cold->PC, 0);
+	      ptrace_newstage(lsq->cold->ptrace_seq, PST_DISPATCH, 0);
 
 	      /* link eff addr computation onto operand's output chains */
 	      ruu_link_idep(rs, /* idep_ready[] index */0, NA);
@@ -4042,6 +5515,7 @@ ruu_dispatch(void)
 	      /* install output after inputs to prevent self reference */
 	      ruu_install_odep(lsq, /* odep_list[] index */0, out1);
 	      ruu_install_odep(lsq, /* odep_list[] index */1, out2);
+	      lsq_dep_dispatch(lsq);
 
 	      /* install operation in the RUU and LSQ */
 	      n_dispatched++;
@@ -4121,6 +5595,7 @@ ruu_dispatch(void)
 	  if (MD_OP_FLAGS(op) & F_CTRL)
 	    {
 	      sim_num_branches++;
+	      thread_num_branches++;
 	      if (pred && bpred_spec_update == spec_ID)
 		{
 		  bpred_update(pred,
@@ -4132,7 +5607,7 @@ ruu_dispatch(void)
 							sizeof(md_inst_t)),
 			       /* correct pred? */pred_PC == regs.regs_NPC,
 			       /* opcode */op,
-			       /* predictor update ptr */&rs->dir_update);
+			       /* predictor update ptr */&rs->cold->dir_update);
 		}
 	    }
 
@@ -4144,6 +5619,13 @@ ruu_dispatch(void)
 	      rs->recover_inst = TRUE;
 	      recover_PC = regs.regs_NPC;
 	    }
+	  /* with squash recovery, insts after a mis-predicted load value
+	     are on a mis-speculated path until the load writes back */
+	  else if (ld_vp_mispred && vp_recover == vp_recover_squash)
+	    {
+	      spec_mode = TRUE;
+	      recover_PC = regs.regs_NPC;
+	    }
 	}
 
       /* entered decode/allocate stage, indicate in pipe trace */
@@ -4183,6 +5665,9 @@ ruu_dispatch(void)
 	dlite_main(regs.regs_PC, pred_PC, sim_cycle, &regs, mem);
     }
 
+  /* dispatched insts use up this cycle's shared decode B/W */
+  dispatch_slots -= n_dispatched;
+
   /* need to enter DLite at least once per cycle */
   if (!made_check)
     {
@@ -4255,6 +5740,13 @@ fetch_dump(FILE *stream)			/* output stream */
 static int last_inst_missed = FALSE;
 static int last_inst_tmissed = FALSE;
 
+/* fetch fill buffer, holds the I-cache block of the last fetch miss from
+   the cycle its fill completes, used with SMT threads only, so threads that
+   conflict in the I-cache cannot keep evicting each other's blocks before
+   they are fetched */
+static md_addr_t fetch_fill_blk = 0;
+static tick_t fetch_fill_ready = 0;
+
 /* fetch up as many instruction as one branch prediction and one cache line
    acess will support without overflowing the IFETCH -> DISPATCH QUEUE */
 static void
@@ -4264,6 +5756,7 @@ ruu_fetch(void)
   md_inst_t inst;
   int stack_recover_idx;
   int branch_cnt;
+  md_addr_t blk;
 
   for (i=0, branch_cnt=0;
        /* fetch up to as many instruction as the DISPATCH stage can decode */
@@ -4291,7 +5784,8 @@ ruu_fetch(void)
 	    {
 	      /* access the I-cache */
 	      lat =
-		cache_access(cache_il1, Read, IACOMPRESS(fetch_regs_PC),
+		cache_access(cache_il1, Read,
+			     IACOMPRESS(fetch_regs_PC) | thread_asid,
 			     NULL, ISCOMPRESS(sizeof(md_inst_t)), sim_cycle,
 			     NULL, NULL);
 	      if (lat > cache_il1_lat)
@@ -4303,7 +5797,8 @@ ruu_fetch(void)
 	      /* access the I-TLB, NOTE: this code will initiate
 		 speculative TLB misses */
 	      tlb_lat =
-		cache_access(itlb, Read, IACOMPRESS(fetch_regs_PC),
+		cache_access(itlb, Read,
+			     IACOMPRESS(fetch_regs_PC) | thread_asid,
 			     NULL, ISCOMPRESS(sizeof(md_inst_t)), sim_cycle,
 			     NULL, NULL);
 	      if (tlb_lat > 1)
@@ -4314,10 +5809,16 @@ ruu_fetch(void)
 	    }
 
 	  /* I-cache/I-TLB miss? assumes I-cache hit >= I-TLB hit */
-	  if (lat != cache_il1_lat)
+	  blk = ((IACOMPRESS(fetch_regs_PC) | thread_asid)
+		 & ~(md_addr_t)(cache_il1 ? cache_il1->bsize - 1 : 0));
+	  if (lat != cache_il1_lat
+	      && (smt_nthreads == 1
+		  || blk != fetch_fill_blk || sim_cycle < fetch_fill_ready))
 	    {
 	      /* I-cache miss, block fetch until it is resolved */
 	      ruu_fetch_issue_delay += lat - 1;
+	      fetch_fill_blk = blk;
+	      fetch_fill_ready = sim_cycle + lat;
 	      break;
 	    }
 	  /* else, I-cache/I-TLB hit */
@@ -4352,7 +5853,12 @@ ruu_fetch(void)
 			   /* updt */&(fetch_data[fetch_tail].dir_update),
 			   /* RSB index */&stack_recover_idx);
 	  else
-	    fetch_pred_PC = 0;
+	    {
+	      fetch_pred_PC = 0;
+	      /* a load value mis-prediction recovers the return stack
+		 like a branch does */
+	      stack_recover_idx = pred->retstack.tos;
+	    }
 
 	  /* valid address returned from branch predictor? */
 	  if (!fetch_pred_PC)
@@ -4399,6 +5905,403 @@ ruu_fetch(void)
     }
 }
 
+/* return the number of cycles following the current one in which no
+   pipeline stage can make progress, i.e., nothing can commit, issue,
+   dispatch or fetch until the next event completes or fetch resumes; this
+   is called at the end of a cycle, once all stages have run */
+static tick_t
+ruu_idle_cycles(void)
+{
+  tick_t wake, when;
+  enum md_opcode op = MD_NOP_OP;
+
+  /* commit: the RUU head, and the LSQ head for loads and stores, must not
+     be complete */
+  if (RUU_num > 0 && RUU[RUU_head].completed
+      && (!RUU[RUU_head].ea_comp || LSQ[LSQ_head].completed))
+    return 0;
+
+  /* issue: no ready instructions, and no loads to check for newly
+     satisfied memory dependencies */
+  if (ready_lsq.num || ready_ruu_hi.num || ready_ruu_lo.num)
+    return 0;
+  if (lsq_check >= 0 && lsq_wait.num)
+    return 0;
+
+  /* dispatch: blocked by a full RUU or LSQ, an empty IFQ, or a stall only
+     writeback or commit can release */
+  if (fetch_num)
+    MD_SET_OPCODE(op, fetch_data[fetch_head].IR);
+  if (!(RUU_num >= RUU_size || LSQ_num >= LSQ_size || fetch_num == 0
+	|| (!ruu_include_spec && spec_mode)
+	|| (ruu_inorder_issue
+	    && last_op.rs && RSLINK_VALID(&last_op)
+	    && !OPERANDS_READY(last_op.rs))
+	|| ((MD_OP_FLAGS(op) & F_TRAP) && RUU_num != 0)))
+    return 0;
+
+  /* fetch: blocked by a full IFQ or an issue delay */
+  if (!ruu_fetch_issue_delay && fetch_num < ruu_ifq_size)
+    return 0;
+
+  /* sleep until the earliest of the next event or the end of the fetch
+     issue delay, events and the cache models are timed in absolute cycles,
+     so nothing else can change in between */
+  wake = ruu_fetch_issue_delay ? sim_cycle + ruu_fetch_issue_delay + 1 : 0;
+  when = eventq_next_when();
+  if (when && (!wake || when < wake))
+    wake = when;
+
+  /* no wakeup at all is a deadlock, leave it to the regular cycle loop */
+  if (wake <= sim_cycle + 1)
+    return 0;
+  return wake - sim_cycle - 1;
+}
+
+/* skip the following N cycles of the active thread, in which no pipeline
+   stage can make progress, see ruu_idle_cycles(); only the per cycle state
+   is stepped, the caller steps the shared state and the cycle count */
+static void
+ruu_skip_cycles(tick_t n)
+{
+  /* fetch issue delay runs down, it ends at the earliest on the next cycle */
+  if (ruu_fetch_issue_delay)
+    ruu_fetch_issue_delay -= n;
+
+  /* occupancies are constant across the skipped cycles */
+  IFQ_count += n * fetch_num;
+  IFQ_fcount += ((fetch_num == ruu_ifq_size) ? n : 0);
+  RUU_count += n * RUU_num;
+  RUU_fcount += ((RUU_num == RUU_size) ? n : 0);
+  LSQ_count += n * LSQ_num;
+  LSQ_fcount += ((LSQ_num == LSQ_size) ? n : 0);
+}
+
+
+/*
+ * simultaneous multithreading (SMT) support, each SMT thread runs its own
+ * program or EIO trace with its own architected state, RUU, LSQ, fetch
+ * queue, create vector, and speculative state; the threads share the caches,
+ * TLBs, functional units, branch and value predictors, and the commit, issue,
+ * and dispatch bandwidth of each cycle, one thread fetches per cycle
+ */
+
+/* the per-thread state, the active thread keeps its state in the file
+   scope variables, all other threads in their thread records */
+#define THREAD_STATE							\
+  THREAD_VAR(regs) THREAD_VAR(mem) THREAD_VAR(thread_asid)		\
+  THREAD_VAR(thread_num_insn) THREAD_VAR(thread_num_refs)		\
+  THREAD_VAR(thread_num_loads) THREAD_VAR(thread_num_branches)		\
+  THREAD_VAR(sim_eio_fname) THREAD_VAR(sim_eio_fd)			\
+  THREAD_VAR(ld_text_base) THREAD_VAR(ld_text_size)			\
+  THREAD_VAR(ld_data_base) THREAD_VAR(ld_data_size)			\
+  THREAD_VAR(ld_brk_point) THREAD_VAR(ld_stack_base)			\
+  THREAD_VAR(ld_stack_size) THREAD_VAR(ld_stack_min)			\
+  THREAD_VAR(ld_prog_fname) THREAD_VAR(ld_prog_entry)			\
+  THREAD_VAR(ld_environ_base) THREAD_VAR(ld_target_big_endian)		\
+  THREAD_VAR(spec_mode) THREAD_VAR(ruu_fetch_issue_delay)		\
+  THREAD_VAR(RUU) THREAD_VAR(RUU_head) THREAD_VAR(RUU_tail)		\
+  THREAD_VAR(RUU_num)							\
+  THREAD_VAR(LSQ) THREAD_VAR(LSQ_head) THREAD_VAR(LSQ_tail)		\
+  THREAD_VAR(LSQ_num)							\
+  THREAD_VAR(event_wheel) THREAD_VAR(eventq_cycle) THREAD_VAR(eventq_num) \
+  THREAD_VAR(event_heap) THREAD_VAR(event_heap_num)			\
+  THREAD_VAR(event_heap_size) THREAD_VAR(event_heap_seq)		\
+  THREAD_VAR(ready_lsq) THREAD_VAR(ready_ruu_hi) THREAD_VAR(ready_ruu_lo) \
+  THREAD_VAR(use_spec_cv) THREAD_VAR(create_vector)			\
+  THREAD_VAR(spec_create_vector) THREAD_VAR(create_vector_rt)		\
+  THREAD_VAR(spec_create_vector_rt)					\
+  THREAD_VAR(mdp_violator) THREAD_VAR(lsq_wait) THREAD_VAR(lsq_sta_unknown) \
+  THREAD_VAR(lsq_check) THREAD_VAR(lsq_store_hash)			\
+  THREAD_VAR(lsq_store_hash_mask)					\
+  THREAD_VAR(mdp_wait_table) THREAD_VAR(mdp_ssit) THREAD_VAR(mdp_lfst)	\
+  THREAD_VAR(mdp_clear_cycle) THREAD_VAR(mdp_ckpts) THREAD_VAR(mdp_ckpt_map) \
+  THREAD_VAR(mdp_log) THREAD_VAR(mdp_log_head) THREAD_VAR(mdp_log_tail)	\
+  THREAD_VAR(use_spec_R) THREAD_VAR(spec_regs_R)			\
+  THREAD_VAR(use_spec_F) THREAD_VAR(spec_regs_F)			\
+  THREAD_VAR(use_spec_C) THREAD_VAR(spec_regs_C)			\
+  THREAD_VAR(spec_mem) THREAD_VAR(spec_mem_size) THREAD_VAR(spec_mem_num) \
+  THREAD_VAR(spec_mem_gen)						\
+  THREAD_VAR(pred_PC) THREAD_VAR(recover_PC)				\
+  THREAD_VAR(fetch_regs_PC) THREAD_VAR(fetch_pred_PC)			\
+  THREAD_VAR(fetch_data) THREAD_VAR(fetch_num) THREAD_VAR(fetch_tail)	\
+  THREAD_VAR(fetch_head)						\
+  THREAD_VAR(last_op) THREAD_VAR(last_inst_missed)			\
+  THREAD_VAR(last_inst_tmissed) THREAD_VAR(fetch_fill_blk)		\
+  THREAD_VAR(fetch_fill_ready)
+
+/* thread address space IDs live in the top four address bits, which no
+   program of a 64-bit target uses, 32-bit targets (e.g., PISA stacks near
+   0x7fffc000) have no such bits to spare, so they do not support SMT */
+#define THREAD_ASID_SHIFT	(sizeof(md_addr_t) * 8 - 4)
+
+/* max per-thread stats */
+#define MAX_THREAD_STATS	64
+
+/* a per-thread stat, i.e., a shared counter split by the thread that was
+   active when it counted */
+struct thread_stat {
+  char *name;				/* stat name, w/o the thread prefix */
+  char *desc;				/* stat description */
+  counter_t *ctr;			/* shared counter */
+  counter_t base;			/* shared counter at the last switch */
+};
+
+static struct thread_stat thread_stats[MAX_THREAD_STATS];
+static int thread_nstats = 0;
+
+/* an SMT thread record */
+struct thread_t {
+#define THREAD_VAR(V)		__typeof__(V) V;
+  THREAD_STATE
+#undef THREAD_VAR
+  counter_t stats[MAX_THREAD_STATS];	/* per-thread stat values */
+};
+
+static struct thread_t threads[MAX_SMT_THREADS];
+
+/* the active thread */
+static int thread_cur = 0;
+
+/* thread that fetches first under round robin fetch */
+static int smt_rr_next = 0;
+
+/* charge the shared counter increments since the last thread switch to
+   the active thread */
+static void
+thread_stat_sync(void)
+{
+  int i;
+
+  for (i=0; i < thread_nstats; i++)
+    {
+      threads[thread_cur].stats[i] +=
+	*thread_stats[i].ctr - thread_stats[i].base;
+      thread_stats[i].base = *thread_stats[i].ctr;
+    }
+}
+
+/* make thread T the active thread */
+static void
+thread_switch(int t)				/* thread to activate */
+{
+  struct thread_t *thread;
+
+  if (t == thread_cur)
+    return;
+
+  thread_stat_sync();
+
+  /* save the state of the active thread, then load the state of T */
+  thread = &threads[thread_cur];
+#define THREAD_VAR(V)		memcpy(&thread->V, &V, sizeof(V));
+  THREAD_STATE
+#undef THREAD_VAR
+
+  thread = &threads[t];
+#define THREAD_VAR(V)		memcpy(&V, &thread->V, sizeof(V));
+  THREAD_STATE
+#undef THREAD_VAR
+
+  thread_cur = t;
+}
+
+/* add a per-thread stat NAME of shared counter CTR */
+static void
+thread_stat_add(char *name,			/* stat name */
+		char *desc,			/* stat description */
+		counter_t *ctr)			/* shared counter */
+{
+  if (thread_nstats == MAX_THREAD_STATS)
+    panic("too many per-thread stats");
+
+  thread_stats[thread_nstats].name = mystrdup(name);
+  thread_stats[thread_nstats].desc = desc;
+  thread_stats[thread_nstats].ctr = ctr;
+  thread_stats[thread_nstats].base = *ctr;
+  thread_nstats++;
+}
+
+/* add the per-thread hit and miss stats of cache CP */
+static void
+thread_stat_add_cache(struct cache_t *cp)	/* cache or TLB */
+{
+  char buf[512];
+
+  sprintf(buf, "%s.hits", cp->name);
+  thread_stat_add(buf, "total number of hits", &cp->hits);
+  sprintf(buf, "%s.misses", cp->name);
+  thread_stat_add(buf, "total number of misses", &cp->misses);
+}
+
+/* set aside the initial thread state, the extra SMT threads start from it,
+   called before the program of thread 0 is loaded */
+static void
+smt_init(void)
+{
+  int t;
+
+  for (t=1; t <= smt_nelt; t++)
+    {
+#define THREAD_VAR(V)		memcpy(&threads[t].V, &V, sizeof(V));
+      THREAD_STATE
+#undef THREAD_VAR
+    }
+}
+
+/* max arguments of an SMT program command line */
+#define MAX_SMT_ARGS		64
+
+/* load the programs of the extra SMT threads, the threads share the
+   simulator's environment and file descriptors */
+static void
+smt_load(char **envp)				/* program environment */
+{
+  int t, argc;
+  char *argv[MAX_SMT_ARGS+1], *cmd, *arg, name[32];
+
+  for (t=1; t <= smt_nelt; t++)
+    {
+      /* split the command line into the program arguments */
+      cmd = mystrdup(smt_progs[t-1]);
+      for (argc=0, arg=strtok(cmd, " \t"); arg; arg=strtok(NULL, " \t"))
+	{
+	  if (argc == MAX_SMT_ARGS)
+	    fatal("too many arguments in SMT program `%s'", smt_progs[t-1]);
+	  argv[argc++] = arg;
+	}
+      if (!argc)
+	fatal("empty SMT program command line");
+      argv[argc] = NULL;
+
+      thread_switch(t);
+      thread_asid = (md_addr_t)t << THREAD_ASID_SHIFT;
+
+      /* allocate and initialize register file and memory space */
+      regs_init(&regs);
+      sprintf(name, "t%d.mem", t);
+      mem = mem_create(name);
+      mem_init(mem);
+
+      /* load program text and data, set up environment, memory, and regs */
+      ld_load_prog(argv[0], argc, argv, envp, &regs, mem, TRUE);
+
+      /* initialize the per-thread simulation engine state */
+      tracer_init();
+      fetch_init();
+      cv_init();
+      eventq_init();
+      readyq_init();
+      ruu_init();
+      lsq_init();
+      lsq_dep_init();
+    }
+  thread_switch(0);
+  smt_nthreads = smt_nelt + 1;
+}
+
+/* register the per-thread stats of an SMT run */
+static void
+smt_reg_stats(struct stat_sdb_t *sdb)		/* stats database */
+{
+  int i, t;
+  char buf[512], buf1[512];
+
+  thread_stat_add("sim_num_insn",
+		  "total number of instructions committed", &sim_num_insn);
+  thread_stat_add("sim_num_refs",
+		  "total number of loads and stores committed", &sim_num_refs);
+  thread_stat_add("sim_num_loads",
+		  "total number of loads committed", &sim_num_loads);
+  thread_stat_add("sim_num_branches",
+		  "total number of branches committed", &sim_num_branches);
+  thread_stat_add("sim_total_insn",
+		  "total number of instructions executed", &sim_total_insn);
+  thread_stat_add("sim_slip", "total number of slip cycles", &sim_slip);
+  thread_stat_add("IFQ_count", "cumulative IFQ occupancy", &IFQ_count);
+  thread_stat_add("RUU_count", "cumulative RUU occupancy", &RUU_count);
+  thread_stat_add("LSQ_count", "cumulative LSQ occupancy", &LSQ_count);
+  thread_stat_add("mdp_violations",
+		  "total number of memory order violations", &mdp_violations);
+  if (pred)
+    {
+      thread_stat_add("bpred.lookups",
+		      "total number of bpred lookups", &pred->lookups);
+      thread_stat_add("bpred.dir_hits",
+		      "total number of direction-predicted hits",
+		      &pred->dir_hits);
+      thread_stat_add("bpred.misses",
+		      "total number of misses", &pred->misses);
+    }
+  if (vpred)
+    {
+      thread_stat_add("vpred.lookups",
+		      "total number of VP lookups", &vpred->lookups);
+      thread_stat_add("vpred.correct",
+		      "total number of correct value predictions",
+		      &vpred->correct);
+      thread_stat_add("vpred.wrong",
+		      "total number of incorrect value predictions",
+		      &vpred->wrong);
+    }
+  if (vpred && vp_spec)
+    {
+      thread_stat_add("vp_spec_loads",
+		      "total number of loads that used a predicted value",
+		      &vp_spec_loads);
+      thread_stat_add("vp_spec_wrong",
+		      "total number of mis-predicted values used",
+		      &vp_spec_wrong);
+    }
+  if (cache_il1
+      && (cache_il1 != cache_dl1 && cache_il1 != cache_dl2))
+    thread_stat_add_cache(cache_il1);
+  if (cache_il2
+      && (cache_il2 != cache_dl1 && cache_il2 != cache_dl2))
+    thread_stat_add_cache(cache_il2);
+  if (cache_dl1)
+    thread_stat_add_cache(cache_dl1);
+  if (cache_dl2)
+    thread_stat_add_cache(cache_dl2);
+  if (itlb)
+    thread_stat_add_cache(itlb);
+  if (dtlb)
+    thread_stat_add_cache(dtlb);
+
+  for (t=0; t < smt_nthreads; t++)
+    {
+      for (i=0; i < thread_nstats; i++)
+	{
+	  sprintf(buf, "t%d.%s", t, thread_stats[i].name);
+	  stat_reg_counter(sdb, buf, thread_stats[i].desc,
+			   &threads[t].stats[i], /* initial value */0,
+			   /* format */NULL);
+	}
+
+      sprintf(buf, "t%d.sim_IPC", t);
+      sprintf(buf1, "t%d.sim_num_insn / sim_cycle", t);
+      stat_reg_formula(sdb, buf, "thread instructions per cycle",
+		       buf1, /* format */NULL);
+      sprintf(buf, "t%d.ruu_occupancy", t);
+      sprintf(buf1, "t%d.RUU_count / sim_cycle", t);
+      stat_reg_formula(sdb, buf, "thread avg RUU occupancy (insn's)",
+		       buf1, /* format */NULL);
+
+      /* thread 0 memory stats are registered with the simulator stats */
+      if (t > 0)
+	mem_reg_stats(threads[t].mem, sdb);
+    }
+}
+
+/* settle the per-thread stats before they are printed, the loader stats
+   show thread 0 */
+static void
+smt_stats_hook(void)
+{
+  thread_switch(0);
+  thread_stat_sync();
+}
+
 /* default machine state accessor, used by DLite */
 static char *					/* err str, NULL for no err */
 simoo_mstate_obj(FILE *stream,			/* output stream */
@@ -4481,25 +6384,11 @@ simoo_mstate_obj(FILE *stream,			/* output stream */
 }
 
 
-/* start simulation, program loaded, processor precise state initialized */
-void
-sim_main(void)
+/* set up the entry state of the active thread, fast forward it, and start
+   its timing simulation */
+static void
+thread_start(void)
 {
-  /*start-new*/
-  md_inst_t inst;
-  use_vp = 1;
-  use_stride = 0;
-  en_lookup_stride = 0;
-  use_fsm = 0;
-  register md_addr_t addr;
-  enum md_opcode op;
-  create_stride();
-  /*end-new*/
-
-  /* ignore any floating point exceptions, they may occur on mis-speculated
-     execution paths */
-  signal(SIGFPE, SIG_IGN);
-
   /* set up program entry state */
   regs.regs_PC = ld_prog_entry;
   regs.regs_NPC = regs.regs_PC + sizeof(md_inst_t);
@@ -4590,24 +6479,49 @@ sim_main(void)
 	}
     }
 
-  fprintf(stderr, "sim: ** starting performance simulation **\n");
-
   /* set up timing simulation entry state */
   fetch_regs_PC = regs.regs_PC - sizeof(md_inst_t);
   fetch_pred_PC = regs.regs_PC;
   regs.regs_PC = regs.regs_PC - sizeof(md_inst_t);
+}
+
+/* start simulation, program loaded, processor precise state initialized */
+void
+sim_main(void)
+{
+  int t, i, first, skip, fetch_thread, fetch_rank, rank;
+  tick_t idle, n;
+  int turn = 0;
+
+  /* ignore any floating point exceptions, they may occur on mis-speculated
+     execution paths */
+  signal(SIGFPE, SIG_IGN);
+
+  /* set up all threads for timing simulation */
+  for (t=0; t < smt_nthreads; t++)
+    {
+      thread_switch(t);
+      thread_start();
+    }
+  thread_switch(0);
+
+  /* per-thread stats must be settled before they are printed */
+  if (smt_nthreads > 1)
+    sim_stats_hook(smt_stats_hook);
+
+  fprintf(stderr, "sim: ** starting performance simulation **\n");
 
   /* main simulator loop, NOTE: the pipe stages are traverse in reverse order
-     to eliminate this/next state synchronization and relaxation problems */
+     to eliminate this/next state synchronization and relaxation problems;
+     each stage runs for all SMT threads before the next stage, the first
+     thread of each pass rotates every cycle, so the threads take turns at
+     the shared bandwidth and functional units */
   for (;;)
     {
-      /* RUU/LSQ sanity checks */
-      if (RUU_num < LSQ_num)
-	panic("RUU_num < LSQ_num");
-      if (((RUU_head + RUU_num) % RUU_size) != RUU_tail)
-	panic("RUU_head/RUU_tail wedged");
-      if (((LSQ_head + LSQ_num) % LSQ_size) != LSQ_tail)
-	panic("LSQ_head/LSQ_tail wedged");
+      /* the commit, issue, and decode B/W of this cycle */
+      commit_slots = ruu_commit_width;
+      issue_slots = ruu_issue_width;
+      dispatch_slots = ruu_decode_width * fetch_speed;
 
       /* check if pipetracing is still active */
       ptrace_check_active(regs.regs_PC, sim_num_insn, sim_cycle);
@@ -4615,62 +6529,146 @@ sim_main(void)
       /* indicate new cycle in pipetrace */
       ptrace_newcycle(sim_cycle);
 
-      /* commit entries from RUU/LSQ to architected register file */
-      ruu_commit();
+      /* the thread that goes first in this cycle, the turn passes on every
+	 cycle, skipped cycles included, so cycle skipping keeps the order */
+      first = turn;
+
+      for (i=0; i < smt_nthreads; i++)
+	{
+	  thread_switch((first + i) % smt_nthreads);
+
+	  /* RUU/LSQ sanity checks */
+	  if (RUU_num < LSQ_num)
+	    panic("RUU_num < LSQ_num");
+	  if (((RUU_head + RUU_num) % RUU_size) != RUU_tail)
+	    panic("RUU_head/RUU_tail wedged");
+	  if (((LSQ_head + LSQ_num) % LSQ_size) != LSQ_tail)
+	    panic("LSQ_head/LSQ_tail wedged");
+
+	  /* commit entries from RUU/LSQ to architected register file */
+	  ruu_commit();
+	}
 
       /* service function unit release events */
       ruu_release_fu();
 
-      /* ==> may have ready queue entries carried over from previous cycles */
+      fetch_thread = -1;
+      fetch_rank = 0;
+      for (i=0; i < smt_nthreads; i++)
+	{
+	  thread_switch((first + i) % smt_nthreads);
 
-      /* service result completions, also readies dependent operations */
-      /* ==> inserts operations into ready queue --> register deps resolved */
-      ruu_writeback();
-      /*start-new*/
+	  /* ==> may have ready queue entries carried over from previous
+	     cycles */
 
-      /*end-new*/
-      if (!bugcompat_mode)
-	{
-	  /* try to locate memory operations that are ready to execute */
-	  /* ==> inserts operations into ready queue --> mem deps resolved */
-	  lsq_refresh();
+	  /* service result completions, also readies dependent operations */
+	  /* ==> inserts operations into ready queue --> register deps
+	     resolved */
+	  ruu_writeback();
 
-	  /* issue operations ready to execute from a previous cycle */
-	  /* <== drains ready queue <-- ready operations commence execution */
-	  ruu_issue();
-	}
+	  if (!bugcompat_mode)
+	    {
+	      /* try to locate memory operations that are ready to execute */
+	      /* ==> inserts operations into ready queue --> mem deps
+		 resolved */
+	      lsq_refresh();
+
+	      /* issue operations ready to execute from a previous cycle */
+	      /* <== drains ready queue <-- ready operations commence
+		 execution */
+	      ruu_issue();
+	    }
 
-      /* decode and dispatch new operations */
-      /* ==> insert ops w/ no deps or all regs ready --> reg deps resolved */
-      ruu_dispatch();
+	  /* decode and dispatch new operations */
+	  /* ==> insert ops w/ no deps or all regs ready --> reg deps
+	     resolved */
+	  ruu_dispatch();
 
-      if (bugcompat_mode)
+	  if (bugcompat_mode)
+	    {
+	      /* try to locate memory operations that are ready to execute */
+	      /* ==> inserts operations into ready queue --> mem deps
+		 resolved */
+	      lsq_refresh();
+
+	      /* issue operations ready to execute from a previous cycle */
+	      /* <== drains ready queue <-- ready operations commence
+		 execution */
+	      ruu_issue();
+	    }
+
+	  /* a thread whose instruction fetch unit is not blocked may fetch,
+	     the fetch policy ranks the candidates: ICOUNT favors the fewest
+	     insts in the IFQ and RUU, round robin takes turns */
+	  if (ruu_fetch_issue_delay)
+	    ruu_fetch_issue_delay--;
+	  else if (fetch_num < ruu_ifq_size)
+	    {
+	      rank = ((smt_fetch == smt_fetch_icount)
+		      ? fetch_num + RUU_num
+		      : ((thread_cur + smt_nthreads - smt_rr_next)
+			 % smt_nthreads));
+	      if (fetch_thread < 0 || rank < fetch_rank)
+		{
+		  fetch_thread = thread_cur;
+		  fetch_rank = rank;
+		}
+	    }
+	}
+
+      /* call instruction fetch unit of the chosen thread */
+      if (fetch_thread >= 0)
 	{
-	  /* try to locate memory operations that are ready to execute */
-	  /* ==> inserts operations into ready queue --> mem deps resolved */
-	  lsq_refresh();
+	  thread_switch(fetch_thread);
+	  ruu_fetch();
+	  smt_rr_next = (fetch_thread + 1) % smt_nthreads;
+	}
 
-	  /* issue operations ready to execute from a previous cycle */
-	  /* <== drains ready queue <-- ready operations commence execution */
-	  ruu_issue();
+      /* skip over cycles in which the machine is stalled, unless
+	 pipetracing, which reports every cycle */
+      skip = cycle_skip && !ptrace_outfd;
+      idle = 0;
+      for (i=0; i < smt_nthreads; i++)
+	{
+	  thread_switch((first + i) % smt_nthreads);
+
+	  /* update buffer occupancy stats */
+	  IFQ_count += fetch_num;
+	  IFQ_fcount += ((fetch_num == ruu_ifq_size) ? 1 : 0);
+	  RUU_count += RUU_num;
+	  RUU_fcount += ((RUU_num == RUU_size) ? 1 : 0);
+	  LSQ_count += LSQ_num;
+	  LSQ_fcount += ((LSQ_num == LSQ_size) ? 1 : 0);
+
+	  /* the machine is stalled as long as all threads are */
+	  if (skip)
+	    {
+	      n = ruu_idle_cycles();
+	      idle = (i == 0 || n < idle) ? n : idle;
+	      skip = (idle != 0);
+	    }
 	}
+      if (skip)
+	{
+	  for (i=0; i < smt_nthreads; i++)
+	    {
+	      thread_switch((first + i) % smt_nthreads);
+	      ruu_skip_cycles(idle);
+	    }
 
-      /* call instruction fetch unit if it is not blocked */
-      if (!ruu_fetch_issue_delay)
-	ruu_fetch();
-      else
-	ruu_fetch_issue_delay--;
+	  /* release functional units as ruu_release_fu() would, all units
+	     are free after a turn of the release wheel */
+	  res_release(fu_pool, (idle < fu_pool->wheel_size
+				? (int)idle : fu_pool->wheel_size));
 
-      /* update buffer occupancy stats */
-      IFQ_count += fetch_num;
-      IFQ_fcount += ((fetch_num == ruu_ifq_size) ? 1 : 0);
-      RUU_count += RUU_num;
-      RUU_fcount += ((RUU_num == RUU_size) ? 1 : 0);
-      LSQ_count += LSQ_num;
-      LSQ_fcount += ((LSQ_num == LSQ_size) ? 1 : 0);
+	  sim_cycle += idle;
+	  sim_skip_cycles += idle;
+	  turn = (int)((turn + idle) % smt_nthreads);
+	}
 
       /* go to next cycle */
       sim_cycle++;
+      turn = (turn + 1) % smt_nthreads;
 
       /* finish early? */
       if (max_insts && sim_num_insn >= max_insts)
@@ -65,6 +65,8 @@
 #include "stats.h"
 #include "sim.h"
 #include "vp.h"
+#include "vpstream.h"
+#include "vptrace.h"
 
 /*
  * This file implements a functional simulator.  This functional simulator is
@@ -81,24 +83,42 @@ static struct mem_t *mem = NULL;
 
 /* track number of refs */
 static counter_t sim_num_refs = 0;
-static counter_t num_of_vpred_misses = 0;
-static counter_t num_of_vpred_hits = 0;
-extern counter_t predicted_ok;
-extern counter_t Wrong_Predictions;
+
 /* maximum number of inst's to execute */
 static unsigned int max_insts;
-md_inst_t inst;
-VAL_TAG_TYPE pred_val_main;
-extern int common_ref;
-extern int misses_vpred;
-extern int use_vp=1;
-extern int use_stride=1;
-extern int en_lookup_stride=0;
-extern int use_fsm = 0;
-extern int lookup_accessed;
-extern int update_accessed;
-extern int allocate_accessed;
-extern int found_value;
+
+/* value predictor options */
+static struct vpred_opts_t vp_opts;
+
+/* value predictors, all driven by the same load stream: the -vp predictor
+   (if any) followed by the -vp:sweep predictors */
+static int vpred_num = 0;
+static struct vpred_t *vpreds[1 + VP_MAX_SWEEP];
+
+/* number of value predictor worker threads, 0 runs the predictors inline */
+static int vp_threads;
+
+/* load value stream ring size, in records */
+static int vp_ring_size;
+
+/* load value stream feeding the value predictor workers, or NULL */
+static struct vps_t *vp_stream = NULL;
+
+/* load value trace file name, or NULL */
+static char *vp_trace_fname;
+
+/* load value trace writer, or NULL */
+static struct vpt_writer_t *vp_trace = NULL;
+
+/* a value predictor worker, owns a share of the value predictors */
+struct vp_worker_t {
+  int num;				/* number of predictors owned */
+  struct vpred_t *vpreds[1 + VP_MAX_SWEEP];/* predictors owned */
+};
+
+/* value predictor workers */
+static struct vp_worker_t vp_workers[1 + VP_MAX_SWEEP];
+
 /* register simulator-specific options */
 void
 sim_reg_options(struct opt_odb_t *odb)
@@ -115,23 +135,104 @@ sim_reg_options(struct opt_odb_t *odb)
   opt_reg_uint(odb, "-max:inst", "maximum number of inst's to execute",
 	       &max_insts, /* default */0,
 	       /* print */TRUE, /* format */NULL);
-  opt_reg_uint(odb, "-vp", "Enable Value prediction",
-         &use_vp, /* default */0,
-         /* print */TRUE, /* format */NULL);
 
+  /* value predictor options */
+  vpred_reg_options(odb, &vp_opts, /* sweep */TRUE);
+
+  opt_reg_int(odb, "-vp:threads",
+	      "value predictor worker threads (0 - run predictors inline)",
+	      &vp_threads, /* default */0,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-vp:ring",
+	      "load value stream size for the worker threads (in records)",
+	      &vp_ring_size, /* default */16384,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_string(odb, "-vp:trace",
+		 "write a load value trace to <fname>, see sim-vpreplay",
+		 &vp_trace_fname, /* default */NULL,
+		 /* print */TRUE, /* format */NULL);
+
+  opt_reg_note(odb,
+"  Every sweep predictor, and the -vp predictor, sees the same load value\n"
+"  stream from a single functional execution, each one reports its own\n"
+"  statistics block.\n"
+"\n"
+"  With -vp:threads <n>, the predictors are dealt out to <n> worker threads\n"
+"  that consume the loads through a shared ring, so up to <n> predictor\n"
+"  designs are evaluated at about the wall clock cost of one.\n"
+	       );
+}
+
+/* value predictor worker, runs a batch of loads through each of its
+   predictors in turn, so a predictor's table stays cache resident */
+static void
+vp_worker(void *arg, struct vps_rec_t *recs, int n)
+{
+  struct vp_worker_t *worker = arg;
+  int i, j;
+  VAL_TAG_TYPE calc_val, pred_val;
+
+  calc_val.fsm_pred = MISS;
+  for (i=0; i < worker->num; i++)
+    {
+      for (j=0; j < n; j++)
+	{
+	  calc_val.value.single_p = recs[j].value;
+	  vpred_access(worker->vpreds[i], recs[j].pc, recs[j].addr,
+		       recs[j].inst, calc_val, &pred_val);
+	}
+    }
+}
+
+/* drain the load value stream and complete the load value trace, called
+   before the final stats are printed */
+static void
+vp_drain(void)
+{
+  if (vp_stream)
+    vps_finish(vp_stream);
+  if (vp_trace)
+    vpt_flush(vp_trace);
 }
 
 /* check simulator-specific option values */
 void
 sim_check_options(struct opt_odb_t *odb, int argc, char **argv)
 {
-  /* nada */
+  int i;
+
+  vpred_num = vpred_check_options(&vp_opts, vpreds);
+
+  if (vp_trace_fname)
+    vp_trace = vpt_open_writer(vp_trace_fname);
+
+  if (vp_threads < 0)
+    fatal("number of value predictor worker threads must be non-negative");
+  if (vp_threads && vpred_num)
+    {
+      /* no point in more workers than predictors */
+      vp_threads = MIN(vp_threads, vpred_num);
+      for (i=0; i < vpred_num; i++)
+	{
+	  struct vp_worker_t *worker = &vp_workers[i % vp_threads];
+
+	  worker->vpreds[worker->num++] = vpreds[i];
+	}
+
+      vp_stream = vps_create(vp_ring_size);
+      for (i=0; i < vp_threads; i++)
+	vps_add_consumer(vp_stream, vp_worker, &vp_workers[i]);
+    }
 }
 
 /* register simulator-specific statistics */
 void
 sim_reg_stats(struct stat_sdb_t *sdb)
 {
+  int i;
+
   stat_reg_counter(sdb, "sim_num_insn",
 		   "total number of instructions executed",
 		   &sim_num_insn, sim_num_insn, NULL);
@@ -144,18 +245,20 @@ sim_reg_stats(struct stat_sdb_t *sdb)
   stat_reg_formula(sdb, "sim_inst_rate",
 		   "simulation speed (in insts/sec)",
 		   "sim_num_insn / sim_elapsed_time", NULL);
-  stat_reg_int(sdb, "num_of_vpred_hits",
-         "num_of_vpred_hits",
-         &num_of_vpred_hits, 0, NULL);
-  stat_reg_int(sdb, "num_of_vpred_misses",
-         "num_of_vpred_misses",
-         &num_of_vpred_misses, 0, NULL);
-stat_reg_int(sdb, "Correct_Prediction",
-        "total correct predictions made",
-        &predicted_ok, 0, NULL);
-  stat_reg_int(sdb, "Wrong_Predictions",
-       "Wrong_Predictions made by Value prediction",
-         &Wrong_Predictions, 0, NULL);
+  for (i=0; i < vpred_num; i++)
+    vpred_reg_stats(vpreds[i], sdb);
+  if (vp_trace)
+    {
+      stat_reg_counter(sdb, "vp_trace.records",
+		       "total number of load value trace records",
+		       &vp_trace->recs, vp_trace->recs, NULL);
+      stat_reg_counter(sdb, "vp_trace.bytes",
+		       "total size of the load value trace (in bytes)",
+		       &vp_trace->bytes, vp_trace->bytes, NULL);
+      stat_reg_formula(sdb, "vp_trace.bytes_per_rec",
+		       "load value trace bytes per record",
+		       "vp_trace.bytes / vp_trace.records", NULL);
+    }
   ld_reg_stats(sdb);
   mem_reg_stats(mem, sdb);
 }
@@ -191,7 +294,10 @@ sim_load_prog(char *fname,		/* program to load */
 void
 sim_aux_config(FILE *stream)		/* output stream */
 {
-  /* nothing currently */
+  int i;
+
+  for (i=0; i < vpred_num; i++)
+    vpred_config(vpreds[i], stream);
 }
 
 /* dump simulator-specific auxiliary simulator statistics */
@@ -205,7 +311,8 @@ sim_aux_stats(FILE *stream)		/* output stream */
 void
 sim_uninit(void)
 {
-  /* nada */
+  if (vp_trace)
+    vpt_close_writer(vp_trace);
 }
 
 
@@ -265,14 +372,18 @@ sim_uninit(void)
 
 /* precise architected memory state accessor macros */
 #define READ_BYTE(SRC, FAULT)						\
-  ((FAULT) = md_fault_none, addr = (SRC), MEM_READ_BYTE(mem, addr))
+  ((FAULT) = md_fault_none, addr = (SRC), ld_size = 1,			\
+   MEM_READ_BYTE(mem, addr))
 #define READ_HALF(SRC, FAULT)						\
-  ((FAULT) = md_fault_none, addr = (SRC), MEM_READ_HALF(mem, addr))
+  ((FAULT) = md_fault_none, addr = (SRC), ld_size = 2,			\
+   MEM_READ_HALF(mem, addr))
 #define READ_WORD(SRC, FAULT)						\
-  ((FAULT) = md_fault_none, addr = (SRC), MEM_READ_WORD(mem, addr))
+  ((FAULT) = md_fault_none, addr = (SRC), ld_size = 4,			\
+   MEM_READ_WORD(mem, addr))
 #ifdef HOST_HAS_QWORD
 #define READ_QWORD(SRC, FAULT)						\
-  ((FAULT) = md_fault_none, addr = (SRC), MEM_READ_QWORD(mem, addr))
+  ((FAULT) = md_fault_none, addr = (SRC), ld_size = 8,			\
+   MEM_READ_QWORD(mem, addr))
 #endif /* HOST_HAS_QWORD */
 
 #define WRITE_BYTE(SRC, DST, FAULT)					\
@@ -287,27 +398,33 @@ sim_uninit(void)
 #endif /* HOST_HAS_QWORD */
 
 /* system call handler macro */
-#define SYSCALL(INST)	sys_syscall(&regs, mem_access, mem, INST, TRUE)
+#define SYSCALL(INST)							\
+  sys_syscall(&regs, mem_access, mem, INST, TRUE, sim_num_insn)
 
 /* start simulation, program loaded, processor precise state initialized */
 void
 sim_main(void)
 {
-  use_vp = 1;
-  use_stride = 0;
-  en_lookup_stride = 0;
-  use_fsm = 0;
+  md_inst_t inst;
   register md_addr_t addr;
+  int ld_size = 0;
   enum md_opcode op;
   register int is_write;
   enum md_fault_type fault;
-  create_stride();
+
   fprintf(stderr, "sim: ** starting functional simulation **\n");
 
+  /* start the value predictor workers, they must drain the load value
+     stream before the stats are printed */
+  if (vp_stream || vp_trace)
+    sim_stats_hook(vp_drain);
+  if (vp_stream)
+    vps_start(vp_stream);
+
   /* set up initial default next PC */
   regs.regs_NPC = regs.regs_PC + sizeof(md_inst_t);
 
-  /* check for DLite debugger enhash_no_i1try condition */
+  /* check for DLite debugger entry condition */
   if (dlite_check_break(regs.regs_PC, /* !access */0, /* addr */0, 0, 0))
     dlite_main(regs.regs_PC - sizeof(md_inst_t),
 	       regs.regs_PC, sim_num_insn, &regs, mem);
@@ -373,26 +490,36 @@ sim_main(void)
 	  if (MD_OP_FLAGS(op) & F_STORE)
 	    is_write = TRUE;
 	}
-  if(is_PRED)
-  {
-    int data;
-    int found;
-    VAL_TAG_TYPE calc_val;
-    mem_access(mem,Read,addr,&data,sizeof(word_t));
-    calc_val.value.single_p = data;
-    calc_val.fsm_pred = MISS;
-    lookup(addr,inst,&pred_val_main,mem);
-    found = update(addr,inst,pred_val_main,calc_val,mem,common_ref++);
-    if(found == MISS)
-    {
-      allocate(addr,inst,calc_val,common_ref++);
-      num_of_vpred_misses++;
-    }
-    else
-    {
-      num_of_vpred_hits++;
-    }
-  }
+
+      /* predict the loaded value, then train on the actual one, the
+	 load is executed once for all the predictors, either inline or
+	 through the worker threads, and for the load value trace */
+      if ((vpred_num || vp_trace) && is_PRED)
+	{
+	  int i;
+	  word_t data;
+	  VAL_TAG_TYPE calc_val, pred_val;
+
+	  mem_access(mem, Read, addr, &data, sizeof(word_t));
+	  if (vp_trace)
+	    vpt_write(vp_trace, regs.regs_PC, addr, ld_size, data);
+
+	  if (vp_stream)
+	    {
+	      /* hand the load to the value predictor workers */
+	      vps_put(vp_stream, regs.regs_PC, addr, data, inst,
+		      sim_num_insn);
+	    }
+	  else
+	    {
+	      calc_val.value.single_p = data;
+	      calc_val.fsm_pred = MISS;
+	      for (i=0; i < vpred_num; i++)
+		vpred_access(vpreds[i], regs.regs_PC, addr, inst,
+			     calc_val, &pred_val);
+	    }
+	}
+
       /* check for DLite debugger entry condition */
       if (dlite_check_break(regs.regs_NPC,
 			    is_write ? ACCESS_WRITE : ACCESS_READ,
@@ -0,0 +1,210 @@
+/* sim-vpreplay.c - value predictor load value trace replayer */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ *
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ *
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ *
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ *
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ *
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ *
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ *
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ *
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ *
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "options.h"
+#include "stats.h"
+#include "sim.h"
+#include "vp.h"
+#include "vptrace.h"
+
+/*
+ * This file implements a value predictor trace replayer.  It drives the
+ * value predictors directly from a load value trace written by sim-safe
+ * (-vp:trace), in place of simulating the program again.  The trace file
+ * is given where the other simulators take the program to simulate.
+ */
+
+/* track number of loads replayed */
+static counter_t sim_num_loads = 0;
+
+/* maximum number of loads to replay */
+static unsigned int max_loads;
+
+/* value predictor options */
+static struct vpred_opts_t vp_opts;
+
+/* value predictors, all driven by the same load trace: the -vp predictor
+   (if any) followed by the -vp:sweep predictors */
+static int vpred_num = 0;
+static struct vpred_t *vpreds[1 + VP_MAX_SWEEP];
+
+/* load value trace reader */
+static struct vpt_reader_t *vp_trace = NULL;
+
+/* register simulator-specific options */
+void
+sim_reg_options(struct opt_odb_t *odb)
+{
+  opt_reg_header(odb,
+"sim-vpreplay: This simulator replays a load value trace, written by\n"
+"sim-safe -vp:trace, through the value predictors.  It takes the trace file\n"
+"in place of a program, i.e., `sim-vpreplay {-options} <trace>', and runs\n"
+"the same value predictor configurations as sim-safe.\n"
+		 );
+
+  /* load limit */
+  opt_reg_uint(odb, "-max:loads", "maximum number of loads to replay",
+	       &max_loads, /* default */0,
+	       /* print */TRUE, /* format */NULL);
+
+  /* value predictor options */
+  vpred_reg_options(odb, &vp_opts, /* sweep */TRUE);
+
+  opt_reg_note(odb,
+"  Replaying a trace gives the same value predictor statistics as the\n"
+"  sim-safe run that wrote it.\n"
+	       );
+}
+
+/* check simulator-specific option values */
+void
+sim_check_options(struct opt_odb_t *odb, int argc, char **argv)
+{
+  vpred_num = vpred_check_options(&vp_opts, vpreds);
+}
+
+/* register simulator-specific statistics */
+void
+sim_reg_stats(struct stat_sdb_t *sdb)
+{
+  int i;
+
+  stat_reg_counter(sdb, "sim_num_loads",
+		   "total number of loads replayed",
+		   &sim_num_loads, sim_num_loads, NULL);
+  stat_reg_int(sdb, "sim_elapsed_time",
+	       "total simulation time in seconds",
+	       &sim_elapsed_time, 0, NULL);
+  stat_reg_formula(sdb, "sim_load_rate",
+		   "simulation speed (in loads/sec)",
+		   "sim_num_loads / sim_elapsed_time", NULL);
+  stat_reg_counter(sdb, "vp_trace.blocks",
+		   "total number of load value trace blocks read",
+		   &vp_trace->blocks, 0, NULL);
+  for (i=0; i < vpred_num; i++)
+    vpred_reg_stats(vpreds[i], sdb);
+}
+
+/* initialize the simulator */
+void
+sim_init(void)
+{
+  sim_num_loads = 0;
+}
+
+/* load program into simulated state */
+void
+sim_load_prog(char *fname,		/* program to load */
+	      int argc, char **argv,	/* program arguments */
+	      char **envp)		/* program environment */
+{
+  /* the "program" is the load value trace */
+  vp_trace = vpt_open_reader(fname);
+}
+
+/* print simulator-specific configuration information */
+void
+sim_aux_config(FILE *stream)		/* output stream */
+{
+  int i;
+
+  for (i=0; i < vpred_num; i++)
+    vpred_config(vpreds[i], stream);
+}
+
+/* dump simulator-specific auxiliary simulator statistics */
+void
+sim_aux_stats(FILE *stream)		/* output stream */
+{
+  /* nada */
+}
+
+/* un-initialize simulator-specific state */
+void
+sim_uninit(void)
+{
+  if (vp_trace)
+    vpt_close_reader(vp_trace);
+}
+
+/* start simulation, program loaded, processor precise state initialized */
+void
+sim_main(void)
+{
+  int i;
+  struct vpt_rec_t rec;
+  VAL_TAG_TYPE calc_val, pred_val;
+
+  fprintf(stderr, "sim: ** starting load value trace replay **\n");
+
+  calc_val.fsm_pred = MISS;
+  while (vpt_read(vp_trace, &rec))
+    {
+      sim_num_loads++;
+
+      /* predict the loaded value, then train on the actual one, the
+	 trace carries no inst word, the predictors do not need it */
+      calc_val.value.single_p = rec.value;
+      for (i=0; i < vpred_num; i++)
+	vpred_access(vpreds[i], rec.pc, rec.addr, /* inst */0,
+		     calc_val, &pred_val);
+
+      /* finish early? */
+      if (max_loads && sim_num_loads >= max_loads)
+	return;
+    }
+}
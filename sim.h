@@ -138,4 +138,9 @@ void sim_uninit(void);
 void
 sim_print_stats(FILE *fd);		/* output stream */
 
+/* register a function called just before the final stats are printed,
+   lets a simulator quiesce any work still in flight, e.g., worker threads */
+void
+sim_stats_hook(void (*fn)(void));	/* pre-stats hook function */
+
 #endif /* SIM_H */
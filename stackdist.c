@@ -0,0 +1,205 @@
+/* stackdist.c - single pass multi-configuration cache simulation routines */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+#include "stackdist.h"
+
+/* create a stack distance simulator NAME for the grid of caches with BSIZE
+   byte blocks, MIN_SETS to MAX_SETS sets and 1 to MAX_ASSOC ways, that
+   simulates 1 in SAMPLE sets */
+struct sd_t *				/* stack distance simulator */
+sd_create(char *name,			/* name of the simulator */
+	  int min_sets,			/* smallest set count */
+	  int max_sets,			/* largest set count */
+	  int bsize,			/* block size of all caches */
+	  int max_assoc,		/* largest associativity */
+	  int sample)			/* sample 1 in SAMPLE sets */
+{
+  struct sd_t *sd;
+  int i, nsampled, nstacks;
+
+  /* check all parameters */
+  if (min_sets <= 0 || (min_sets & (min_sets-1)) != 0)
+    fatal("smallest set count `%d' must be a non-zero power of two",
+	  min_sets);
+  if (max_sets < min_sets || (max_sets & (max_sets-1)) != 0)
+    fatal("largest set count `%d' must be a power of two of at least `%d'",
+	  max_sets, min_sets);
+  if (bsize < 8 || (bsize & (bsize-1)) != 0)
+    fatal("block size (in bytes) `%d' must be a power of two of at least 8",
+	  bsize);
+  if (max_assoc <= 0 || (max_assoc & (max_assoc-1)) != 0)
+    fatal("largest associativity `%d' must be a non-zero power of two",
+	  max_assoc);
+  if (sample <= 0 || sample > min_sets)
+    fatal("set sample rate `%d' must be between 1 and the smallest set "
+	  "count", sample);
+
+  sd = (struct sd_t *)calloc(1, sizeof(struct sd_t));
+  if (!sd)
+    fatal("out of virtual memory");
+
+  /* initialize user parameters */
+  sd->name = mystrdup(name);
+  sd->min_sets = min_sets;
+  sd->nsizes = log_base2(max_sets) - log_base2(min_sets) + 1;
+  sd->bsize = bsize;
+  sd->max_assoc = max_assoc;
+  sd->nassocs = log_base2(max_assoc) + 1;
+  sd->sample = sample;
+  sd->blk_shift = log_base2(bsize);
+
+  /* pick the sampled sets by a hash of their index, so strided references
+     are not sampled all or nothing */
+  sd->sampled = (byte_t *)calloc(min_sets, sizeof(byte_t));
+  if (!sd->sampled)
+    fatal("out of virtual memory");
+  for (nsampled=0, i=0; i<min_sets; i++)
+    {
+      sd->sampled[i] = ((((word_t)i * 2654435761U) >> 16) % sample) == 0;
+      nsampled += sd->sampled[i];
+    }
+  if (!nsampled)
+    sd->sampled[0] = TRUE;
+
+  /* allocate the LRU stacks of every set count, all empty */
+  nstacks = min_sets * ((1 << sd->nsizes) - 1);
+  sd->stacks = (md_addr_t *)calloc(nstacks * max_assoc, sizeof(md_addr_t));
+  sd->size_stacks = (md_addr_t **)calloc(sd->nsizes, sizeof(md_addr_t *));
+  if (!sd->stacks || !sd->size_stacks)
+    fatal("out of virtual memory");
+  for (nstacks=0, i=0; i<sd->nsizes; i++)
+    {
+      sd->size_stacks[i] = &sd->stacks[nstacks * max_assoc];
+      nstacks += min_sets << i;
+    }
+
+  sd->misses = (counter_t *)calloc(sd->nsizes * sd->nassocs,
+				   sizeof(counter_t));
+  if (!sd->misses)
+    fatal("out of virtual memory");
+
+  return sd;
+}
+
+/* reference address ADDR */
+void
+sd_access(struct sd_t *sd,		/* stack distance simulator */
+	  md_addr_t addr)		/* address of access */
+{
+  md_addr_t blk = addr >> sd->blk_shift, key = blk + 1;
+  md_addr_t *stack;
+  counter_t *misses;
+  int i, a, depth, nsets;
+
+  sd->refs++;
+
+  /* references to sets that are not sampled are skipped */
+  if (sd->sample > 1 && !sd->sampled[blk & (sd->min_sets - 1)])
+    return;
+  sd->sampled_refs++;
+
+  /* the MRU block of its set in the smallest set count is the MRU block of
+     its set in every set count, nothing to update */
+  stack = sd->size_stacks[0] + (blk & (sd->min_sets - 1)) * sd->max_assoc;
+  if (stack[0] == key)
+    {
+      sd->mru_refs++;
+      return;
+    }
+
+  for (i=0, nsets=sd->min_sets; i<sd->nsizes; i++, nsets <<= 1)
+    {
+      stack = sd->size_stacks[i] + (blk & (nsets - 1)) * sd->max_assoc;
+
+      /* find the depth of the block, MAX_ASSOC if not in the stack */
+      for (depth=0; depth<sd->max_assoc && stack[depth] != key; depth++)
+	/* nada */;
+
+      /* the depth never grows with the set count, once the block is MRU it
+	 is MRU in all larger set counts */
+      if (depth == 0)
+	break;
+
+      /* the reference misses in the caches of at most DEPTH ways */
+      misses = &sd->misses[i * sd->nassocs];
+      for (a=0; a<sd->nassocs && (1 << a) <= depth; a++)
+	misses[a]++;
+
+      /* move the block to the top of the stack, the LRU block falls off a
+	 full stack */
+      if (depth == sd->max_assoc)
+	depth--;
+      memmove(&stack[1], &stack[0], depth * sizeof(md_addr_t));
+      stack[0] = key;
+    }
+}
+
+/* flush all caches of the grid */
+void
+sd_flush(struct sd_t *sd)		/* stack distance simulator */
+{
+  memset(sd->stacks, 0,
+	 sd->min_sets * ((1 << sd->nsizes) - 1)
+	 * sd->max_assoc * sizeof(md_addr_t));
+}
+
+/* print the grid */
+void
+sd_config(struct sd_t *sd,		/* stack distance simulator */
+	  FILE *stream)			/* output stream */
+{
+  fprintf(stream,
+	  "stack: %s: %d to %d sets, %d byte blocks, 1 to %d-way LRU\n",
+	  sd->name, sd->min_sets, sd->min_sets << (sd->nsizes - 1),
+	  sd->bsize, sd->max_assoc);
+  if (sd->sample > 1)
+    fprintf(stream, "stack: %s: sampling 1 in %d sets\n",
+	    sd->name, sd->sample);
+}
+
+/* register the stats of every configuration of the grid */
+void
+sd_reg_stats(struct sd_t *sd,		/* stack distance simulator */
+	     struct stat_sdb_t *sdb)	/* stats database */
+{
+  char buf[512], buf1[512], *name;
+  int i, a;
+
+  /* get a name for this simulator */
+  if (!sd->name || !sd->name[0])
+    name = "<unknown>";
+  else
+    name = sd->name;
+
+  sprintf(buf, "%s.refs", name);
+  stat_reg_counter(sdb, buf, "total number of references",
+		   &sd->refs, 0, NULL);
+  sprintf(buf, "%s.sampled_refs", name);
+  stat_reg_counter(sdb, buf, "total number of references simulated",
+		   &sd->sampled_refs, 0, NULL);
+
+  for (i=0; i<sd->nsizes; i++)
+    {
+      for (a=0; a<sd->nassocs; a++)
+	{
+	  int nsets = sd->min_sets << i, assoc = 1 << a;
+
+	  sprintf(buf, "%s.s%d_a%d.misses", name, nsets, assoc);
+	  sprintf(buf1, "misses of %d sets, %d-way", nsets, assoc);
+	  stat_reg_counter(sdb, buf, buf1,
+			   &sd->misses[i * sd->nassocs + a], 0, NULL);
+	  sprintf(buf, "%s.s%d_a%d.miss_rate", name, nsets, assoc);
+	  sprintf(buf1, "%s.s%d_a%d.misses / %s.sampled_refs",
+		  name, nsets, assoc, name);
+	  stat_reg_formula(sdb, buf, "miss rate (i.e., misses/ref)",
+			   buf1, NULL);
+	}
+    }
+}
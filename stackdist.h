@@ -0,0 +1,92 @@
+/* stackdist.h - single pass multi-configuration cache simulation interfaces */
+
+/*
+ * A stack distance simulator measures the miss ratios of a whole grid of LRU
+ * caches with the same block size from one pass over the reference stream,
+ * after Mattson et al.  For every set count of the grid, each set keeps its
+ * blocks in an LRU stack; a reference found at depth D of the stack of its
+ * set hits in all caches of that set count more than D ways associative and
+ * misses in the others.  The stacks are cut off at the largest
+ * associativity of the grid, deeper blocks miss in every cache of the grid,
+ * so the cost of a reference is linear in the largest associativity.
+ *
+ * The grid is all power of two set counts from MIN_SETS to MAX_SETS, by all
+ * power of two associativities from 1 to MAX_ASSOC.  A reference to the MRU
+ * block of its set in the smallest set count is at depth 0 in every set
+ * count, it is counted without touching the stacks.
+ *
+ * In sampled mode only the references to about 1 in SAMPLE of the sets of
+ * the smallest set count are simulated.  The sets of the larger set counts
+ * partition those sets, so the same references are sampled for every
+ * configuration, and the miss ratios are those of the sampled references.
+ */
+
+#ifndef STACKDIST_H
+#define STACKDIST_H
+
+#include <stdio.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+
+/* stack distance simulator definition */
+struct sd_t {
+  /* parameters */
+  char *name;			/* simulator name */
+  int min_sets;			/* smallest set count of the grid */
+  int nsizes;			/* number of set counts of the grid */
+  int bsize;			/* block size in bytes */
+  int max_assoc;		/* largest associativity of the grid */
+  int nassocs;			/* number of associativities of the grid */
+  int sample;			/* simulate 1 in SAMPLE sets, 1 for all */
+
+  /* derived data */
+  int blk_shift;		/* log2 of BSIZE */
+  byte_t *sampled;		/* sampled sets of the smallest set count */
+
+  /* LRU stacks, MAX_ASSOC entries for each set of each set count, MRU
+     first, holding block numbers plus one, 0 for an empty entry */
+  md_addr_t *stacks;
+  md_addr_t **size_stacks;	/* first stack of each set count */
+
+  /* stats */
+  counter_t refs;		/* total references seen */
+  counter_t sampled_refs;	/* total references simulated */
+  counter_t mru_refs;		/* total references to an MRU block */
+  counter_t *misses;		/* misses of each configuration, by set count
+				   then associativity */
+};
+
+/* create a stack distance simulator NAME for the grid of caches with BSIZE
+   byte blocks, MIN_SETS to MAX_SETS sets and 1 to MAX_ASSOC ways, that
+   simulates 1 in SAMPLE sets */
+struct sd_t *				/* stack distance simulator */
+sd_create(char *name,			/* name of the simulator */
+	  int min_sets,			/* smallest set count */
+	  int max_sets,			/* largest set count */
+	  int bsize,			/* block size of all caches */
+	  int max_assoc,		/* largest associativity */
+	  int sample);			/* sample 1 in SAMPLE sets */
+
+/* reference address ADDR */
+void
+sd_access(struct sd_t *sd,		/* stack distance simulator */
+	  md_addr_t addr);		/* address of access */
+
+/* flush all caches of the grid */
+void
+sd_flush(struct sd_t *sd);		/* stack distance simulator */
+
+/* print the grid */
+void
+sd_config(struct sd_t *sd,		/* stack distance simulator */
+	  FILE *stream);		/* output stream */
+
+/* register the stats of every configuration of the grid */
+void
+sd_reg_stats(struct sd_t *sd,		/* stack distance simulator */
+	     struct stat_sdb_t *sdb);	/* stats database */
+
+#endif /* STACKDIST_H */
@@ -94,6 +94,7 @@ sys_syscall(struct regs_t *regs,	/* registers to access */
 	    mem_access_fn mem_fn,	/* generic memory accessor */
 	    struct mem_t *mem,		/* memory space to access */
 	    md_inst_t inst,		/* system call inst */
-	    int traceable);		/* traceable system call? */
+	    int traceable,		/* traceable system call? */
+	    counter_t icnt);		/* insts executed, checked against EIO */
 
 #endif /* SYSCALL_H */
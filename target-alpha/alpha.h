@@ -95,6 +95,12 @@ typedef qword_t md_addr_t;
 #define MD_PAGE_SIZE		8192
 #define MD_LOG_PAGE_SIZE	13
 
+/* guest address window mapped flat into the host by -DMEM_FLAT builds, it
+   holds the stack, text, data and heap segments of OSF binaries, which are
+   loaded at 0x120000000 */
+#define MD_FLAT_BASE		0x100000000ULL
+#define MD_FLAT_SIZE		0x100000000ULL
+
 
 /*
  * target-dependent instruction faults
@@ -925,7 +925,8 @@ sys_syscall(struct regs_t *regs,	/* registers to access */
 	    mem_access_fn mem_fn,	/* generic memory accessor */
 	    struct mem_t *mem,		/* memory space to access */
 	    md_inst_t inst,		/* system call inst */
-	    int traceable)		/* traceable system call? */
+	    int traceable,		/* traceable system call? */
+	    counter_t icnt)		/* insts executed, checked against EIO */
 {
   qword_t syscode = regs->regs_R[MD_REG_V0];
 
@@ -936,7 +937,7 @@ sys_syscall(struct regs_t *regs,	/* registers to access */
   /* first, check if an EIO trace is being consumed... */
   if (traceable && sim_eio_fd != NULL)
     {
-      eio_read_trace(sim_eio_fd, sim_num_insn, regs, mem_fn, mem, inst);
+      eio_read_trace(sim_eio_fd, icnt, regs, mem_fn, mem, inst);
 
       /* kludge fix for sigreturn(), it modifies all registers */
       if (syscode == OSF_SYS_sigreturn)
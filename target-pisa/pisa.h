@@ -108,6 +108,11 @@ typedef word_t md_addr_t;
 #define MD_PAGE_SIZE		4096
 #define MD_LOG_PAGE_SIZE	12
 
+/* guest address window mapped flat into the host by -DMEM_FLAT builds, the
+   text, data, heap and stack segments all live in the low 2G */
+#define MD_FLAT_BASE		0x00000000
+#define MD_FLAT_SIZE		0x80000000
+
 
 /*
  * target-dependent instruction faults
@@ -7,366 +7,831 @@
 /************************************************/
 
 #include <stdio.h>
-//#include "misc.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+#include "misc.h"
 #include "machine.h"
-// #include "ss.h"
 #include "memory.h"
-
-//#include "define.h"
+#include "options.h"
+#include "stats.h"
 #include "vp.h"
-// #include "ss.h"
-int common_ref=0;
-int misses_vpred=0;
-/* decleration of extern variables (may be moved to the sim_main) */
-int                       en_lookup_stride; /* enable X mechanism */
-tick_t                    sim_cycle;        /* simulation time */
-int                       use_stride;       /* if (use_stride == 1) then
-						use stride predictor, else
-						use last value predictor */
-int                       use_fsm;          /* use Final state machine flag */
-
-int                       vp_replace;       /* Value prediction replace policy*/
-int                       start_fsm;        /* FSM intial state */
-int                       hash_no_i1;       /* Single precision set number */
-int                       hash_no_i2;       /* Double precision set number */
-int                       hash_asso_i1;     /* Single precision set
-					       associativity */
-int                       hash_asso_i2;     /* Double precision set
-					       associativity */
-counter_t predicted_ok=0;     /* total number of correct predictions */
-counter_t Wrong_Predictions=0;     /* total number of correct predictions */
-int lookup_accessed=0;
-int update_accessed=0;
-int allocate_accessed=0;
-extern int use_vp;           /* use value prediction */
-static Hash_ptr_i1       *hash_table_i1;    /* pointers to VP tables */
-static Hash_ptr_i2       *hash_table_i2;
-
-
-/*allocates the memory needed for the Value Prediction Tables*/
-void create_stride()
+
+/* VP table set accessors, see VP_SET_BYTES() in vp.h */
+#define SET_I1(VP, INDEX)	((VP)->table + (INDEX) * (VP)->set_bytes)
+#define TAG_I1(VP, SET)		((unsigned int *)(SET))
+#define PS_I1(VP, SET)							\
+  ((char *)(SET) + sizeof(unsigned int)*(VP)->config.assoc)
+#define X_I1(VP, SET)		(PS_I1(VP, SET) + (VP)->config.assoc)
+#define PS_S_I1(VP, SET)	(PS_I1(VP, SET) + 2*(VP)->config.assoc)
+#define RANK_I1(VP, SET)						\
+  ((unsigned char *)PS_I1(VP, SET) + 3*(VP)->config.assoc)
+#define LAST_VAL_I1(VP, SET)						\
+  ((int *)(PS_I1(VP, SET) + VP_CHAR_BYTES((VP)->config.assoc)))
+#define STRIDE_I1(VP, SET)	(LAST_VAL_I1(VP, SET) + (VP)->config.assoc)
+#define HIST_I1(VP, SET)	STRIDE_I1(VP, SET)	/* FCM */
+
+/* per-entry statistics of way I in set INDEX, NULL if not kept */
+#define STATS_I1(VP, INDEX, I)						\
+  ((VP)->entry_stats							\
+   ? &(VP)->entry_stats[(INDEX) * (VP)->config.assoc + (I)] : NULL)
+
+/* the record key of the inst at INSTPC accessing ADDR, the effective
+   address is taken in words, as the low bits of aligned word and quad
+   loads are always clear and would leave most of the sets unused */
+static md_addr_t
+key_i1(struct vpred_t *vp, md_addr_t instpc, md_addr_t addr)
 {
-	register i;
-	hash_no_i1 = MEM_PTAB_SIZE;
-  hash_asso_i1 = 4;
-	if(&use_vp==0) /* check if value prediction is used */
-	  return;
-	if((hash_table_i1=(Hash_ptr_i1 *) calloc (hash_no_i1,sizeof(Hash_ptr_i1)))==0){
-		fprintf(stderr,"out of memory. terminating program.\n");  /*calloc error*/
-		exit(-1);
-	}
-	for(i=0;i<hash_no_i1;i++)
-		if((hash_table_i1[i]=(Hash_i1 *) calloc (hash_asso_i1,sizeof(Hash_i1)))==0){
-			fprintf(stderr,"out of memory. terminating program.\n");  /*calloc error*/
-			exit(-1);
-		}
-	if((hash_table_i2=(Hash_ptr_i2 *) calloc (hash_no_i2,sizeof(Hash_ptr_i2)))==0){
-		fprintf(stderr,"out of memory. terminating program.\n");  /*calloc error*/
-		exit(-1);
+  switch (vp->config.index)
+    {
+    case VPredIndexAddr:
+      return addr / sizeof(word_t);
+    case VPredIndexXor:
+      return (instpc / sizeof(md_inst_t)) ^ (addr / sizeof(word_t));
+    default:
+      return instpc / sizeof(md_inst_t);
+    }
+}
+
+/* the FCM value history HIST with value VAL shifted in, the hash keeps
+   the last fcm_order values: each is folded to the level 2 index width,
+   and is shifted out after fcm_order more values */
+static unsigned int
+fcm_hist_i1(struct vpred_t *vp, unsigned int hist, int val)
+{
+  unsigned int fold = 0, v = (unsigned int)val;
+
+  while (v)
+    {
+      fold ^= v & vp->l2_mask;
+      v >>= vp->l2_bits;
+    }
+  return ((hist << vp->hist_shift) ^ fold) & vp->l2_mask;
+}
+
+/* set index and tag of record key KEY, see VP_TAG_VALID */
+#define INDEX_I1(VP, KEY)	((unsigned int)(KEY) & (VP)->set_mask)
+#define TAG_OF_I1(VP, KEY)						\
+  ((unsigned int)((KEY) >> (VP)->set_shift) | VP_TAG_VALID)
+
+/* allocate NBYTES of zeroed memory aligned to a VP_LINE_SIZE boundary */
+static void *
+vp_calloc_aligned(unsigned int nbytes)
+{
+  byte_t *p;
+
+  if (!(p = calloc(nbytes + VP_LINE_SIZE, 1)))
+    fatal("out of virtual memory");
+  return p + ((VP_LINE_SIZE - ((unsigned long)p & (VP_LINE_SIZE-1)))
+	      & (VP_LINE_SIZE-1));
+}
+
+/* register the value predictor options into OPTS, the -vp:sweep option and
+   its format note only if SWEEP is set */
+void
+vpred_reg_options(struct opt_odb_t *odb,/* options database */
+		  struct vpred_opts_t *opts,/* value predictor options */
+		  int sweep)		/* register -vp:sweep */
+{
+  static int table_default[2] = { /* sets */32768, /* assoc */4 };
+  static int fcm_default[2] = { /* order */4, /* l2 entries */65536 };
+
+  opt_reg_flag(odb, "-vp", "enable value prediction of loads",
+	       &opts->use_vp, /* default */TRUE,
+	       /* print */TRUE, /* format */NULL);
+
+  opt_reg_string(odb, "-vp:type",
+		 "value predictor type {lv|stride|hybrid|fcm}",
+		 &opts->type, /* default */"hybrid",
+		 /* print */TRUE, /* format */NULL);
+
+  opts->table_nelt = 2;
+  opt_reg_int_list(odb, "-vp:table",
+		   "value predictor table config (<sets> <assoc>)",
+		   opts->table_config, opts->table_nelt, &opts->table_nelt,
+		   /* default */table_default,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
+  opts->fcm_nelt = 2;
+  opt_reg_int_list(odb, "-vp:fcm",
+		   "FCM value predictor config (<order> <l2 entries>)",
+		   opts->fcm_config, opts->fcm_nelt, &opts->fcm_nelt,
+		   /* default */fcm_default,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
+  opt_reg_int(odb, "-vp:start_fsm",
+	      "value predictor classification fsm initial state (0..3)",
+	      &opts->start_fsm, /* default */0,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_string(odb, "-vp:replace",
+		 "value predictor replacement policy {fsm|lru}",
+		 &opts->replace, /* default */"fsm",
+		 /* print */TRUE, /* format */NULL);
+
+  opt_reg_string(odb, "-vp:index",
+		 "value predictor table index {pc|addr|pc^addr}",
+		 &opts->index, /* default */"pc",
+		 /* print */TRUE, /* format */NULL);
+
+  opt_reg_flag(odb, "-vp:fsm",
+	       "gate value predictions by the classification fsm",
+	       &opts->use_fsm, /* default */FALSE,
+	       /* print */TRUE, /* format */NULL);
+
+  opt_reg_flag(odb, "-vp:estats",
+	       "keep per-entry value predictor statistics",
+	       &opts->entry_stats, /* default */FALSE,
+	       /* print */TRUE, /* format */NULL);
+
+  opts->sweep_nelt = 0;
+  if (!sweep)
+    return;
+
+  opt_reg_string_list(odb, "-vp:sweep",
+		      "additional value predictor config (may be repeated)",
+		      opts->sweep_opts, /* arr_sz */VP_MAX_SWEEP,
+		      &opts->sweep_nelt, /* default */NULL,
+		      /* print */TRUE, /* format */NULL, /* accrue */TRUE);
+
+  opt_reg_note(odb,
+"  The value predictor sweep parameter <config> has the following format:\n"
+"\n"
+"    <name>:<type>:<sets>:<assoc>:<start_fsm>:<repl>[:<index>]\n"
+"\n"
+"    <name>      - name of the predictor, prefixes its statistics, unique\n"
+"                  and not 'vpred'\n"
+"    <type>      - predictor type, 'lv', 'stride', 'hybrid' or 'fcm', fcm\n"
+"                  predictors take their order and level 2 size from -vp:fcm\n"
+"    <sets>      - number of sets in the VP table, a power of two\n"
+"    <assoc>     - associativity of the VP table\n"
+"    <start_fsm> - classification fsm initial state (0..3)\n"
+"    <repl>      - replacement strategy, 'f'-FSM then LRU, 'l'-LRU\n"
+"    <index>     - table index 'pc', 'addr' or 'pc^addr', default -vp:index\n"
+"\n"
+"    Examples:   -vp:sweep vp1k:hybrid:1024:2:0:f\n"
+"                -vp:sweep vp4k:lv:4096:4:1:l:addr\n"
+	       );
+}
+
+/* parse a value predictor type name */
+static enum vpred_class
+vp_parse_class(char *name)
+{
+  if (!mystricmp(name, "lv"))
+    return VPredLastValue;
+  else if (!mystricmp(name, "stride"))
+    return VPredStride;
+  else if (!mystricmp(name, "hybrid"))
+    return VPredHybrid;
+  else if (!mystricmp(name, "fcm"))
+    return VPredFCM;
+  else
+    fatal("unknown value predictor type `%s'", name);
+  return VPredHybrid;
+}
+
+/* parse a value predictor table index name */
+static enum vpred_index
+vp_parse_index(char *name)
+{
+  if (!mystricmp(name, "pc"))
+    return VPredIndexPC;
+  else if (!mystricmp(name, "addr"))
+    return VPredIndexAddr;
+  else if (!mystricmp(name, "pc^addr"))
+    return VPredIndexXor;
+  else
+    fatal("unknown value predictor index `%s'", name);
+  return VPredIndexPC;
+}
+
+/* check the value predictor options OPTS and create the predictors they
+   describe into VPREDS: the -vp predictor (if enabled) followed by one per
+   -vp:sweep config, returns the number of predictors created, at most
+   1 + VP_MAX_SWEEP */
+int
+vpred_check_options(struct vpred_opts_t *opts,/* value predictor options */
+		    struct vpred_t **vpreds)/* created predictors */
+{
+  int i, j, num = 0;
+  struct vpred_config_t config;
+
+  if (opts->table_nelt != 2)
+    fatal("bad value predictor table config (<sets> <assoc>)");
+  if (opts->fcm_nelt != 2)
+    fatal("bad FCM value predictor config (<order> <l2 entries>)");
+
+  /* the -vp predictor */
+  config.class = vp_parse_class(opts->type);
+  config.sets = opts->table_config[0];
+  config.assoc = opts->table_config[1];
+  config.start_fsm = opts->start_fsm;
+  if (!mystricmp(opts->replace, "fsm"))
+    config.replace = VPredReplFSM;
+  else if (!mystricmp(opts->replace, "lru"))
+    config.replace = VPredReplLRU;
+  else
+    fatal("unknown value predictor replacement policy `%s'", opts->replace);
+  config.index = vp_parse_index(opts->index);
+  config.use_fsm = opts->use_fsm;
+  config.xmech = FALSE;
+  config.entry_stats = opts->entry_stats;
+  config.fcm_order = opts->fcm_config[0];
+  config.fcm_l2_size = opts->fcm_config[1];
+
+  if (opts->use_vp)
+    vpreds[num++] = vpred_create("vpred", &config);
+
+  /* the sweep predictors, these share the -vp fsm gating, statistics and
+     FCM options */
+  for (i=0; i < opts->sweep_nelt; i++)
+    {
+      char name[128], type[128], index[128], c;
+      int n;
+
+      n = sscanf(opts->sweep_opts[i],
+		 "%127[^:]:%127[^:]:%d:%d:%d:%c:%127s",
+		 name, type, &config.sets, &config.assoc,
+		 &config.start_fsm, &c, index);
+      if (n != 6 && n != 7)
+	fatal("bad value predictor sweep parms: "
+	      "<name>:<type>:<sets>:<assoc>:<start_fsm>:<repl>[:<index>]");
+
+      /* the name prefixes the predictor's stats, so it must be unique */
+      if (!strcmp(name, "vpred"))
+	fatal("value predictor sweep name `vpred' is reserved for -vp");
+      for (j=0; j < num; j++)
+	if (!strcmp(vpreds[j]->name, name))
+	  fatal("duplicate value predictor sweep name `%s'", name);
+      config.index = vp_parse_index(n == 7 ? index : opts->index);
+
+      config.class = vp_parse_class(type);
+
+      switch (c)
+	{
+	case 'f': case 'F':
+	  config.replace = VPredReplFSM; break;
+	case 'l': case 'L':
+	  config.replace = VPredReplLRU; break;
+	default:
+	  fatal("bad value predictor replacement policy `%c'", c);
 	}
-	for(i=0;i<hash_no_i2;i++)
-		if((hash_table_i2[i]=(Hash_i2 *) calloc (hash_asso_i2,sizeof(Hash_i2)))==0){
-			fprintf(stderr,"out of memory. terminating program.\n");  /*calloc error*/
-			exit(-1);
-		}
-
-} /* end of create_stride */
-
-/* update an instruction in the Vp table (update output outcomes)*/
-int update(
- md_addr_t instpc, /* The instruction address */
- md_inst_t inst,   /* The instruction opcode and registers */
- VAL_TAG_TYPE pred_val, /* The given (by lookup) predicted value and flags */
- VAL_TAG_TYPE calc_val, /* The actual (calc) value and flags */
- struct mem_t *mem ,
- int my_ref             /* The Time of the update */  )
+
+      vpreds[num++] = vpred_create(name, &config);
+    }
+
+  return num;
+}
+
+/* create a value predictor */
+struct vpred_t *			/* value predictor instance */
+vpred_create(char *name,		/* predictor name, prefixes stats */
+	     struct vpred_config_t *config)/* predictor configuration */
 {
-  update_accessed++;
-  unsigned int index;  /* set index */
-  unsigned int pc;     /* shifted inst address */
-  int val[2];          /* instruction output value single/double int */
-  register i;
-  char flag[2];        /* single/double precision correct prediction flags */
-  char found=0;        /* inst "found" status */
-  enum md_opcode op;   /* decoded opcode enum */
-  int found1;
-  if(&use_vp==0) /* check if using VP */
-     return(MISS);
-  pc = (unsigned int)(instpc>>INST_OFFSET);
-  flag[0]=0;
-  flag[1]=0;
-  MD_SET_OPCODE(op, inst);  /* recover opcode from inst */
-  //if(SS_OP_FLAGS(op)&F_SINGLE_P){
-    /* single precision output */
-     val[0]=calc_val.value.single_p;
-     index = (unsigned int)(pc % hash_no_i1); /* find table entry */
-     for(i=0;i<hash_asso_i1;i++)
-       /* find inst in set */
-         if((hash_table_i1[index][i].pc==pc)&&(hash_table_i1[index][i].valid)){
-	    found=1;
-	    break;
-	 }
-     if(!found)                   /*miss*/
-	return(MISS);
-     else{
-        if(val[0]==pred_val.value.single_p){
-              /*hit*/
-	   predicted_ok++;       /* increase total predicated ok counter */
-	   /* update the classification fsm state */
-	   if(hash_table_i1[index][i].ps<3)
-	      hash_table_i1[index][i].ps++;
-	   flag[0]=1;
-	   hash_table_i1[index][i].pred_correct++; /* statistics */
-	 }
-         else{ /* hit fault: found, but wrong prediction was given */
-	   /* update the classification fsm state */
-        	 	if(use_stride != 1 && en_lookup_stride != 1)
-            { 
-                en_lookup_stride = 1;
-                use_stride = 1;
-                lookup(instpc,inst,&pred_val,mem);
-                found1 = update(instpc,inst,pred_val,calc_val,mem,common_ref);
-                use_stride =0;
-                en_lookup_stride = 0;
-            }
-            else
-            {
-              Wrong_Predictions++;
-              lookup_undo(instpc,inst,pred_val);
-            }
-	    if(hash_table_i1[index][i].ps>0)
-	      hash_table_i1[index][i].ps--;
-
-
-	 }
-
-       hash_table_i1[index][i].accessed++;    /* statistics */
-
-       if (hash_table_i1[index][i].x<1)
-	   panic("invalid X value (lookup stride)");
-
-       /* X is decreased only if:
-	   A. X was increased in lookup (there was a lookup hit).
-	   B. X > 1.   */
-       if ((hash_table_i1[index][i].x>1)&&(pred_val.fsm_pred!=MISS))
-	 hash_table_i1[index][i].x--;     /* lookup X mechanism update */
-
-       /* stride, last_val, last_ref are updated only in order */
-
-       if (hash_table_i1[index][i].last_ref<my_ref) {
-         /* update stride value */
-         hash_table_i1[index][i].stride=val[0]-hash_table_i1[index][i].last_val;
-         hash_table_i1[index][i].last_ref=my_ref;
-         hash_table_i1[index][i].last_val=val[0]; /* update last value */
-       }
-
-
-       if(flag[0]==1)
-	 return(HIT);
-       else return(HITFAULT);
-     }
+  struct vpred_t *vp;
+  int i, j;
+
+  if (config->class < 0 || config->class >= VPred_NUM)
+    panic("bogus value predictor class");
+  if (config->sets <= 0 || (config->sets & (config->sets - 1)) != 0)
+    fatal("number of VP table sets must be a positive power of two");
+  if (config->assoc <= 0 || config->assoc > VP_MAX_ASSOC)
+    fatal("VP table associativity must be 1..%d", VP_MAX_ASSOC);
+  if (config->start_fsm < 0 || config->start_fsm > 3)
+    fatal("VP fsm initial state must be 0..3");
+
+  if (!(vp = calloc(1, sizeof(struct vpred_t))))
+    fatal("out of virtual memory");
+
+  vp->name = mystrdup(name);
+  vp->config = *config;
+
+  if (config->class == VPredFCM)
+    {
+      if (config->fcm_order < 1)
+	fatal("FCM value history depth must be positive");
+      if (config->fcm_l2_size < 2 || config->fcm_l2_size > (1 << 30)
+	  || (config->fcm_l2_size & (config->fcm_l2_size - 1)) != 0)
+	fatal("FCM level 2 table size must be a power of two, 2..2^30");
+    }
+
+  /* sets are indexed by the low key bits, tagged by the rest */
+  vp->set_mask = config->sets - 1;
+  vp->set_shift = log_base2(config->sets);
+
+  /* one contiguous block of line aligned sets */
+  vp->set_bytes = VP_SET_BYTES(config->assoc);
+  vp->table = vp_calloc_aligned(config->sets * vp->set_bytes);
+
+  /* the empty ways of a set start out in way order, way 0 the MRU way */
+  for (i=0; i < config->sets; i++)
+    for (j=0; j < config->assoc; j++)
+      RANK_I1(vp, SET_I1(vp, i))[j] = j;
+
+  /* the FCM level 2 table, shared by all insts */
+  if (config->class == VPredFCM)
+    {
+      vp->l2 = vp_calloc_aligned(config->fcm_l2_size * sizeof(int));
+      vp->l2_mask = config->fcm_l2_size - 1;
+      vp->l2_bits = log_base2(config->fcm_l2_size);
+
+      /* a value is shifted out of the history after fcm_order more */
+      vp->hist_shift =
+	(vp->l2_bits + config->fcm_order - 1) / config->fcm_order;
+    }
+
+  /* per-entry statistics are kept off the lookup path, if at all */
+  if (config->entry_stats)
+    {
+      vp->entry_stats =
+	calloc(config->sets * config->assoc, sizeof(Hash_stats_i1));
+      if (!vp->entry_stats)
+	fatal("out of virtual memory");
+    }
+
+  return vp;
+}
 
+/* print value predictor configuration */
+void
+vpred_config(struct vpred_t *vp,	/* value predictor instance */
+	     FILE *stream)		/* output stream */
+{
+  static char *class_str[VPred_NUM] = { "lv", "stride", "hybrid", "fcm" };
+  static char *index_str[] = { "pc", "addr", "pc^addr" };
+
+  fprintf(stream,
+	  "%s: %s, %d sets, %d-way, %s index, fsm start %d, "
+	  "%s replacement%s%s\n",
+	  vp->name, class_str[vp->config.class],
+	  vp->config.sets, vp->config.assoc, index_str[vp->config.index],
+	  vp->config.start_fsm,
+	  vp->config.replace == VPredReplLRU ? "LRU" : "FSM",
+	  vp->config.use_fsm ? ", fsm gated" : "",
+	  vp->config.xmech ? ", X mechanism" : "");
+  if (vp->config.class == VPredFCM)
+    fprintf(stream, "%s: FCM order %d, %d level 2 entries\n",
+	    vp->name, vp->config.fcm_order, vp->config.fcm_l2_size);
+}
+
+/* register value predictor stats */
+void
+vpred_reg_stats(struct vpred_t *vp,	/* value predictor instance */
+		struct stat_sdb_t *sdb)	/* stats database */
+{
+  char buf[512], buf1[512], *name = vp->name;
+
+  sprintf(buf, "%s.lookups", name);
+  stat_reg_counter(sdb, buf, "total number of VP lookups",
+		   &vp->lookups, 0, NULL);
+  sprintf(buf, "%s.updates", name);
+  stat_reg_counter(sdb, buf, "total number of VP updates",
+		   &vp->updates, 0, NULL);
+  sprintf(buf, "%s.allocations", name);
+  stat_reg_counter(sdb, buf, "total number of VP records allocated",
+		   &vp->allocations, 0, NULL);
+  sprintf(buf, "%s.hits", name);
+  stat_reg_counter(sdb, buf, "total number of accesses finding a record",
+		   &vp->hits, 0, NULL);
+  sprintf(buf, "%s.misses", name);
+  stat_reg_counter(sdb, buf, "total number of accesses missing a record",
+		   &vp->misses, 0, NULL);
+  sprintf(buf, "%s.correct", name);
+  stat_reg_counter(sdb, buf, "total correct predictions made",
+		   &vp->correct, 0, NULL);
+  sprintf(buf, "%s.wrong", name);
+  stat_reg_counter(sdb, buf, "total wrong predictions made",
+		   &vp->wrong, 0, NULL);
+  sprintf(buf, "%s.accuracy", name);
+  sprintf(buf1, "%s.correct / (%s.correct + %s.wrong)", name, name, name);
+  stat_reg_formula(sdb, buf, "fraction of predictions that were correct",
+		   buf1, NULL);
+  sprintf(buf, "%s.coverage", name);
+  sprintf(buf1, "%s.correct / (%s.hits + %s.misses)", name, name, name);
+  stat_reg_formula(sdb, buf, "fraction of accesses predicted correctly",
+		   buf1, NULL);
+
+  if (vp->config.class == VPredHybrid)
+    {
+      sprintf(buf, "%s.lv_correct", name);
+      stat_reg_counter(sdb, buf,
+		       "correct predictions of the last value component",
+		       &vp->lv_correct, 0, NULL);
+      sprintf(buf, "%s.stride_correct", name);
+      stat_reg_counter(sdb, buf,
+		       "correct predictions of the stride component",
+		       &vp->stride_correct, 0, NULL);
+      sprintf(buf, "%s.used_lv", name);
+      stat_reg_counter(sdb, buf,
+		       "total number of last value predictions used",
+		       &vp->used_lv, 0, NULL);
+      sprintf(buf, "%s.used_stride", name);
+      stat_reg_counter(sdb, buf,
+		       "total number of stride predictions used",
+		       &vp->used_stride, 0, NULL);
+      sprintf(buf, "%s.lv_rate", name);
+      sprintf(buf1, "%s.lv_correct / (%s.correct + %s.wrong)",
+	      name, name, name);
+      stat_reg_formula(sdb, buf, "last value component accuracy",
+		       buf1, NULL);
+      sprintf(buf, "%s.stride_rate", name);
+      sprintf(buf1, "%s.stride_correct / (%s.correct + %s.wrong)",
+	      name, name, name);
+      stat_reg_formula(sdb, buf, "stride component accuracy",
+		       buf1, NULL);
+    }
 }
 
-/* recover from a pipe flush - decrease the X value */
-int lookup_undo(
- md_addr_t instpc,/* The instruction address */
- md_inst_t inst,  /* The instruction opcode and registers */
- VAL_TAG_TYPE pred_val  /* The instruction predicted value and flags */ )
+/* returns the way holding TAG in SET, or -1 if not found, empty entries
+   never match as TAG has VP_TAG_VALID set */
+static int
+find_way_i1(struct vpred_t *vp, byte_t *set, unsigned int tag)
 {
-  unsigned int index;
-  unsigned int pc;
-  register i;
-  char found=0;
-  enum md_opcode op; /* decoded opcode enum */
-
-  if(&use_vp==0)
-     return(MISS);
-  pc = (unsigned int)(instpc>>INST_OFFSET);
-  MD_SET_OPCODE(op, inst);
-  //if(SS_OP_FLAGS(op)&F_SINGLE_P){
-     index = (unsigned int)(pc % hash_no_i1);
-     for(i=0;i<hash_asso_i1;i++)
-         if((hash_table_i1[index][i].pc==pc)&&(hash_table_i1[index][i].valid)){
-	    found=1;
-	    break;
-	 }
-     if(!found)                   /*miss*/
-	return(MISS);
-     else{
-       if (hash_table_i1[index][i].x<1)
-	   panic("invalid X value (lookup stride)");
-
-       if ((hash_table_i1[index][i].x>1)&&(pred_val.fsm_pred!=MISS))
-	   hash_table_i1[index][i].x--;
-       return(HIT);
-     }
+  unsigned int *tags = TAG_I1(vp, set);
+  int i;
 
+  for (i=0; i < vp->config.assoc; i++)
+    if (tags[i] == tag)
+      return i;
+  return -1;
 }
 
-/* find a replacment candidate. Replacement policy:
-   LRU */
-unsigned int find_new_place_lru(
-int index, /* the table entry in which the record should be place */
-char data_type /* single or double presicion */)
+/* make way I the MRU way of SET, the ways more recent than I age by one */
+static void
+touch_way_i1(struct vpred_t *vp, byte_t *set, int i)
 {
-  unsigned int i;
-  int min_ref;
-  unsigned int new_place;
-
-  switch(data_type){
-	  case SINGLE:
-	                 /* init min_ref */
-			 min_ref=hash_table_i1[index][0].last_ref;
-			 new_place=0;
-			 for(i=0;i<hash_asso_i1;i++){
-				 if(hash_table_i1[index][i].valid == 0)
-				 return(i);
-				 else if(hash_table_i1[index][i].last_ref<min_ref){
-				 min_ref=hash_table_i1[index][i].last_ref;
-				 new_place=i;
-				 }
-			 }
-			 return(new_place);
-			 break;
-
-          default :      panic("unknown data type\n");
-      }
+  unsigned char *rank = RANK_I1(vp, set), r = rank[i];
+  int j;
+
+  for (j=0; j < vp->config.assoc; j++)
+    if (rank[j] < r)
+      rank[j]++;
+  rank[i] = 0;
 }
 
-/* find a replacment candidate. Replacment policy:
+/* form the predicted output value of the inst in way I of SET, increments
+   the entry's X value */
+static void
+predict_way_i1(struct vpred_t *vp, byte_t *set, int i,
+	       VAL_TAG_TYPE *pred_val)
+{
+  int val;
+  char X;             /* X (lookup stride) mechanisim value */
+  char ps;            /* confidence of the component used */
+  int stride_p;       /* use the stride component? */
+
+  X=X_I1(vp, set)[i]; /* set  the current lookup X value */
+  X_I1(vp, set)[i]++; /* increase X value */
+
+  /* pick the component: the hybrid predictor goes with the more confident
+     one, ties go to last value */
+  switch (vp->config.class)
+    {
+    case VPredHybrid:
+      stride_p = (PS_S_I1(vp, set)[i] > PS_I1(vp, set)[i]);
+      ps = (stride_p ? PS_S_I1(vp, set)[i] : PS_I1(vp, set)[i]);
+      if (stride_p)
+	vp->used_stride++;
+      else
+	vp->used_lv++;
+      break;
+    case VPredStride:
+      stride_p = TRUE;
+      ps = PS_I1(vp, set)[i];
+      break;
+    default:
+      stride_p = FALSE;
+      ps = PS_I1(vp, set)[i];
+      break;
+    }
+
+  /* calculate the return predicted output value and flags */
+  if (vp->config.class == VPredFCM)
+    {
+      /* the value that followed this value history last time */
+      pred_val->value.single_p = vp->l2[HIST_I1(vp, set)[i]];
+    }
+  else
+    {
+      val = (vp->config.xmech
+	     ? X*STRIDE_I1(vp, set)[i] : STRIDE_I1(vp, set)[i]);
+      pred_val->value.single_p =
+	LAST_VAL_I1(vp, set)[i] + (stride_p ? val : 0);
+    }
+  /* fsm classification:
+     fsm_pred == 1 => go with prediction
+     fsm_pred == 0 => don't use prediction */
+  pred_val->fsm_pred = (vp->config.use_fsm ? ps>>1 : HIT);
+}
+
+/* recover from a pipe flush of the inst in way I of SET - decrease its X
+   value */
+static void
+undo_way_i1(struct vpred_t *vp, byte_t *set, int i, VAL_TAG_TYPE pred_val)
+{
+  if (X_I1(vp, set)[i]<1)
+    panic("invalid X value (lookup stride)");
+
+  if ((X_I1(vp, set)[i]>1)&&(pred_val.fsm_pred!=MISS))
+    X_I1(vp, set)[i]--;
+}
+
+/* score the prediction PRED_VAL given for the inst in way I of set INDEX
+   against its actual output CALC_VAL and update the entry, returns HIT or
+   HITFAULT */
+static int
+update_way_i1(struct vpred_t *vp, unsigned int index, byte_t *set, int i,
+	      VAL_TAG_TYPE pred_val, VAL_TAG_TYPE calc_val)
+{
+  int val;                     /* instruction output value */
+  Hash_stats_i1 *st;           /* entry statistics, if kept */
+  int correct = FALSE;         /* correct prediction flag */
+  int hybrid = (vp->config.class == VPredHybrid);
+
+  vp->updates++;
+  val=calc_val.value.single_p;
+  st = STATS_I1(vp, index, i);
+
+  if (hybrid)
+    {
+      /* score both components in this one pass, each against the
+	 candidate it offered at lookup time */
+      int lv_p, stride_p;
+
+      lv_p = LAST_VAL_I1(vp, set)[i];
+      stride_p = lv_p + STRIDE_I1(vp, set)[i]
+	* ((vp->config.xmech && X_I1(vp, set)[i] > 1)
+	   ? X_I1(vp, set)[i]-1 : 1);
+
+      if (val == lv_p)
+	{
+	  vp->lv_correct++;
+	  if (PS_I1(vp, set)[i]<3)
+	    PS_I1(vp, set)[i]++;
+	}
+      else if (PS_I1(vp, set)[i]>0)
+	PS_I1(vp, set)[i]--;
+
+      if (val == stride_p)
+	{
+	  vp->stride_correct++;
+	  if (PS_S_I1(vp, set)[i]<3)
+	    PS_S_I1(vp, set)[i]++;
+	}
+      else if (PS_S_I1(vp, set)[i]>0)
+	PS_S_I1(vp, set)[i]--;
+    }
+
+  if(val==pred_val.value.single_p){
+    /*hit*/
+    vp->correct++;       /* increase total predicated ok counter */
+    /* update the classification fsm state */
+    if(!hybrid && PS_I1(vp, set)[i]<3)
+      PS_I1(vp, set)[i]++;
+    correct = TRUE;
+    if (st)
+      st->pred_correct++; /* statistics */
+  }
+  else{ /* hit fault: found, but wrong prediction was given */
+    vp->wrong++;
+    undo_way_i1(vp, set, i, pred_val);
+    /* update the classification fsm state */
+    if(!hybrid && PS_I1(vp, set)[i]>0)
+      PS_I1(vp, set)[i]--;
+  }
+
+  if (st)
+    st->accessed++;    /* statistics */
+
+  if (X_I1(vp, set)[i]<1)
+    panic("invalid X value (lookup stride)");
+
+  /* X is decreased only if:
+     A. X was increased in lookup (there was a lookup hit).
+     B. X > 1.   */
+  if ((X_I1(vp, set)[i]>1)&&(pred_val.fsm_pred!=MISS))
+    X_I1(vp, set)[i]--;     /* lookup X mechanism update */
+
+  if (vp->config.class == VPredFCM)
+    {
+      /* train the level 2 entry of the old history, then extend it */
+      vp->l2[HIST_I1(vp, set)[i]] = val;
+      HIST_I1(vp, set)[i] = fcm_hist_i1(vp, HIST_I1(vp, set)[i], val);
+    }
+  else /* update stride value */
+    STRIDE_I1(vp, set)[i]=val-LAST_VAL_I1(vp, set)[i];
+  LAST_VAL_I1(vp, set)[i]=val; /* update last value */
+  touch_way_i1(vp, set, i);
+
+  return (correct ? HIT : HITFAULT);
+}
+
+/* find a replacment candidate in SET. Replacement policy: LRU */
+static int
+find_new_place_lru(struct vpred_t *vp, byte_t *set)
+{
+  int i, max_rank, new_place;
+
+  /* init max_rank */
+  max_rank=RANK_I1(vp, set)[0];
+  new_place=0;
+  for(i=0;i<vp->config.assoc;i++){
+    if(TAG_I1(vp, set)[i] == VP_TAG_INVALID)
+      return(i);
+    else if(RANK_I1(vp, set)[i]>max_rank){
+      max_rank=RANK_I1(vp, set)[i];
+      new_place=i;
+    }
+  }
+  return(new_place);
+}
+
+/* find a replacment candidate in SET. Replacment policy:
    find all the entries with the (same) lowest fsm state (these are less
    predictable insts). from all these replace the LRU entry. */
-unsigned int find_new_place_fsm(int index, char data_type)
+static int
+find_new_place_fsm(struct vpred_t *vp, byte_t *set)
 {
-  unsigned int i;
+  int i, max_rank, new_place;
   char min_ps;
-  int min_ref;
-  unsigned int new_place;
-
-  switch(data_type){
-	  case SINGLE:
-	                 min_ps=hash_table_i1[index][0].ps;
-			 min_ref=hash_table_i1[index][0].last_ref;
-			 new_place=0;
-			 for(i=0;i<hash_asso_i1;i++){
-			     if(hash_table_i1[index][i].valid == 0)
-				return(i);
-			     else if(hash_table_i1[index][i].ps<min_ps){
-			         min_ps=hash_table_i1[index][i].ps;
-				 min_ref=hash_table_i1[index][i].last_ref;
-			         new_place=i;
-			     }
-			     else if((hash_table_i1[index][i].ps==min_ps)&&
-				    (hash_table_i1[index][i].last_ref<min_ref)){
-				 min_ref=hash_table_i1[index][i].last_ref;
-				 new_place=i;
-			     }
-			 }
-			 return(new_place);
-			 break;
-
-          default :      panic("unknown data type\n");
-      }
-}
 
+  min_ps=PS_I1(vp, set)[0];
+  max_rank=RANK_I1(vp, set)[0];
+  new_place=0;
+  for(i=0;i<vp->config.assoc;i++){
+    if(TAG_I1(vp, set)[i] == VP_TAG_INVALID)
+      return(i);
+    else if(PS_I1(vp, set)[i]<min_ps){
+      min_ps=PS_I1(vp, set)[i];
+      max_rank=RANK_I1(vp, set)[i];
+      new_place=i;
+    }
+    else if((PS_I1(vp, set)[i]==min_ps)&&
+	    (RANK_I1(vp, set)[i]>max_rank)){
+      max_rank=RANK_I1(vp, set)[i];
+      new_place=i;
+    }
+  }
+  return(new_place);
+}
 
-/* allocates a new record */
-void allocate(md_addr_t pred_PC, /* allocated inst's address */
-md_inst_t inst, /* allocated inst's opcode and registers */
-VAL_TAG_TYPE calc_val,  /* allocated inst's last output value and flags */
-int my_ref /* allocated inst's fetch/decode time stamp */)
+/* allocate a record for TAG in set INDEX, holding last output value VAL */
+static void
+allocate_i1(struct vpred_t *vp, unsigned int index, unsigned int tag,
+	    int val)
 {
-allocate_accessed++;
-unsigned int index;    /* table index */
-unsigned int pc;       /* shifted pc address */
-int val[2];            /* the instruction output(s) value */
-unsigned int replace;  /* the record in which the pc is allocated */
-//register j;
-char data_type;        /* instruction precision */
-enum md_opcode op;     /* instruction opcode */
-
-/* using Value Prediction ? */
-if(&use_vp==0)
-   return;
-MD_SET_OPCODE(op, inst);
-pc = (unsigned int)(pred_PC)>>INST_OFFSET;
-
-// if(SS_OP_FLAGS(op)&F_SINGLE_P){
-  /* single precision */
-   val[0]=calc_val.value.single_p;
-   data_type=SINGLE;
-   index=(unsigned int)(pc % hash_no_i1);
-
-   /* find allocation entry */
-   replace=(vp_replace ? find_new_place_lru(index,data_type)
-	               : find_new_place_fsm(index,data_type));
-
-   /* update the entry fields */
-   hash_table_i1[index][replace].pc = pc;
-   hash_table_i1[index][replace].ps = start_fsm;
-   hash_table_i1[index][replace].x = 1;
-   hash_table_i1[index][replace].last_val = val[0];
-   hash_table_i1[index][replace].stride = 0;
-   hash_table_i1[index][replace].accessed = 1;
-   hash_table_i1[index][replace].pred_correct = 0;
-   hash_table_i1[index][replace].last_alloc = (int) sim_cycle;
-   hash_table_i1[index][replace].last_ref = (int) my_ref;
-   hash_table_i1[index][replace].valid=1;
+  int replace;           /* the record in which the tag is allocated */
+  byte_t *set;           /* set receiving the record */
+  Hash_stats_i1 *st;     /* entry statistics, if kept */
+
+  vp->allocations++;
+
+  /* find allocation entry */
+  set = SET_I1(vp, index);
+  replace = (vp->config.replace == VPredReplLRU
+	     ? find_new_place_lru(vp, set)
+	     : find_new_place_fsm(vp, set));
+
+  /* update the entry fields */
+  TAG_I1(vp, set)[replace] = tag;
+  PS_I1(vp, set)[replace] = vp->config.start_fsm;
+  PS_S_I1(vp, set)[replace] = vp->config.start_fsm;
+  X_I1(vp, set)[replace] = 1;
+  LAST_VAL_I1(vp, set)[replace] = val;
+  STRIDE_I1(vp, set)[replace] =
+    (vp->config.class == VPredFCM ? fcm_hist_i1(vp, 0, val) : 0);
+  touch_way_i1(vp, set, replace);
+
+  if ((st = STATS_I1(vp, index, replace)) != NULL)
+    {
+      st->accessed = 1;
+      st->pred_correct = 0;
+      st->last_alloc = vp->ref;
+    }
 }
-/* lookup for inst in the VP table and return the predicted output values
-    */
-void lookup(md_addr_t pred_PC,/* The instruction address */
-md_inst_t inst, /* The instruction calculated value and flags */
-VAL_TAG_TYPE *pred_val,   /* The instruction predicted value and flags */
-struct mem_t *mem  /* The memory block to be accessed for reading the value */ )
+
+/* access the VP table for an executed inst: find its record with a single
+   probe, form the prediction into PRED_VAL, score it against the actual
+   output CALC_VAL and update the record, or allocate one on a miss;
+   returns HIT, HITFAULT or MISS */
+int
+vpred_access(struct vpred_t *vp,	/* value predictor instance */
+	     md_addr_t instpc,		/* inst address */
+	     md_addr_t addr,		/* effective address */
+	     md_inst_t inst,		/* inst opcode and registers */
+	     VAL_TAG_TYPE calc_val,	/* actual output value */
+	     VAL_TAG_TYPE *pred_val)	/* returned predicted value */
 {
-  lookup_accessed++;
-  unsigned int index; /* VP table index*/
-  unsigned int pc;    /* instruction shifted address */
-  int val[2];
+  md_addr_t key;       /* record key */
+  unsigned int index;  /* set index */
+  unsigned int tag;    /* record tag */
+  byte_t *set;         /* set holding the inst */
+  int i;               /* way holding the inst */
 
-  register i;
-  char X;             /* X (lookup stride) mechanisim value */
-  // char flag[2];
-  char found=0;
-  enum md_opcode op;  /* decoded opcode enum */
+  vp->lookups++;
+  vp->ref++;
+  pred_val->fsm_pred=MISS;
+  key = key_i1(vp, instpc, addr);
+  index = INDEX_I1(vp, key);
+  tag = TAG_OF_I1(vp, key);
+  set = SET_I1(vp, index);
+  i = find_way_i1(vp, set, tag);
+  if (i < 0)
+    {
+      vp->misses++;
+      allocate_i1(vp, index, tag, calc_val.value.single_p);
+      return(MISS);
+    }
+
+  vp->hits++;
+  predict_way_i1(vp, set, i, pred_val);
+  return update_way_i1(vp, index, set, i, *pred_val, calc_val);
+}
+
+/* lookup for inst in the VP table and return the predicted output value,
+   pred_val->fsm_pred is MISS if the inst has no record */
+void
+vpred_lookup(struct vpred_t *vp,	/* value predictor instance */
+	     md_addr_t instpc,		/* inst address */
+	     md_addr_t addr,		/* effective address */
+	     md_inst_t inst,		/* inst opcode and registers */
+	     VAL_TAG_TYPE *pred_val)	/* returned predicted value */
+{
+  md_addr_t key;      /* record key */
+  byte_t *set;        /* set probed for the inst */
+  int i;
 
+  vp->lookups++;
+  vp->ref++;
   pred_val->fsm_pred=MISS;
+  key = key_i1(vp, instpc, addr);
+  set = SET_I1(vp, INDEX_I1(vp, key));
+  i = find_way_i1(vp, set, TAG_OF_I1(vp, key));
+  if (i >= 0)
+    predict_way_i1(vp, set, i, pred_val);
+}
 
-  /* using Value Prediction ? */
-  if(&use_vp==0)
-     return;
-  pc = (unsigned int)(pred_PC>>INST_OFFSET); /* shifting the instruction
-                                                address */
-
-  // flag[0]=0;  clear flags
-  // flag[1]=0;
-  MD_SET_OPCODE(op, inst); /* recover op code from inst */
-
-  //if(SS_OP_FLAGS(op)&F_SINGLE_P){
-    /* single precision */
-     index = (unsigned int)(pc % hash_no_i1);
-     for(i=0;i<hash_asso_i1;i++)
-       /* find entry in the single precision table */
-         if((hash_table_i1[index][i].pc==pc)&&(hash_table_i1[index][i].valid)){
-	    found=1;
-	    break;
-	 }
-     if(!found)                   /*miss*/
-	{  pred_val->fsm_pred=MISS;
-  }
-     else{
-       	X=hash_table_i1[index][i].x; /* set  the current lookup X value */
-        hash_table_i1[index][i].x++; /* increase X value */
-        /* calculate the return predicted output value and flags */
-	val[0]=((en_lookup_stride==0)?hash_table_i1[index][i].stride:X*hash_table_i1[index][i].stride);
-	pred_val->value.single_p=(hash_table_i1[index][i].last_val+((use_stride==0)?0:val[0]));	/*hit*/
-	/* fsm classification:
-	   fsm_pred == 1 => go with prediction
-	   fsm_pred == 0 => don't use prediction */
-        pred_val->fsm_pred=(use_fsm?hash_table_i1[index][i].ps>>1:HIT);
-        //update(pred_PC,inst,*pred_val,calc_val,common_ref++);
-     }
+/* update an inst's record with its actual output value, returns HIT,
+   HITFAULT or MISS if the inst has no record */
+int
+vpred_update(struct vpred_t *vp,	/* value predictor instance */
+	     md_addr_t instpc,		/* inst address */
+	     md_addr_t addr,		/* effective address */
+	     md_inst_t inst,		/* inst opcode and registers */
+	     VAL_TAG_TYPE pred_val,	/* value given by vpred_lookup() */
+	     VAL_TAG_TYPE calc_val)	/* actual output value */
+{
+  md_addr_t key;       /* record key */
+  unsigned int index;  /* set index */
+  int i;
+
+  key = key_i1(vp, instpc, addr);
+  index = INDEX_I1(vp, key);
+  i = find_way_i1(vp, SET_I1(vp, index), TAG_OF_I1(vp, key));
+  if (i < 0)
+    {
+      vp->misses++;
+      return(MISS);
+    }
+  vp->hits++;
+  return update_way_i1(vp, index, SET_I1(vp, index), i,
+		       pred_val, calc_val);
+}
+
+/* recover from a pipe flush - decrease the inst's X value */
+int
+vpred_lookup_undo(struct vpred_t *vp,	/* value predictor instance */
+		  md_addr_t instpc,	/* inst address */
+		  md_addr_t addr,	/* effective address */
+		  md_inst_t inst,	/* inst opcode and registers */
+		  VAL_TAG_TYPE pred_val)/* value given by vpred_lookup() */
+{
+  md_addr_t key;
+  byte_t *set;
+  int i;
+
+  key = key_i1(vp, instpc, addr);
+  set = SET_I1(vp, INDEX_I1(vp, key));
+  i = find_way_i1(vp, set, TAG_OF_I1(vp, key));
+  if(i < 0)                    /*miss*/
+    return(MISS);
+  undo_way_i1(vp, set, i, pred_val);
+  return(HIT);
+}
+
+/* allocate a record for an inst */
+void
+vpred_allocate(struct vpred_t *vp,	/* value predictor instance */
+	       md_addr_t instpc,	/* inst address */
+	       md_addr_t addr,		/* effective address */
+	       md_inst_t inst,		/* inst opcode and registers */
+	       VAL_TAG_TYPE calc_val)	/* inst's last output value */
+{
+  md_addr_t key;         /* record key */
 
+  key = key_i1(vp, instpc, addr);
+  allocate_i1(vp, INDEX_I1(vp, key), TAG_OF_I1(vp, key),
+	      calc_val.value.single_p);
 }
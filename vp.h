@@ -1,8 +1,13 @@
 #ifndef _stride_h_
 #define _stride_h_
 
+#include "host.h"
+#include "misc.h"
 #include "machine.h"
 #include "memory.h"
+#include "options.h"
+#include "stats.h"
+
 /* constants for entry lookup, update status in stride table: */
 /* MISS - not found */
 #define MISS	 	-1
@@ -14,48 +19,102 @@
 #define HITFAULT  	2
 
 
-/* op data type table constants */
-#define SINGLE	 	0
-#define DOUBLE		1
-
-/* pc stride (in bits) */
-#define INST_OFFSET	0
+/* host cache line size, the VP table and each of its sets are aligned to
+   this boundary */
+#define VP_LINE_SIZE	64
 
 #define is_PRED   ((MD_OP_FLAGS(op) & F_LOAD))
-/* Single precision table entry definition */
-typedef struct ln_i1{
-  unsigned long	pc;     /* entry PC (tag) */
-  int last_val;         /* last output value */
-  int stride;           /* the stride between the two known last values */
-  int last_alloc;       /* allocation sim_cycle time */
-  int last_ref;         /* last lookup sim_cycle time */
-  char ps;              /* classification fsm present state:
-			             0,1 - don't use prediction (don't go)
-			             1,2 - use prediction (go)           */
-  char valid;           /* valid bit */
-  char x;               /* X machanism - for high bandwidth fetch:
-			   when using X mechanism predicted value is not:
-			   last_val + stride, but: last_val + X*stride.
-			   X is incremented with every fetch (lookup) and
-			   decremented when the instruction leaves (either
-			   by normal terminition (update) or when instruction
-			   doesn't exit via commit, i.e. pipe is flushed
-			   (lookup_undo) */
-  int accessed;
-  int pred_correct;
-} Hash_i1, *Hash_ptr_i1;
-
-/* Double precision table entry definition */
-typedef struct ln_i2{
-  unsigned long	pc;
-  int last_val[2];
-  int stride[2];
-  int last_alloc;
-  int last_ref;
-  char ps;
-  char valid;
-  char x;
-} Hash_i2, *Hash_ptr_i2;
+
+/* value predictor types */
+enum vpred_class {
+  VPredLastValue,		/* last value predictor */
+  VPredStride,			/* stride predictor */
+  VPredHybrid,			/* last value/stride, most confident wins */
+  VPredFCM,			/* two-level finite context method */
+  VPred_NUM
+};
+
+/* value predictor table index, the key that indexes and tags a record */
+enum vpred_index {
+  VPredIndexPC,			/* load inst address */
+  VPredIndexAddr,		/* load effective address */
+  VPredIndexXor			/* inst address xor effective address */
+};
+
+/* value predictor replacement policies */
+enum vpred_replace {
+  VPredReplFSM,			/* least confident, then LRU */
+  VPredReplLRU			/* LRU */
+};
+
+/* VP table layout: the table is one contiguous, line aligned block of
+   a power of two sets, indexed by the low bits of the record key (see
+   enum vpred_index).  Each set holds the state of its assoc entries as a
+   structure of arrays, ordered so that everything a lookup reads comes
+   first:
+
+     unsigned int tag[assoc];       entry tag, the key bits above the set
+                                    index with VP_TAG_VALID set, or
+                                    VP_TAG_INVALID for an empty entry
+     char         ps[assoc];        classification fsm present state:
+                                      0,1 - don't use prediction (don't go)
+                                      2,3 - use prediction (go)
+     char         x[assoc];         X machanism - for high bandwidth fetch:
+                                    when using X mechanism predicted value
+                                    is not: last_val + stride, but:
+                                    last_val + X*stride.  X is incremented
+                                    with every fetch (lookup) and
+                                    decremented when the instruction leaves
+                                    (either by normal terminition (update)
+                                    or when instruction doesn't exit via
+                                    commit, i.e. pipe is flushed
+                                    (lookup_undo))
+     char         ps_s[assoc];      stride component classification fsm
+                                    state, hybrid mode only (ps then
+                                    tracks the last value component)
+     unsigned char rank[assoc];     recency rank, 0 for the MRU way and
+                                    assoc-1 for the LRU way, set by updates
+                                    and allocations, read by replacement
+     int          last_val[assoc];  last output value, the char arrays are
+                                    padded to an int boundary
+     int          stride[assoc];    the stride between the two known last
+                                    values, or in an FCM predictor the
+                                    folded value history, i.e., the index
+                                    of the level 2 value to predict
+
+   the set is padded up to a multiple of VP_LINE_SIZE bytes.  A probe,
+   hit or miss, reads only the tags, a prediction adds ps, x, ps_s,
+   last_val and stride, and the update or allocation that follows adds
+   rank; a set of up to 4 ways is 64 bytes, so an access of the default
+   4-way table, lookup and update, touches one line.
+
+   An FCM predictor adds a level 2 table of values shared by all insts,
+   indexed by the value history (stride) of the entry; the update trains
+   the level 2 value the lookup read before it extends the history, so an
+   FCM access of a table of up to 4 ways touches two lines, the set and
+   one level 2 line */
+#define VP_CHAR_BYTES(ASSOC)						\
+  ((4*sizeof(char)*(ASSOC) + (sizeof(int) - 1)) & ~(sizeof(int) - 1))
+#define VP_SET_BYTES(ASSOC)						\
+  (((ASSOC) * 3*sizeof(int) + VP_CHAR_BYTES(ASSOC)			\
+    + (VP_LINE_SIZE - 1)) & ~(VP_LINE_SIZE - 1))
+
+/* maximum VP table associativity, recency ranks are kept in a byte */
+#define VP_MAX_ASSOC	256
+
+/* tag word of an empty entry, a freshly allocated table is all empty, and
+   the valid flag that every stored tag carries, the tag bits it displaces
+   are above any text or data address */
+#define VP_TAG_INVALID	0
+#define VP_TAG_VALID	0x80000000U
+
+/* per-entry statistics, these are not needed to make a prediction and are
+   kept in an optional side array indexed by set * assoc + way */
+typedef struct ln_stats_i1{
+  int last_alloc;       /* allocation reference time */
+  int accessed;         /* number of updates to this entry */
+  int pred_correct;     /* number of correct predictions by this entry */
+} Hash_stats_i1;
 
 typedef struct value_t_t
 {
@@ -69,31 +128,148 @@ typedef struct VAL_TAG_TYPE_t
   value_t value;
 }VAL_TAG_TYPE;
 
+/* value predictor configuration */
+struct vpred_config_t {
+  enum vpred_class class;	/* type of predictor */
+  int sets;			/* number of sets, a power of two */
+  int assoc;			/* VP table associativity */
+  int start_fsm;		/* classification fsm initial state */
+  enum vpred_replace replace;	/* replacement policy */
+  enum vpred_index index;	/* record key */
+  int use_fsm;			/* gate predictions by the fsm state */
+  int xmech;			/* predict last_val + X*stride */
+  int entry_stats;		/* keep per-entry statistics */
+  int fcm_order;		/* FCM value history depth */
+  int fcm_l2_size;		/* FCM level 2 table entries, a power of two */
+};
+
+/* value predictor def */
+struct vpred_t {
+  char *name;			/* predictor name, prefixes its stats */
+  struct vpred_config_t config;	/* predictor configuration */
+
+  byte_t *table;		/* VP table sets, see VP_SET_BYTES() */
+  unsigned int set_bytes;	/* bytes per VP table set */
+  unsigned int set_mask;	/* set index mask */
+  int set_shift;		/* log2(sets), tags are key >> set_shift */
+  Hash_stats_i1 *entry_stats;	/* per-entry statistics, or NULL */
+  int ref;			/* reference clock, advanced per lookup */
+  int *l2;			/* FCM level 2 value table, or NULL */
+  unsigned int l2_mask;		/* FCM level 2 index mask */
+  int l2_bits;			/* FCM level 2 index width */
+  int hist_shift;		/* FCM history shift per value */
+
+  /* stats */
+  counter_t lookups;		/* num lookups */
+  counter_t updates;		/* num updates */
+  counter_t allocations;	/* num records allocated */
+  counter_t hits;		/* num accesses that found their record */
+  counter_t misses;		/* num accesses that allocated a record */
+  counter_t correct;		/* num correct predictions */
+  counter_t wrong;		/* num incorrect predictions */
+  counter_t lv_correct;		/* num correct last value component preds */
+  counter_t stride_correct;	/* num correct stride component preds */
+  counter_t used_lv;		/* num last value preds used (hybrid) */
+  counter_t used_stride;	/* num stride preds used (hybrid) */
+};
+
+/* maximum number of value predictor sweep configurations */
+#define VP_MAX_SWEEP		32
+
+/* value predictor options, shared by the simulators that predict load
+   values, see vpred_reg_options() */
+struct vpred_opts_t {
+  int use_vp;			/* -vp, create the "vpred" predictor */
+  char *type;			/* -vp:type, i.e., {lv|stride|hybrid|fcm} */
+  int table_nelt;		/* -vp:table, i.e., {<sets> <assoc>} */
+  int table_config[2];
+  int fcm_nelt;			/* -vp:fcm, i.e., {<order> <l2 entries>} */
+  int fcm_config[2];
+  int start_fsm;		/* -vp:start_fsm */
+  char *replace;		/* -vp:replace, i.e., {fsm|lru} */
+  char *index;			/* -vp:index, i.e., {pc|addr|pc^addr} */
+  int use_fsm;			/* -vp:fsm */
+  int entry_stats;		/* -vp:estats */
+  int sweep_nelt;		/* -vp:sweep, one config per option */
+  char *sweep_opts[VP_MAX_SWEEP];
+};
+
+/* register the value predictor options into OPTS, the -vp:sweep option and
+   its format note only if SWEEP is set */
+void
+vpred_reg_options(struct opt_odb_t *odb,/* options database */
+		  struct vpred_opts_t *opts,/* value predictor options */
+		  int sweep);		/* register -vp:sweep */
 
+/* check the value predictor options OPTS and create the predictors they
+   describe into VPREDS: the -vp predictor (if enabled) followed by one per
+   -vp:sweep config, returns the number of predictors created, at most
+   1 + VP_MAX_SWEEP */
+int
+vpred_check_options(struct vpred_opts_t *opts,/* value predictor options */
+		    struct vpred_t **vpreds);/* created predictors */
 
-extern int                       en_lookup_stride;
-// extern tick_t                    sim_cycle;
-extern int                       use_stride;
-extern int                       use_fsm;
-extern int                       use_trace_cache;
-extern int                       vp_replace;
-extern int                       start_fsm;
-extern int                       hash_no_i1;
-extern int                       hash_no_i2;
-extern int                       hash_asso_i1;
-extern int                       hash_asso_i2;
+/* create a value predictor */
+struct vpred_t *			/* value predictor instance */
+vpred_create(char *name,		/* predictor name, prefixes stats */
+	     struct vpred_config_t *config);/* predictor configuration */
 
+/* print value predictor configuration */
+void
+vpred_config(struct vpred_t *vp,	/* value predictor instance */
+	     FILE *stream);		/* output stream */
 
-/* function headers : */
+/* register value predictor stats */
+void
+vpred_reg_stats(struct vpred_t *vp,	/* value predictor instance */
+		struct stat_sdb_t *sdb);/* stats database */
 
-void create_stride();
+/* access the VP table for an executed inst: find its record with a single
+   probe, form the prediction into PRED_VAL, score it against the actual
+   output CALC_VAL and update the record, or allocate one on a miss;
+   returns HIT, HITFAULT or MISS */
+int
+vpred_access(struct vpred_t *vp,	/* value predictor instance */
+	     md_addr_t instpc,		/* inst address */
+	     md_addr_t addr,		/* effective address */
+	     md_inst_t inst,		/* inst opcode and registers */
+	     VAL_TAG_TYPE calc_val,	/* actual output value */
+	     VAL_TAG_TYPE *pred_val);	/* returned predicted value */
 
-int update(md_addr_t instpc,md_inst_t inst,VAL_TAG_TYPE pred_val,VAL_TAG_TYPE calc_val,struct mem_t *mem, int my_ref);
+/* lookup for inst in the VP table and return the predicted output value,
+   pred_val->fsm_pred is MISS if the inst has no record */
+void
+vpred_lookup(struct vpred_t *vp,	/* value predictor instance */
+	     md_addr_t instpc,		/* inst address */
+	     md_addr_t addr,		/* effective address */
+	     md_inst_t inst,		/* inst opcode and registers */
+	     VAL_TAG_TYPE *pred_val);	/* returned predicted value */
 
-int lookup_undo(md_addr_t instpc, md_inst_t inst, VAL_TAG_TYPE pred_val);
+/* update an inst's record with its actual output value, returns HIT,
+   HITFAULT or MISS if the inst has no record; updates are applied in the
+   order they are made, so callers update in program order */
+int
+vpred_update(struct vpred_t *vp,	/* value predictor instance */
+	     md_addr_t instpc,		/* inst address */
+	     md_addr_t addr,		/* effective address */
+	     md_inst_t inst,		/* inst opcode and registers */
+	     VAL_TAG_TYPE pred_val,	/* value given by vpred_lookup() */
+	     VAL_TAG_TYPE calc_val);	/* actual output value */
 
-void allocate(md_addr_t pred_PC,md_inst_t inst,VAL_TAG_TYPE calc_val,int my_ref);
+/* recover from a pipe flush - decrease the inst's X value */
+int
+vpred_lookup_undo(struct vpred_t *vp,	/* value predictor instance */
+		  md_addr_t instpc,	/* inst address */
+		  md_addr_t addr,	/* effective address */
+		  md_inst_t inst,	/* inst opcode and registers */
+		  VAL_TAG_TYPE pred_val);/* value given by vpred_lookup() */
 
-void lookup(md_addr_t pred_PC,md_inst_t inst,VAL_TAG_TYPE *pred_val,struct mem_t *mem);
+/* allocate a record for an inst */
+void
+vpred_allocate(struct vpred_t *vp,	/* value predictor instance */
+	       md_addr_t instpc,	/* inst address */
+	       md_addr_t addr,		/* effective address */
+	       md_inst_t inst,		/* inst opcode and registers */
+	       VAL_TAG_TYPE calc_val);	/* inst's last output value */
 
 #endif
@@ -0,0 +1,191 @@
+/* vpstream.c - load value stream routines */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "vpstream.h"
+
+/* maximum records per publish, smaller rings publish every quarter ring */
+#define VPS_MAX_BATCH		256
+
+/* ring index loads and stores, the acquire/release pairs order the record
+   contents against the indices that publish and free them */
+#define VPS_LOAD(P)		__atomic_load_n((P), __ATOMIC_ACQUIRE)
+#define VPS_STORE(P, V)		__atomic_store_n((P), (V), __ATOMIC_RELEASE)
+
+/* create a load value stream with a ring of SIZE records, SIZE must be a
+   power of two */
+struct vps_t *				/* load value stream */
+vps_create(unsigned int size)		/* ring size, in records */
+{
+  struct vps_t *vps;
+
+  if (size < 16 || (size & (size - 1)) != 0)
+    fatal("load value stream size `%d' must be a power of two >= 16", size);
+
+  vps = calloc(1, sizeof(struct vps_t));
+  if (!vps)
+    fatal("out of virtual memory");
+
+  vps->ring = calloc(size, sizeof(struct vps_rec_t));
+  if (!vps->ring)
+    fatal("out of virtual memory");
+
+  vps->size = size;
+  vps->mask = size - 1;
+  vps->batch = MIN(VPS_MAX_BATCH, size/4);
+
+  /* no consumers yet, the first reservation sets the real limit */
+  vps->next = vps->limit = vps->head = 0;
+  vps->done = FALSE;
+  vps->ncons = 0;
+  vps->running = FALSE;
+
+  return vps;
+}
+
+/* add a consumer to stream VPS, must be called before vps_start() */
+void
+vps_add_consumer(struct vps_t *vps,	/* load value stream */
+		 vps_consume_fn_t fn,	/* consumer function */
+		 void *arg)		/* consumer function argument */
+{
+  struct vps_cons_t *cons;
+
+  if (vps->running)
+    panic("consumer added to a running load value stream");
+  if (vps->ncons == VPS_MAX_CONS)
+    fatal("too many load value stream consumers, max is %d", VPS_MAX_CONS);
+
+  cons = &vps->cons[vps->ncons++];
+  cons->tail = 0;
+  cons->fn = fn;
+  cons->arg = arg;
+  cons->vps = vps;
+}
+
+/* consumer thread body, hands every published record to the consumer
+   function, a ring wrap at a time, until the stream is finished */
+static void *
+vps_consumer(void *arg)			/* consumer */
+{
+  struct vps_cons_t *cons = arg;
+  struct vps_t *vps = cons->vps;
+  unsigned long tail = cons->tail, head;
+  int done;
+
+  for (;;)
+    {
+      /* DONE is read before HEAD, so a finished stream is seen drained */
+      done = VPS_LOAD(&vps->done);
+      head = VPS_LOAD(&vps->head);
+      if (head == tail)
+	{
+	  if (done)
+	    break;
+	  sched_yield();
+	  continue;
+	}
+
+      while (head != tail)
+	{
+	  unsigned int index = tail & vps->mask;
+	  unsigned int n = MIN(head - tail, vps->size - index);
+
+	  cons->fn(cons->arg, &vps->ring[index], n);
+	  tail += n;
+
+	  /* free the slots for the producer */
+	  VPS_STORE(&cons->tail, tail);
+	}
+    }
+
+  return NULL;
+}
+
+/* start the consumer threads of stream VPS */
+void
+vps_start(struct vps_t *vps)		/* load value stream */
+{
+  int i;
+
+  if (vps->running)
+    panic("load value stream already running");
+
+  for (i=0; i < vps->ncons; i++)
+    {
+      if (pthread_create(&vps->cons[i].thread, NULL,
+			 vps_consumer, &vps->cons[i]) != 0)
+	fatal("cannot create load value stream consumer thread");
+    }
+  vps->running = TRUE;
+}
+
+/* make room for the producer, stalls until the slowest consumer frees a
+   ring slot, use vps_put() */
+void
+vps_reserve(struct vps_t *vps)		/* load value stream */
+{
+  int i;
+  unsigned long tail, min_tail;
+
+  if (!vps->running)
+    panic("load value stream is not running");
+
+  for (;;)
+    {
+      /* find the slowest consumer, all consumers trail NEXT */
+      min_tail = vps->next;
+      for (i=0; i < vps->ncons; i++)
+	{
+	  tail = VPS_LOAD(&vps->cons[i].tail);
+	  if (vps->next - tail > vps->next - min_tail)
+	    min_tail = tail;
+	}
+
+      if (vps->next - min_tail < vps->size)
+	{
+	  vps->limit = min_tail + vps->size;
+	  return;
+	}
+
+      /* ring is full, make sure the consumers can see everything written
+	 so far, then wait for the slowest one */
+      vps_publish(vps);
+      sched_yield();
+    }
+}
+
+/* publish all written records to the consumers */
+void
+vps_publish(struct vps_t *vps)		/* load value stream */
+{
+  VPS_STORE(&vps->head, vps->next);
+}
+
+/* publish any remaining records, then wait for all the consumers to drain
+   the stream and exit, the stream accepts no more records */
+void
+vps_finish(struct vps_t *vps)		/* load value stream */
+{
+  int i;
+
+  if (!vps->running)
+    return;
+
+  vps_publish(vps);
+  VPS_STORE(&vps->done, TRUE);
+
+  for (i=0; i < vps->ncons; i++)
+    {
+      if (pthread_join(vps->cons[i].thread, NULL) != 0)
+	fatal("cannot join load value stream consumer thread");
+    }
+  vps->running = FALSE;
+}
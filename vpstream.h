@@ -0,0 +1,115 @@
+/* vpstream.h - load value stream interfaces */
+
+/*
+ * A load value stream carries the (pc, addr, value, icount) records of the
+ * executed loads from the functional simulator to any number of consumer
+ * threads.  The stream is a single-producer/multi-consumer broadcast ring:
+ * every consumer sees every record, in program order, through its own
+ * read index, so no locks are taken on the record path.  The producer
+ * publishes records in batches and only stalls when the slowest consumer
+ * is a full ring behind.
+ */
+
+#ifndef VPSTREAM_H
+#define VPSTREAM_H
+
+#include <pthread.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+
+/* maximum number of consumers of a stream */
+#define VPS_MAX_CONS		64
+
+/* host cache line size, the ring indices are padded to this */
+#define VPS_LINE_SIZE		64
+
+/* a load value record */
+struct vps_rec_t {
+  md_addr_t pc;			/* load inst address */
+  md_addr_t addr;		/* effective address */
+  counter_t icount;		/* inst count at the load */
+  word_t value;			/* loaded value */
+  md_inst_t inst;		/* load inst */
+};
+
+/* consume the records RECS[0..N-1], called from a consumer thread */
+typedef void (*vps_consume_fn_t)(void *arg, struct vps_rec_t *recs, int n);
+
+/* a stream consumer, padded so the read indices of different consumers
+   never share a line */
+struct vps_cons_t {
+  unsigned long tail;		/* next record to read */
+  vps_consume_fn_t fn;		/* consumer function */
+  void *arg;			/* consumer function argument */
+  pthread_t thread;		/* consumer thread */
+  struct vps_t *vps;		/* owning stream */
+  char pad[VPS_LINE_SIZE];
+};
+
+/* a load value stream, the ring indices are free running and only ever
+   compared by difference, so they may wrap */
+struct vps_t {
+  struct vps_rec_t *ring;	/* record ring */
+  unsigned int size;		/* ring size, a power of two */
+  unsigned int mask;		/* ring index mask */
+  unsigned int batch;		/* records per publish */
+
+  /* producer state, only the producer touches these */
+  unsigned long next;		/* next record to write */
+  unsigned long limit;		/* NEXT may not reach this w/o a tail check */
+
+  char pad0[VPS_LINE_SIZE];
+  unsigned long head;		/* records published so far */
+  int done;			/* no more records will be published */
+  char pad1[VPS_LINE_SIZE];
+
+  int ncons;			/* number of consumers */
+  int running;			/* consumer threads started */
+  struct vps_cons_t cons[VPS_MAX_CONS];
+};
+
+/* create a load value stream with a ring of SIZE records, SIZE must be a
+   power of two */
+struct vps_t *				/* load value stream */
+vps_create(unsigned int size);		/* ring size, in records */
+
+/* add a consumer to stream VPS, must be called before vps_start() */
+void
+vps_add_consumer(struct vps_t *vps,	/* load value stream */
+		 vps_consume_fn_t fn,	/* consumer function */
+		 void *arg);		/* consumer function argument */
+
+/* start the consumer threads of stream VPS */
+void
+vps_start(struct vps_t *vps);		/* load value stream */
+
+/* make room for the producer, stalls until the slowest consumer frees a
+   ring slot, use vps_put() */
+void
+vps_reserve(struct vps_t *vps);		/* load value stream */
+
+/* publish all written records to the consumers */
+void
+vps_publish(struct vps_t *vps);		/* load value stream */
+
+/* append a record to stream VPS, records are published a batch at a time */
+#define vps_put(VPS, PC, ADDR, VALUE, INST, ICOUNT)			\
+  do {									\
+    struct vps_rec_t *__rec;						\
+    if ((VPS)->next == (VPS)->limit)					\
+      vps_reserve(VPS);							\
+    __rec = &(VPS)->ring[(VPS)->next & (VPS)->mask];			\
+    __rec->pc = (PC); __rec->addr = (ADDR); __rec->value = (VALUE);	\
+    __rec->inst = (INST); __rec->icount = (ICOUNT);			\
+    if ((++(VPS)->next & ((VPS)->batch - 1)) == 0)			\
+      vps_publish(VPS);							\
+  } while (0)
+
+/* publish any remaining records, then wait for all the consumers to drain
+   the stream and exit, the stream accepts no more records */
+void
+vps_finish(struct vps_t *vps);		/* load value stream */
+
+#endif /* VPSTREAM_H */
@@ -0,0 +1,350 @@
+/* vptrace.c - load value trace routines */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "vptrace.h"
+
+/* record tag bits */
+#define VPT_TAG_SIZE		0x03	/* log2 of the access size */
+#define VPT_TAG_PC		0x04	/* PC predicted by the previous PC */
+#define VPT_TAG_ADDR		0x08	/* addr predicted by the stride */
+#define VPT_TAG_VALUE		0x10	/* value is the last value */
+
+/* largest encoded record: tag, two 64-bit and one 32-bit varint */
+#define VPT_MAX_REC		(1 + 10 + 10 + 5)
+
+/* zigzag code delta D, maps small negative and positive deltas to small
+   unsigned ints */
+static qword_t
+zigzag(sqword_t d)
+{
+  return ((qword_t)d << 1) ^ (qword_t)(d >> 63);
+}
+
+/* zigzag decode U */
+static sqword_t
+unzigzag(qword_t u)
+{
+  return (sqword_t)(u >> 1) ^ -(sqword_t)(u & 1);
+}
+
+/* append varint V at *P */
+static void
+put_varint(byte_t **p, qword_t v)
+{
+  while (v >= 0x80)
+    {
+      *(*p)++ = (byte_t)(v | 0x80);
+      v >>= 7;
+    }
+  *(*p)++ = (byte_t)v;
+}
+
+/* read a varint at *P, bounded by END */
+static qword_t
+get_varint(byte_t **p, byte_t *end)
+{
+  qword_t v = 0;
+  int shift = 0;
+
+  do {
+    if (*p == end || shift > 63)
+      fatal("corrupt load value trace record");
+    v |= (qword_t)(**p & 0x7f) << shift;
+    shift += 7;
+  } while (*(*p)++ & 0x80);
+
+  return v;
+}
+
+/* clear the record coder, done at the start of each block */
+static void
+coder_reset(struct vpt_coder_t *coder)
+{
+  memset(coder, 0, sizeof(*coder));
+}
+
+/* find the context of PC, replacing whatever context held its slot */
+static struct vpt_ctx_t *
+coder_ctx(struct vpt_coder_t *coder, md_addr_t pc)
+{
+  struct vpt_ctx_t *ctx =
+    &coder->ctx[(pc / sizeof(md_inst_t)) & (VPT_CTX_SIZE - 1)];
+
+  if (ctx->pc != pc)
+    {
+      memset(ctx, 0, sizeof(*ctx));
+      ctx->pc = pc;
+    }
+  return ctx;
+}
+
+/* the PC predicted to follow the previous record, 0 if none */
+static md_addr_t
+coder_next_pc(struct vpt_coder_t *coder)
+{
+  struct vpt_ctx_t *ctx =
+    &coder->ctx[(coder->last_pc / sizeof(md_inst_t)) & (VPT_CTX_SIZE - 1)];
+
+  return (ctx->pc == coder->last_pc) ? ctx->next_pc : 0;
+}
+
+/* update the coder with a coded record, CTX is the context of PC */
+static void
+coder_update(struct vpt_coder_t *coder, struct vpt_ctx_t *ctx,
+	     md_addr_t pc, md_addr_t addr, word_t value)
+{
+  struct vpt_ctx_t *last =
+    &coder->ctx[(coder->last_pc / sizeof(md_inst_t)) & (VPT_CTX_SIZE - 1)];
+
+  if (last->pc == coder->last_pc)
+    last->next_pc = pc;
+  coder->last_pc = pc;
+
+  ctx->stride = addr - ctx->last_addr;
+  ctx->last_addr = addr;
+  ctx->last_val = value;
+}
+
+/* create a trace file FNAME */
+struct vpt_writer_t *			/* trace writer */
+vpt_open_writer(char *fname)		/* trace file name */
+{
+  struct vpt_writer_t *w;
+  struct vpt_header_t header;
+
+  w = calloc(1, sizeof(struct vpt_writer_t));
+  if (!w)
+    fatal("out of virtual memory");
+
+  w->fd = fopen(fname, "wb");
+  if (!w->fd)
+    fatal("cannot open load value trace `%s'", fname);
+
+  w->buf = calloc(VPT_BLOCK_RECS, VPT_MAX_REC);
+  if (!w->buf)
+    fatal("out of virtual memory");
+
+  memset(&header, 0, sizeof(header));
+  strcpy(header.magic, VPT_MAGIC);
+  header.version = VPT_VERSION;
+  header.endian = 0x01020304;
+  header.addr_size = sizeof(md_addr_t);
+  header.block_recs = VPT_BLOCK_RECS;
+  if (fwrite(&header, sizeof(header), 1, w->fd) != 1)
+    fatal("cannot write load value trace header");
+  w->bytes = sizeof(header);
+
+  coder_reset(&w->coder);
+  w->len = w->nrecs = 0;
+
+  return w;
+}
+
+/* append a load record to the trace */
+void
+vpt_write(struct vpt_writer_t *w,	/* trace writer */
+	  md_addr_t pc,			/* load inst address */
+	  md_addr_t addr,		/* effective address */
+	  int size,			/* access size, in bytes */
+	  word_t value)			/* word_t at ADDR */
+{
+  struct vpt_ctx_t *ctx;
+  byte_t *p = w->buf + w->len, *tag = p++;
+
+  switch (size)
+    {
+    case 1: *tag = 0; break;
+    case 2: *tag = 1; break;
+    case 4: *tag = 2; break;
+    case 8: *tag = 3; break;
+    default:
+      panic("bogus load size `%d'", size);
+    }
+
+  if (pc == coder_next_pc(&w->coder) && pc != 0)
+    *tag |= VPT_TAG_PC;
+  else
+    put_varint(&p, zigzag((sqword_t)(pc - w->coder.last_pc)));
+
+  ctx = coder_ctx(&w->coder, pc);
+  if (addr == ctx->last_addr + ctx->stride)
+    *tag |= VPT_TAG_ADDR;
+  else
+    put_varint(&p, zigzag((sqword_t)(addr - ctx->last_addr)));
+
+  if (value == ctx->last_val)
+    *tag |= VPT_TAG_VALUE;
+  else
+    put_varint(&p, zigzag((sqword_t)(sword_t)(value - ctx->last_val)));
+
+  coder_update(&w->coder, ctx, pc, addr, value);
+
+  w->len = p - w->buf;
+  w->recs++;
+  if (++w->nrecs == VPT_BLOCK_RECS)
+    vpt_flush(w);
+}
+
+/* write out any partial block, the trace then ends on a complete block */
+void
+vpt_flush(struct vpt_writer_t *w)	/* trace writer */
+{
+  struct vpt_block_t block;
+
+  if (!w->nrecs)
+    return;
+
+  block.magic = VPT_BLOCK_MAGIC;
+  block.nrecs = w->nrecs;
+  block.nbytes = w->len;
+  block.pad = 0;
+  if (fwrite(&block, sizeof(block), 1, w->fd) != 1
+      || fwrite(w->buf, w->len, 1, w->fd) != 1)
+    fatal("cannot write load value trace block");
+
+  w->bytes += sizeof(block) + w->len;
+  w->blocks++;
+
+  /* the next block starts from a clean coder */
+  coder_reset(&w->coder);
+  w->len = w->nrecs = 0;
+}
+
+/* flush and close the trace */
+void
+vpt_close_writer(struct vpt_writer_t *w)/* trace writer */
+{
+  vpt_flush(w);
+  fclose(w->fd);
+  free(w->buf);
+  free(w);
+}
+
+/* map trace file FNAME for reading */
+struct vpt_reader_t *			/* trace reader */
+vpt_open_reader(char *fname)		/* trace file name */
+{
+  int fd;
+  struct stat sbuf;
+  struct vpt_reader_t *r;
+  struct vpt_header_t *header;
+
+  r = calloc(1, sizeof(struct vpt_reader_t));
+  if (!r)
+    fatal("out of virtual memory");
+
+  fd = open(fname, O_RDONLY);
+  if (fd < 0)
+    fatal("cannot open load value trace `%s'", fname);
+  if (fstat(fd, &sbuf) < 0)
+    fatal("cannot stat load value trace `%s'", fname);
+  if (sbuf.st_size < sizeof(struct vpt_header_t))
+    fatal("`%s' is not a load value trace", fname);
+
+  r->len = sbuf.st_size;
+  r->map = mmap(NULL, r->len, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (r->map == MAP_FAILED)
+    fatal("cannot map load value trace `%s'", fname);
+  close(fd);
+
+  /* the trace is read front to back */
+  madvise(r->map, r->len, MADV_SEQUENTIAL);
+
+  header = (struct vpt_header_t *)r->map;
+  if (strncmp(header->magic, VPT_MAGIC, sizeof(header->magic)) != 0)
+    fatal("`%s' is not a load value trace", fname);
+  if (header->version != VPT_VERSION)
+    fatal("load value trace `%s' is version %d, expected %d",
+	  fname, header->version, VPT_VERSION);
+  if (header->endian != 0x01020304)
+    fatal("load value trace `%s' has the wrong byte order", fname);
+  if (header->addr_size != sizeof(md_addr_t))
+    fatal("load value trace `%s' is for another target", fname);
+
+  r->block = r->map + sizeof(struct vpt_header_t);
+  r->p = r->end = NULL;
+  r->nrecs = 0;
+
+  return r;
+}
+
+/* read the next load record into REC, returns FALSE at the end of the
+   trace */
+int
+vpt_read(struct vpt_reader_t *r,	/* trace reader */
+	 struct vpt_rec_t *rec)		/* returned record */
+{
+  byte_t tag;
+  struct vpt_ctx_t *ctx;
+
+  while (!r->nrecs)
+    {
+      struct vpt_block_t *block = (struct vpt_block_t *)r->block;
+
+      /* a truncated last block is treated as the end of the trace */
+      if (r->block + sizeof(struct vpt_block_t) > r->map + r->len)
+	return FALSE;
+      if (block->magic != VPT_BLOCK_MAGIC)
+	fatal("corrupt load value trace block");
+      if (r->block + sizeof(struct vpt_block_t) + block->nbytes
+	  > r->map + r->len)
+	return FALSE;
+
+      r->nrecs = block->nrecs;
+      r->p = r->block + sizeof(struct vpt_block_t);
+      r->end = r->p + block->nbytes;
+      r->block = r->end;
+      r->blocks++;
+      coder_reset(&r->coder);
+    }
+
+  if (r->p == r->end)
+    fatal("corrupt load value trace record");
+  tag = *r->p++;
+
+  rec->size = 1 << (tag & VPT_TAG_SIZE);
+
+  if (tag & VPT_TAG_PC)
+    rec->pc = coder_next_pc(&r->coder);
+  else
+    rec->pc = r->coder.last_pc
+      + (md_addr_t)unzigzag(get_varint(&r->p, r->end));
+
+  ctx = coder_ctx(&r->coder, rec->pc);
+  if (tag & VPT_TAG_ADDR)
+    rec->addr = ctx->last_addr + ctx->stride;
+  else
+    rec->addr = ctx->last_addr
+      + (md_addr_t)unzigzag(get_varint(&r->p, r->end));
+
+  if (tag & VPT_TAG_VALUE)
+    rec->value = ctx->last_val;
+  else
+    rec->value = ctx->last_val
+      + (word_t)unzigzag(get_varint(&r->p, r->end));
+
+  coder_update(&r->coder, ctx, rec->pc, rec->addr, rec->value);
+
+  r->nrecs--;
+  r->recs++;
+  return TRUE;
+}
+
+/* unmap and close the trace */
+void
+vpt_close_reader(struct vpt_reader_t *r)/* trace reader */
+{
+  munmap(r->map, r->len);
+  free(r);
+}
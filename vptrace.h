@@ -0,0 +1,156 @@
+/* vptrace.h - load value trace interfaces */
+
+/*
+ * A load value trace records the (pc, addr, size, value) of every executed
+ * load, so value predictor experiments can be replayed without simulating
+ * the program again.  The trace file is a header followed by independent
+ * blocks, each a block header and the encoded records of up to
+ * VPT_BLOCK_RECS loads.
+ *
+ * Records are coded against a small direct mapped table of per-PC
+ * contexts, which is cleared at the start of each block so every block
+ * decodes on its own.  Each record is a tag byte followed by only those
+ * fields the context does not predict:
+ *
+ *   tag bits 0-1  log2 of the access size
+ *   tag bit 2     PC is the PC that followed the previous load PC last
+ *                 time, else a zigzag varint PC delta from the previous
+ *                 load PC follows
+ *   tag bit 3     addr is the PC's last addr plus its last addr stride,
+ *                 else a zigzag varint delta from the PC's last addr
+ *                 follows
+ *   tag bit 4     value is the PC's last value, else a zigzag varint delta
+ *                 from the PC's last value follows
+ *
+ * Loops in the traced program thus mostly cost one byte per load.  The
+ * value is the word_t at the load address, i.e., the value the value
+ * predictor sees, whatever the access size.  All header fields are in
+ * host byte order, the header records the byte order of the writer.
+ */
+
+#ifndef VPTRACE_H
+#define VPTRACE_H
+
+#include <stdio.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+
+/* trace file magic string and format version */
+#define VPT_MAGIC		"SSVPTRC"
+#define VPT_VERSION		1
+
+/* block header magic */
+#define VPT_BLOCK_MAGIC		0x4b425056	/* "VPBK" */
+
+/* maximum records per block */
+#define VPT_BLOCK_RECS		65536
+
+/* number of per-PC coding contexts, a power of two */
+#define VPT_CTX_SIZE		4096
+
+/* trace file header */
+struct vpt_header_t {
+  char magic[8];		/* VPT_MAGIC */
+  word_t version;		/* VPT_VERSION */
+  word_t endian;		/* 0x01020304 in writer byte order */
+  word_t addr_size;		/* sizeof(md_addr_t) of the writer */
+  word_t block_recs;		/* maximum records per block */
+};
+
+/* block header, the encoded records follow */
+struct vpt_block_t {
+  word_t magic;			/* VPT_BLOCK_MAGIC */
+  word_t nrecs;			/* number of records in the block */
+  word_t nbytes;		/* number of bytes of encoded records */
+  word_t pad;
+};
+
+/* a load value record */
+struct vpt_rec_t {
+  md_addr_t pc;			/* load inst address */
+  md_addr_t addr;		/* effective address */
+  int size;			/* access size, in bytes */
+  word_t value;			/* word_t at ADDR */
+};
+
+/* per-PC coding context */
+struct vpt_ctx_t {
+  md_addr_t pc;			/* load PC, 0 if unused */
+  md_addr_t next_pc;		/* PC of the load that followed this one */
+  md_addr_t last_addr;		/* last effective address */
+  md_addr_t stride;		/* last effective address stride */
+  word_t last_val;		/* last value */
+};
+
+/* record coder state, identical in the writer and the reader */
+struct vpt_coder_t {
+  md_addr_t last_pc;		/* PC of the previous record */
+  struct vpt_ctx_t ctx[VPT_CTX_SIZE];
+};
+
+/* trace writer */
+struct vpt_writer_t {
+  FILE *fd;			/* trace file */
+  struct vpt_coder_t coder;	/* record coder */
+  byte_t *buf;			/* encoded records of the current block */
+  unsigned int len;		/* bytes in BUF */
+  unsigned int nrecs;		/* records in BUF */
+
+  /* stats */
+  counter_t recs;		/* total records written */
+  counter_t bytes;		/* total bytes written */
+  counter_t blocks;		/* total blocks written */
+};
+
+/* trace reader */
+struct vpt_reader_t {
+  byte_t *map;			/* mapped trace file */
+  unsigned long len;		/* trace file length */
+  byte_t *block;		/* next block header */
+  struct vpt_coder_t coder;	/* record coder */
+  byte_t *p;			/* next encoded record */
+  byte_t *end;			/* end of the current block */
+  unsigned int nrecs;		/* records left in the current block */
+
+  /* stats */
+  counter_t recs;		/* total records read */
+  counter_t blocks;		/* total blocks read */
+};
+
+/* create a trace file FNAME */
+struct vpt_writer_t *			/* trace writer */
+vpt_open_writer(char *fname);		/* trace file name */
+
+/* append a load record to the trace */
+void
+vpt_write(struct vpt_writer_t *w,	/* trace writer */
+	  md_addr_t pc,			/* load inst address */
+	  md_addr_t addr,		/* effective address */
+	  int size,			/* access size, in bytes */
+	  word_t value);		/* word_t at ADDR */
+
+/* write out any partial block, the trace then ends on a complete block */
+void
+vpt_flush(struct vpt_writer_t *w);	/* trace writer */
+
+/* flush and close the trace */
+void
+vpt_close_writer(struct vpt_writer_t *w);/* trace writer */
+
+/* map trace file FNAME for reading */
+struct vpt_reader_t *			/* trace reader */
+vpt_open_reader(char *fname);		/* trace file name */
+
+/* read the next load record into REC, returns FALSE at the end of the
+   trace */
+int
+vpt_read(struct vpt_reader_t *r,	/* trace reader */
+	 struct vpt_rec_t *rec);	/* returned record */
+
+/* unmap and close the trace */
+void
+vpt_close_reader(struct vpt_reader_t *r);/* trace reader */
+
+#endif /* VPTRACE_H */